@@ -85,6 +85,14 @@ public:
 
   static constexpr float gameOverPeriod_s        {3.f};
 
+  //
+  // Rather than cut out at game over the music plays on muffled and quieter until the scene
+  // ends.
+  //
+  static constexpr int gameOverMusicCutoff_hz     {500};
+  static constexpr int gameOverMusicVolume        {64};
+  static constexpr int gameOverMusicTransition_ms {600};
+
   ////////////////////////////////////////////////////////////////////////////////////////////////
   // CONTROLS       
   ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -388,6 +396,28 @@ public:
     "click"
   };
 
+  //
+  // The score beep plays for every nugget eaten so is limited to a few instances at a low
+  // priority; it must never keep the menu clicks (or anything else) from playing.
+  //
+  static constexpr std::array<int, SFX_COUNT> soundEffectPriorities {
+    sfx::PRIORITY_LOW,
+    sfx::PRIORITY_HIGH
+  };
+
+  static constexpr std::array<int, SFX_COUNT> soundEffectInstanceLimits {
+    3,
+    sfx::UNLIMITED_INSTANCES
+  };
+
+  //
+  // The music ducks under the score beep so every nugget eaten is heard over it.
+  //
+  static constexpr std::array<bool, SFX_COUNT> soundEffectDucksMusic {
+    true,
+    false
+  };
+
   ////////////////////////////////////////////////////////////////////////////////////////////////
   // MUSIC         
   ////////////////////////////////////////////////////////////////////////////////////////////////
@@ -432,19 +462,19 @@ public:
 
   static constexpr std::array<MusicIDSequence_t, MUSIC_SEQUENCE_COUNT> musicIDSequences {{
   //----------------------------------------------------------------------------------------------
-  //    loopID                 fadeIn   playDuration   fadeOut
+  //    loopID                 fadeIn   playDuration             fadeOut
   //----------------------------------------------------------------------------------------------
   {{
-       {MUSIC_JUNGLE_DRUMS_0, 1.f,    25.f,           1.f  },
-       {MUSIC_JUNGLE_DRUMS_1, 1.f,    25.f,           1.f  },
-       {MUSIC_JUNGLE_DRUMS_2, 1.f,    25.f,           1.f  },
-       {MUSIC_JUNGLE_DRUMS_3, 1.f,    25.f,           1.f  }
+       {MUSIC_JUNGLE_DRUMS_0, 1.f,    25.f,                    1.f  },
+       {MUSIC_JUNGLE_DRUMS_1, 1.f,    25.f,                    1.f  },
+       {MUSIC_JUNGLE_DRUMS_2, 1.f,    25.f,                    1.f  },
+       {MUSIC_JUNGLE_DRUMS_3, 1.f,    25.f,                    1.f  }
     }},
     {{
-       {MUSIC_MENU_INTRO    , 1.f,    24.f,           2.f  },
-       {MUSIC_MENU_AMBIENCE , 1.f,    999999999999.f, 2.f  },
-       {MUSIC_MENU_AMBIENCE , 1.f,    999999999999.f, 2.f  },
-       {MUSIC_MENU_AMBIENCE , 1.f,    999999999999.f, 2.f  }
+       {MUSIC_MENU_INTRO    , 1.f,    24.f,                    2.f  },
+       {MUSIC_MENU_AMBIENCE , 1.f,    sfx::PLAY_MUSIC_FOREVER, 2.f  },
+       {MUSIC_MENU_AMBIENCE , 1.f,    sfx::PLAY_MUSIC_FOREVER, 2.f  },
+       {MUSIC_MENU_AMBIENCE , 1.f,    sfx::PLAY_MUSIC_FOREVER, 2.f  }
     }}
   }};
 
@@ -593,6 +623,7 @@ public:
   enum GFXScreenName
   {
     SCREEN_BACKGROUND,
+    SCREEN_BOARD,
     SCREEN_STAGE,
     SCREEN_FOREGROUND,
     SCREEN_COUNT
@@ -21,7 +21,7 @@ public:
   bool onInit();
   void onEnter();
   void onUpdate(double now, float dt);
-  void onDraw(double now, float dt, const std::vector<gfx::ScreenID_t>& screens);
+  void onDraw(double now, float dt, float alpha, const std::vector<gfx::ScreenID_t>& screens);
   void onExit();
 
   std::string getName() const {return name;}
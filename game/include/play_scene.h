@@ -2,6 +2,7 @@
 #define _PLAY_SCENE_H_
 
 #include <array>
+#include <vector>
 #include "pxr_gfx.h"
 #include "pxr_input.h"
 #include "itzcoatl.h"
@@ -18,7 +19,7 @@ public:
   bool onInit();
   void onEnter();
   void onUpdate(double now, float dt);
-  void onDraw(double now, float dt, const std::vector<gfx::ScreenID_t>& screens);
+  void onDraw(double now, float dt, float alpha, const std::vector<gfx::ScreenID_t>& screens);
   void onExit();
 
   std::string getName() const {return name;}
@@ -77,9 +78,10 @@ private:
   void drawBackground();
   void drawForeground();
   void drawTongue(){}
-  void drawSnake(gfx::ScreenID_t screenid);
-  void drawSmoothSnake(gfx::ScreenID_t screenid);
-  void drawNuggets(gfx::ScreenID_t screenid);
+  void updateBoardTilemaps();
+  void writeBoardTilemap(gfx::TilemapID_t tilemapid, std::vector<int>& tiledCells);
+  void drawBoard(gfx::ScreenID_t screenid);
+  void drawSmoothSnake(gfx::ScreenID_t screenid, float alpha);
 
   bool havePossibleSameCombo();
   bool havePossibleOrderCombo();
@@ -140,7 +142,25 @@ private:
   std::array<Nugget, Snake::maxNuggetsInWorld> _nuggets;
   int _numNuggetsInWorld;
 
+  //
+  // The snake and nuggets are drawn via tilemaps of the board, layered on the board screen
+  // which is never cleared while playing, so only the chunks of the board which change between
+  // steps are redrawn. The tiled cells of each tilemap are the cells (accessed [col + (row * 
+  // width)]) which currently hold a tile, so only those and the newly tiled cells are written
+  // on a change. The board cells are a scratch grid, all empty between updates, used to stage
+  // the new tiles.
+  //
+  gfx::TilemapID_t _snakeTilemap;
+  gfx::TilemapID_t _nuggetTilemap;
+  std::array<gfx::TilemapID_t, 2> _boardLayers;
+  std::vector<gfx::SpriteID_t> _boardCells;
+  std::vector<int> _snakeTiledCells;
+  std::vector<int> _nuggetTiledCells;
+  std::vector<int> _newTiledCells;
+  bool _isBoardDirty;
+
   float _stepClock_s;
+  float _updatePeriod_s;
   float _gameOverClock_s;
 
   std::array<Snake::NuggetClassID, Snake::longestPossibleCombo> _eatHistory;
@@ -13,6 +13,9 @@ bool Snake::onInit()
   for(int i {Snake::SCREEN_BACKGROUND}; i < Snake::SCREEN_COUNT; ++i)
     _screens.push_back(gfx::createScreen(worldSize_rx));
 
+  // The foreground frame is drawn once and covers the border of the background.
+  gfx::setScreenOcclusionMode(gfx::OcclusionMode::STATIC, _screens[Snake::SCREEN_FOREGROUND]);
+
   loadSpritesheets();
   loadFonts();
   loadSoundEffects();
@@ -75,7 +78,7 @@ sfx::MusicSequence_t Snake::getMusicSequence(MusicSequenceID sequenceID)
     sequence.push_back({
       getMusicLoopKey(node._musicID),
       static_cast<int>(node._fadeInDuration_s * 1000),
-      static_cast<int>(node._playDuration_s * 1000),
+      (node._playDuration_s == sfx::PLAY_MUSIC_FOREVER) ? sfx::PLAY_MUSIC_FOREVER : static_cast<int>(node._playDuration_s * 1000),
       static_cast<int>(node._fadeOutDuration_s * 1000)
     });
   }
@@ -107,8 +110,14 @@ void Snake::loadFonts()
 
 void Snake::loadSoundEffects()
 {
-  for(int sfxid {0}; sfxid < SFX_COUNT; ++sfxid)
+  for(int sfxid {0}; sfxid < SFX_COUNT; ++sfxid){
     _soundEffectKeys[sfxid] = sfx::loadSoundWAV(soundEffectNames[sfxid]);
+    if(_soundEffectKeys[sfxid] == sfx::errorSoundKey)
+      continue;
+    sfx::setSoundPriority(_soundEffectKeys[sfxid], soundEffectPriorities[sfxid]);
+    sfx::setSoundInstanceLimit(_soundEffectKeys[sfxid], soundEffectInstanceLimits[sfxid]);
+    sfx::setSoundDucksMusic(_soundEffectKeys[sfxid], soundEffectDucksMusic[sfxid]);
+  }
 }
 
 void Snake::loadMusicLoops()
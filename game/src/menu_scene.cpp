@@ -190,7 +190,7 @@ void MenuScene::onUpdate(double now, float dt)
   _hud->onUpdate(dt);
 }
 
-void MenuScene::onDraw(double now, float dt, const std::vector<gfx::ScreenID_t>& screens)
+void MenuScene::onDraw(double now, float dt, float alpha, const std::vector<gfx::ScreenID_t>& screens)
 {
   gfx::clearScreenTransparent(screens[Snake::SCREEN_STAGE]);
   _southwardSnake.draw(screens[Snake::SCREEN_STAGE]);
@@ -17,13 +17,36 @@ PlayScene::PlayScene(pxr::Game* owner) :
   _nextMoveDirection{Snake::WEST},
   _currentMoveDirection{Snake::WEST},
   _stepClock_s{0.f},
-  _isSnakeSmoothMover{false}
+  _updatePeriod_s{0.f},
+  _isSnakeSmoothMover{false},
+  _boardLayers{},
+  _boardCells{},
+  _snakeTiledCells{},
+  _nuggetTiledCells{},
+  _newTiledCells{},
+  _isBoardDirty{true}
 {}
 
 bool PlayScene::onInit()
 {
   _sk = static_cast<Snake*>(_owner);
   _hud = _sk->getHUD();
+  _snakeTilemap = gfx::createTilemap(
+    Snake::boardSize,
+    Vector2i{Snake::blockSize_rx, Snake::blockSize_rx},
+    _sk->getSpritesheetKey(Snake::SSID_SNAKES)
+  );
+  _nuggetTilemap = gfx::createTilemap(
+    Snake::boardSize,
+    Vector2i{Snake::blockSize_rx, Snake::blockSize_rx},
+    _sk->getSpritesheetKey(Snake::SSID_NUGGETS)
+  );
+  _boardLayers = {_nuggetTilemap, _snakeTilemap};
+  _boardCells.resize(Snake::boardSize._x * Snake::boardSize._y, gfx::EMPTY_TILE);
+  _snakeTiledCells.reserve(Snake::maxSnakeLength);
+  _nuggetTiledCells.reserve(Snake::maxNuggetsInWorld);
+  _newTiledCells.reserve(Snake::maxSnakeLength);
+  gfx::disableScreen(_sk->getScreenID(Snake::SCREEN_BOARD));
   drawForeground();
   gfx::disableScreen(_sk->getScreenID(Snake::SCREEN_FOREGROUND));
   return true;
@@ -33,6 +56,10 @@ void PlayScene::onEnter()
 {
   _currentState = State::NONE;
   drawBackground();
+  gfx::clearScreenTransparent(_sk->getScreenID(Snake::SCREEN_BOARD));
+  gfx::invalidateTilemap(_nuggetTilemap);
+  gfx::invalidateTilemap(_snakeTilemap);
+  gfx::enableScreen(_sk->getScreenID(Snake::SCREEN_BOARD));
   gfx::enableScreen(_sk->getScreenID(Snake::SCREEN_FOREGROUND));
   populateHUD();
   setNextState(State::PLAYING);
@@ -59,25 +86,29 @@ void PlayScene::onUpdate(double now, float dt)
     switchState();
 }
 
-void PlayScene::onDraw(double now, float dt, const std::vector<gfx::ScreenID_t>& screens)
+void PlayScene::onDraw(double now, float dt, float alpha, const std::vector<gfx::ScreenID_t>& screens)
 {
   gfx::clearScreenTransparent(screens[Snake::SCREEN_STAGE]);
 
-  drawNuggets(screens[Snake::SCREEN_STAGE]);
+  if(_isBoardDirty)
+    updateBoardTilemaps();
+
+  drawBoard(screens[Snake::SCREEN_BOARD]);
 
   if(_isSnakeSmoothMover)
-    drawSmoothSnake(screens[Snake::SCREEN_STAGE]);
-  else
-    drawSnake(screens[Snake::SCREEN_STAGE]);
+    drawSmoothSnake(screens[Snake::SCREEN_STAGE], alpha);
 
   _hud->onDraw(screens[Snake::SCREEN_STAGE]);
 }
 
 void PlayScene::onExit()
 {
+  gfx::disableScreen(_sk->getScreenID(Snake::SCREEN_BOARD));
   gfx::disableScreen(_sk->getScreenID(Snake::SCREEN_FOREGROUND));
   clearHUD();
   sfx::stopMusic();
+  sfx::setBusLowPass(sfx::BUS_MUSIC, sfx::NO_LOW_PASS);
+  sfx::setBusVolume(sfx::BUS_MUSIC, sfx::MAX_VOLUME);
 }
 
 void PlayScene::onEnterPlaying()
@@ -85,6 +116,7 @@ void PlayScene::onEnterPlaying()
   _nextMoveDirection = Snake::WEST;
   _currentMoveDirection = Snake::WEST;
   _stepClock_s = 0.f;
+  _updatePeriod_s = 0.f;
   _speedClock_s = 0.f;
   _speedBonusTableIndex = 0;
   _currentSpeedBonusAsInt = 0;
@@ -101,12 +133,17 @@ void PlayScene::onUpdatePlaying(double now, float dt)
 
   _speedClock_s -= dt;
 
+  //
+  // The remainder of the step period is kept so the step rate does not depend on the update
+  // rate.
+  //
+  _updatePeriod_s = dt;
   _stepClock_s += dt;
-  if(_stepClock_s > Snake::stepPeriod_s){
+  if(_stepClock_s >= Snake::stepPeriod_s){
     stepSnake();
     collideSnakeNuggets();
     collideSnakeSnake();
-    _stepClock_s = 0.f;
+    _stepClock_s -= Snake::stepPeriod_s;
   }
 
   while(_numNuggetsInWorld < Snake::maxNuggetsInWorld)
@@ -129,7 +166,10 @@ void PlayScene::handlePlayingInput()
   if(ukey && _currentMoveDirection != Snake::SOUTH) _nextMoveDirection = Snake::NORTH;
   if(dkey && _currentMoveDirection != Snake::NORTH) _nextMoveDirection = Snake::SOUTH;
 
-  if(pxr::input::isKeyPressed(Snake::smoothToggle)) _isSnakeSmoothMover = !_isSnakeSmoothMover;
+  if(pxr::input::isKeyPressed(Snake::smoothToggle)){
+    _isSnakeSmoothMover = !_isSnakeSmoothMover;
+    _isBoardDirty = true;
+  }
 
   if(pxr::input::isKeyPressed(input::KEY_a)) 
     sfx::stopChannel(sfx::ALL_CHANNELS);
@@ -137,7 +177,6 @@ void PlayScene::handlePlayingInput()
 
 void PlayScene::onExitPlaying()
 {
-  sfx::stopMusic();
 }
 
 void PlayScene::onEnterGameOver()
@@ -145,6 +184,9 @@ void PlayScene::onEnterGameOver()
   eatSnake();
   addGameOverToHUD();
   _gameOverClock_s = 0.f;
+  _updatePeriod_s = 0.f;     // the snake no longer steps so must not be interpolated.
+  sfx::setBusLowPass(sfx::BUS_MUSIC, Snake::gameOverMusicCutoff_hz, Snake::gameOverMusicTransition_ms);
+  sfx::setBusVolume(sfx::BUS_MUSIC, Snake::gameOverMusicVolume, Snake::gameOverMusicTransition_ms);
 }
 
 void PlayScene::onUpdateGameOver(double now, float dt)
@@ -208,6 +250,7 @@ void PlayScene::initializeNuggets()
   _numNuggetsInWorld = 0;
   for(auto& nugget : _nuggets)
     nugget._isAlive = false;
+  _isBoardDirty = true;
 }
 
 void PlayScene::populateHUD()
@@ -427,6 +470,7 @@ void PlayScene::spawnNugget()
     _nuggets[i]._isVisible = true;
     _nuggets[i]._isAlive = true;
     ++_numNuggetsInWorld;
+    _isBoardDirty = true;
     spawnDone = true;
     break;
   }
@@ -488,6 +532,8 @@ void PlayScene::updateSnakeBlockSpriteIDs()
 
   if(_isSnakeSmoothMover)
     updateSmoothSnakeBlockSpriteIDs();
+
+  _isBoardDirty = true;
 }
 
 void PlayScene::updateSmoothSnakeBlockSpriteIDs()
@@ -719,6 +765,7 @@ void PlayScene::eatNugget(Nugget& nugget)
   _sk->addNuggetEaten(nugget._classID, 1);
   nugget._isAlive = false;
   --_numNuggetsInWorld;
+  _isBoardDirty = true;
   sfx::SoundChannel_t channel = sfx::playSound(_sk->getSoundEffectKey(Snake::SFX_SCORE_BEEP));
 }
 
@@ -730,6 +777,7 @@ void PlayScene::eatSnake()
     _snake[_snakeBlockEaten - 1]._spriteid = Snake::SID_BLOOD_BLOCK;
   if(_snakeBlockEaten + 1 < _snakeLength)
     _snake[_snakeBlockEaten + 1]._spriteid = Snake::SID_BLOOD_BLOCK;
+  _isBoardDirty = true;
 }
 
 void PlayScene::drawBackground()
@@ -752,31 +800,75 @@ void PlayScene::drawForeground()
   );
 }
 
-void PlayScene::drawSnake(gfx::ScreenID_t screenid)
+//
+// Writes the current snake and nugget cells to the board tilemaps; the smooth snake is not grid
+// aligned so is drawn with sprites instead. Only the cells tiled before or after the change are
+// written, and of those only cells whose sprite differs dirty their chunk.
+//
+void PlayScene::updateBoardTilemaps()
 {
-  for(int block {SNAKE_HEAD_BLOCK}; block < _snakeLength; ++block){
-    Vector2i position {
-      Snake::boardPosition._x + (_snake[block]._col * Snake::blockSize_rx),
-      Snake::boardPosition._y + (_snake[block]._row * Snake::blockSize_rx)
-    };
-    gfx::drawSprite(
-      position,
-      _sk->getSpritesheetKey(Snake::SSID_SNAKES),
-      _snake[block]._spriteid + (_sk->getSnakeHero() * Snake::SID_SNAKE_OFFSET),
-      screenid
-    );
+  int boardWidth = Snake::boardSize._x;
+
+  _newTiledCells.clear();
+  for(int block {SNAKE_HEAD_BLOCK}; block < _snakeLength && !_isSnakeSmoothMover; ++block){
+    int cell = _snake[block]._col + (_snake[block]._row * boardWidth);
+    _boardCells[cell] = _snake[block]._spriteid + (_sk->getSnakeHero() * Snake::SID_SNAKE_OFFSET);
+    _newTiledCells.push_back(cell);
   }
+  writeBoardTilemap(_snakeTilemap, _snakeTiledCells);
+
+  _newTiledCells.clear();
+  for(const auto& nugget : _nuggets){
+    if(!nugget._isAlive) continue;
+    int cell = nugget._col + (nugget._row * boardWidth);
+    _boardCells[cell] = Snake::nuggetClasses[nugget._classID]._spriteid;
+    _newTiledCells.push_back(cell);
+  }
+  writeBoardTilemap(_nuggetTilemap, _nuggetTiledCells);
+
+  _isBoardDirty = false;
+}
+
+//
+// Moves a tilemap from its tiled cells to the new tiled cells staged in the board cells, then
+// empties the board cells again.
+//
+void PlayScene::writeBoardTilemap(gfx::TilemapID_t tilemapid, std::vector<int>& tiledCells)
+{
+  int boardWidth = Snake::boardSize._x;
+
+  for(int cell : tiledCells)
+    if(_boardCells[cell] == gfx::EMPTY_TILE)
+      gfx::setTile(cell / boardWidth, cell % boardWidth, gfx::EMPTY_TILE, tilemapid);
+
+  for(int cell : _newTiledCells)
+    gfx::setTile(cell / boardWidth, cell % boardWidth, _boardCells[cell], tilemapid);
+
+  for(int cell : _newTiledCells)
+    _boardCells[cell] = gfx::EMPTY_TILE;
+
+  tiledCells.swap(_newTiledCells);
 }
 
-void PlayScene::drawSmoothSnake(gfx::ScreenID_t screenid)
+void PlayScene::drawBoard(gfx::ScreenID_t screenid)
 {
+  gfx::drawTilemapLayers(Snake::boardPosition, _boardLayers.data(), static_cast<int>(_boardLayers.size()), screenid);
+}
+
+void PlayScene::drawSmoothSnake(gfx::ScreenID_t screenid, float alpha)
+{
+  //
+  // The step clock only advances on updates so the time passed since the last update (the
+  // alpha of an update period) is added to move the snake between updates too.
+  //
+  float t = std::min((_stepClock_s + (alpha * _updatePeriod_s)) / Snake::stepPeriod_s, 1.f);
+
   for(int block {_snakeLength - 1}; block >= SNAKE_HEAD_BLOCK; --block){
     Vector2i position {
       Snake::boardPosition._x + (_snake[block]._col * Snake::blockSize_rx),
       Snake::boardPosition._y + (_snake[block]._row * Snake::blockSize_rx)
     };
 
-    float t = _stepClock_s / Snake::stepPeriod_s;
     float limit = static_cast<float>(Snake::blockSize_rx) - 1.f;
     switch(_snake[block]._currentMoveDirection){
       case Snake::NORTH:
@@ -803,21 +895,3 @@ void PlayScene::drawSmoothSnake(gfx::ScreenID_t screenid)
     );
   }
 }
-
-void PlayScene::drawNuggets(gfx::ScreenID_t screenid)
-{
-  for(const auto& nugget : _nuggets){
-    if(!nugget._isAlive) continue;
-    const auto& nc = Snake::nuggetClasses[nugget._classID];
-    Vector2i position {
-      Snake::boardPosition._x + (nugget._col * Snake::blockSize_rx),
-      Snake::boardPosition._y + (nugget._row * Snake::blockSize_rx)
-    };
-    gfx::drawSprite(
-      position,
-      _sk->getSpritesheetKey(Snake::SSID_NUGGETS),
-      nc._spriteid,
-      screenid
-    );
-  }
-}
@@ -1,9 +1,12 @@
 #ifndef _PIXIRETRO_IO_BMPIMAGE_H_
 #define _PIXIRETRO_IO_BMPIMAGE_H_
 
-#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
 #include "pxr_color.h"
 #include "pxr_vec.h"
+#include "pxr_mmap.h"
 
 namespace pxr
 {
@@ -18,15 +21,29 @@ class Bmp
 public:
   static constexpr const char* FILE_EXTENSION {".bmp"};
 
+  //
+  // This is a somewhat arbitrary choice made to avoid allocating excessive memory
+  // and to aid checking bmp image integrity. It is very game dependent so feel free
+  // to adjust these limits to suit your needs.
+  //
+  static constexpr int BMP_MAX_WIDTH {3000};
+  static constexpr int BMP_MAX_HEIGHT {3000};
+
 public:
   Bmp();
-  ~Bmp();
 
+  //
+  // Copies are cheap: the copy shares the pixels of the original until either is mutated.
+  //
   Bmp(const Bmp& other);
   Bmp(Bmp&& other);
   Bmp& operator=(const Bmp& other);
   Bmp& operator=(Bmp&& other);
 
+  //
+  // Loads a bitmap image file, or a QOI image file if the path has the QOI file extension
+  // (see io::Qoi).
+  //
   bool load(std::string filepath);
   void create(Vector2i size, gfx::Color4u fill);
 
@@ -34,7 +51,19 @@ public:
 
   const gfx::Color4u getPixel(int row, int col);
   const gfx::Color4u* getRow(int row);
-  const gfx::Color4u* const* getPixels() const {return _pixels;}
+
+  //
+  // Pixels are stored contiguously row after row, thus pixel [row, col] is accessed with
+  // getPixels()[(row * getStride()) + col].
+  //
+  const gfx::Color4u* getPixels() const {return _pixels;}
+  int getStride() const {return _stride;}
+
+  //
+  // Writable access to the pixels, e.g. for decoders filling an image made with create. If the
+  // pixels are shared with copies of this image they are first cloned.
+  //
+  gfx::Color4u* getPixelsMutable();
 
   int getWidth() const {return _size._x;}
   int getHeight() const {return _size._y;}
@@ -51,14 +80,6 @@ private:
   static constexpr int V4INFOHEADER_SIZE_BYTES {108};
   static constexpr int V5INFOHEADER_SIZE_BYTES {124};
 
-  //
-  // This is a somewhat arbitrary choice made to avoid allocating excessive memory
-  // and to aid checking bmp image integrity. It is very game dependent so feel free
-  // to adjust these limits to suit your needs.
-  //
-  static constexpr int BMP_MAX_WIDTH {3000};
-  static constexpr int BMP_MAX_HEIGHT {3000};
-
   enum Compression
   {
     BI_RGB = 0, 
@@ -105,20 +126,36 @@ private:
 private:
   void freePixels();
   void reallocatePixels();
-  void extractIndexedPixels(std::ifstream& file, FileHeader& fileHead, InfoHeader& infoHead);
-  void extractPixels(std::ifstream& file, FileHeader& fileHead, InfoHeader& infoHead);
+  void detachPixels();
+  bool extractPalette(const ByteReader& reader, const InfoHeader& infoHead, std::vector<gfx::Color4u>& palette);
+  bool extractRlePixels(const ByteReader& reader, const FileHeader& fileHead, const InfoHeader& infoHead);
+  bool extractIndexedPixels(const ByteReader& reader, const FileHeader& fileHead, const InfoHeader& infoHead);
+  bool extractPixels(const ByteReader& reader, const FileHeader& fileHead, const InfoHeader& infoHead);
 
 private:
+  int getPixelCount() const {return _stride * _size._y;}
+
+private:
+  //
+  // Pixel storage in a single allocation. Storage is shared between copies of an image and is
+  // only cloned when one of the copies is mutated (copy-on-write).
+  //
+  std::shared_ptr<gfx::Color4u[]> _storage;
+
   //
-  // Raw pixel data accessed by [row][col], i.e. _pixels is a pointer to an array of pixel
-  // rows.
+  // Raw pixel data accessed by [(row * _stride) + col]; points into _storage.
   //
-  gfx::Color4u** _pixels;
+  gfx::Color4u* _pixels;
 
   //
   // Size/dimensions of the bmp image: x=width (num cols) and y=height (num rows).
   //
   Vector2i _size;
+
+  //
+  // The distance between the starts of consecutive rows (unit: pixels). 
+  //
+  int _stride;
 };
 
 } // namespace io
@@ -0,0 +1,113 @@
+#ifndef _PIXIRETRO_BUS_H_
+#define _PIXIRETRO_BUS_H_
+
+#include <array>
+
+namespace pxr
+{
+namespace sfx
+{
+
+//
+// A second order low-pass filter (a biquad with the coefficients of the RBJ audio eq cookbook
+// at the butterworth Q) applied to each channel of interleaved float frames.
+//
+// The recursion is serial from one frame to the next, so rather than vectorising across the
+// channels (only 2 lanes of work) the SIMD path (see pxr_simd.h) filters 4 frames of a channel
+// at once: over 4 frames the outputs and the final state are linear in the 4 inputs and the
+// initial state, so are given by fixed matrices which are derived from the coefficients
+// whenever they change. Frames left over are filtered by the scalar recursion, which shares
+// the state.
+//
+class Biquad
+{
+public:
+  static constexpr int MAX_CHANNELS {2};
+
+public:
+  Biquad();
+
+  void setLowPass(float cutoff_hz, int sampleRate_hz);
+  void reset();
+  void process(float* samples, int frames, int numChannels);
+
+private:
+  static constexpr int NUM_BLOCK_INPUTS {6};  // 4 inputs then the 2 state variables
+
+private:
+  float _b0, _b1, _b2, _a1, _a2;
+  std::array<float, MAX_CHANNELS> _s1;
+  std::array<float, MAX_CHANNELS> _s2;
+
+  //
+  // Row i holds the contributions of block input i to the 4 outputs and to the 2 final state
+  // variables (in the first 2 lanes).
+  //
+  alignas(16) float _yBlock[NUM_BLOCK_INPUTS][4];
+  alignas(16) float _sBlock[NUM_BLOCK_INPUTS][4];
+};
+
+//
+// A mix bus; the effects applied to the sum of some set of sources before it is mixed on. In
+// order a bus low-pass filters, then applies its gain and its ducking.
+//
+// All changes are smoothed: gains ramp linearly and the filter cutoff glides exponentially
+// (recomputing the coefficients once per process call) so nothing clicks. Ducking is a gain
+// which falls to the ducked depth over the attack time while the bus is ducked and recovers
+// over the release time once it is not, like a sidechained compressor keyed by the owner.
+//
+// Processing is meant to be done in small blocks (e.g. the mixer's BLOCK_FRAMES) since ramps
+// are stepped once per call; a bus with nothing to do returns immediately.
+//
+// Frames are floats of any scale; the bus does no clamping. There is no locking; all calls
+// must be made on the thread which processes.
+//
+class Bus
+{
+public:
+  static constexpr float NO_LOW_PASS {0.f};
+
+public:
+  Bus();
+
+  void initialize(int numChannels, int sampleRate_hz);
+
+  void setGain(float gain, int rampFrames);
+  void setLowPass(float cutoff_hz, int glideFrames);
+  void setDucking(float duckedGain, int attackFrames, int releaseFrames);
+  void setDucked(bool isDucked);
+
+  void process(float* samples, int frames);
+
+  bool isBypassed() const;
+
+private:
+  static float stepTowards(float value, float target, float step);
+  void glideCutoff(int frames);
+
+private:
+  Biquad _filter;
+  int _numChannels;
+  int _sampleRate_hz;
+
+  float _gain;
+  float _gainTarget;
+  float _gainStep;
+  int _rampFramesLeft;
+
+  float _cutoff_hz;
+  float _cutoffTarget_hz;
+  int _glideFramesLeft;
+  bool _isFiltering;
+
+  float _duck;
+  float _duckedGain;
+  float _attackStep;
+  float _releaseStep;
+  bool _isDucked;
+};
+
+} // namespace sfx
+} // namespace pxr
+
+#endif
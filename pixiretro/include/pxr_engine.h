@@ -5,6 +5,7 @@
 
 #include <memory>
 #include <chrono>
+#include <vector>
 
 #include "pxr_rc.h"
 #include "pxr_game.h"
@@ -54,7 +55,6 @@ private:
   static constexpr Duration_t oneSecond      {1'000'000'000 };
   static constexpr Duration_t oneHalfSecond  {500'000'000   };
   static constexpr Duration_t oneMinute      {60'000'000'000};
-  static constexpr Duration_t minFramePeriod {1'000'000     };
 
   static constexpr float splashDurationSeconds     {1.0f};
   static constexpr float splashWaitDurationSeconds {1.0f};
@@ -78,6 +78,14 @@ private:
   static constexpr int toggleDrawEngineStatsKey   {SDLK_BACKQUOTE   };
   static constexpr int skipSplashKey              {SDLK_ESCAPE      };
 
+  //
+  // While the game clock is paused the whole mix is muffled and lowered on the master bus
+  // (see sfx::setBusLowPass), gliding in and out over the transition time.
+  //
+  static constexpr int pausedAudioCutoff_hz       {800};
+  static constexpr int pausedAudioVolume          {80};
+  static constexpr int pauseAudioTransition_ms    {250};
+
   //
   // The name of the splash screen assets used by the engine. The engine will attempt 
   // to load the following files:
@@ -91,6 +99,12 @@ private:
   //
   static constexpr const char* splashName {"pixiretro_splash"};
 
+  //
+  // When the audioRender rc property is set the engine's audio is rendered offline to this
+  // file in lockstep with the update ticks rather than played (see sfx::SFXConfiguration).
+  //
+  static constexpr const char* audioRenderPath {"audio_render.wav"};
+
   //
   // A clock to record the real passage of time.
   //
@@ -168,6 +182,7 @@ private:
     int getTicksDoneTotal() const {return _ticksDoneTotal;}
     int getTicksDoneThisFrame() const {return _ticksDoneThisFrame;}
     int getTicksAccumulated() const {return _ticksAccumulated;}
+    float getTickAlpha(Duration_t gameNow, Duration_t realNow) const;
     const std::array<double, FPS_HISTORY_SIZE>& getTickFrequencyHistory() {return _measuredTickFrequencyHistory;}
     bool isNewTickFrequencySample() const {return _isNewTickFrequencySample;}
     void setCallback(Callback_t onTick){_onTick = onTick;}
@@ -199,6 +214,67 @@ private:
     bool _isNewTickFrequencySample;
   };
 
+  //
+  // Paces the main loop to a fixed frame period by waiting at the end of each frame for an
+  // absolute deadline, which then advances by one period; deadlines are fixed on the real
+  // timeline so errors in one wait do not accumulate into the next. A frame which overruns
+  // its deadline by more than a period drops the deadlines missed rather than rushing to
+  // catch them up.
+  //
+  // Waits sleep until the deadline is within the spin threshold and then spin (yielding) up
+  // to it; sleeps can overshoot by far more than the jitter wanted, but spinning the whole
+  // wait would burn a core. The threshold adapts to the largest overshoot recently seen.
+  //
+  // With vsync the swap in gfx::present already blocks until the display is ready so waits
+  // end vsyncSlack early, leaving the swap to take up the rest, and the deadlines are aligned
+  // to the end of each swap.
+  //
+  // Jitter is the difference between the measured period of each frame and the target
+  // period; the percentiles are taken over the last JITTER_HISTORY_SIZE frames.
+  //
+  class FramePacer
+  {
+  public:
+    static constexpr int JITTER_HISTORY_SIZE {600};
+
+    struct JitterStats
+    {
+      float _p50_ms;
+      float _p99_ms;
+      float _max_ms;
+      float _spinThreshold_ms;
+      int _missedDeadlines;
+    };
+
+  public:
+    FramePacer() = default;
+    FramePacer(Duration_t framePeriod, bool isVSynced);
+    void reset();
+    void waitForNextFrame();
+    void onPresent();
+    JitterStats getJitterStats() const;
+
+  private:
+    static constexpr Duration_t minSpinThreshold {200'000};
+    static constexpr Duration_t maxSpinThreshold {4'000'000};
+    static constexpr Duration_t vsyncSlack       {1'500'000};
+
+  private:
+    void sleepUntil(TimePoint_t deadline);
+    void recordJitter(TimePoint_t frameStart);
+
+  private:
+    Duration_t _framePeriod;
+    Duration_t _spinThreshold;
+    Duration_t _maxOvershoot;          // largest sleep overshoot seen recently; decays.
+    TimePoint_t _nextDeadline;
+    TimePoint_t _lastFrameStart;
+    std::vector<float> _jitterHistory_ms;
+    int _jitterHead;
+    int _missedDeadlines;
+    bool _isVSynced;
+  };
+
   class EngineRC final : public io::RC
   {
   public:
@@ -212,7 +288,10 @@ private:
       KEY_CLEAR_RED,
       KEY_CLEAR_GREEN,
       KEY_CLEAR_BLUE,
-      KEY_FPS_LOCK
+      KEY_FPS_LOCK,
+      KEY_AUDIO_RENDER,
+      KEY_VSYNC,
+      KEY_UPDATE_RATE
     };
 
     EngineRC() : RC({
@@ -223,7 +302,10 @@ private:
       {KEY_CLEAR_RED,     "clearRed",     {10},    {0},     {255}},
       {KEY_CLEAR_GREEN,   "clearGreen",   {10},    {0},     {255}},
       {KEY_CLEAR_BLUE,    "clearBlue",    {10},    {0},     {255}},
-      {KEY_FPS_LOCK,      "fpsLock",      {60},    {24},    {1000}}
+      {KEY_FPS_LOCK,      "fpsLock",      {60},    {24},    {1000}},
+      {KEY_AUDIO_RENDER,  "audioRender",  {false}, {false}, {true}},
+      {KEY_VSYNC,         "vsync",        {false}, {false}, {true}},
+      {KEY_UPDATE_RATE,   "updateRate",   {60},    {10},    {1000}}
     }){}
   };
 
@@ -250,12 +332,15 @@ private:
   Ticker _updateTicker;
   Ticker _drawTicker;
 
+  FramePacer _framePacer;
+
   RealClock _realClock;
   GameClock _gameClock;
 
   gfx::Color4f _clearColor;
 
   int _fpsLockHz;
+  int _updateRateHz;
 
   long _framesDone;
   int _framesDoneThisSecond;
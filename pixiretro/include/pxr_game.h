@@ -30,7 +30,13 @@ public:
   virtual ~Scene() = default;
   virtual bool onInit() = 0;
   virtual void onUpdate(double now, float dt) = 0;
-  virtual void onDraw(double now, float dt, const std::vector<gfx::ScreenID_t>& screens) = 0;
+
+  //
+  // The alpha is the fraction [0, 1] of an update tick which has passed since the last update;
+  // draws can use it to interpolate between the last two update states, so motion stays smooth
+  // when updates are less frequent than draws.
+  //
+  virtual void onDraw(double now, float dt, float alpha, const std::vector<gfx::ScreenID_t>& screens) = 0;
   virtual void onEnter() = 0;
   virtual void onExit() = 0;
 
@@ -72,11 +78,12 @@ public:
   }
 
   //
-  // Invoked by the engine during the draw tick.
+  // Invoked by the engine during the draw tick; alpha is the fraction of an update tick passed
+  // since the last update (see Scene::onDraw).
   //
-  void onDraw(double now, float dt)
+  void onDraw(double now, float dt, float alpha)
   {
-    _activeScene->onDraw(now, dt, _screens);
+    _activeScene->onDraw(now, dt, alpha, _screens);
   }
 
   //
@@ -5,6 +5,7 @@
 #include <vector>
 #include <array>
 #include <cmath>
+#include <cstdint>
 
 #include "pxr_color.h"
 #include "pxr_vec.h"
@@ -197,6 +198,33 @@ enum class PositionMode
   BOTTOM_RIGHT
 };
 
+//
+// The occlusion mode controls whether the opaque pixels of a screen hide the pixels of screens
+// lower in the stacking order. Hidden pixels are culled from the draw before being sent to
+// opengl, as are any fully transparent pixels of screens which are drawn with occlusion.
+//
+// Occlusion is only tested between screens which share the same position, pixel size and 
+// resolution, i.e. whose pixels overlap exactly.
+//
+// The modes apply as follows:
+//
+//      NONE    - the default. The screen does not occlude lower screens.
+//
+//      DYNAMIC - the opacity mask of the screen is recomputed every present after the screen
+//                has been drawn to. Use for screens which are redrawn every frame.
+//
+//      STATIC  - the opacity mask of the screen is computed once and cached until the screen 
+//                is next cleared. Use for screens which are drawn once and left, e.g. a 
+//                foreground frame. Pixels drawn after the mask is computed will not occlude
+//                until the next clear (which is safe, just not optimal).
+//
+enum class OcclusionMode
+{
+  NONE,
+  DYNAMIC,
+  STATIC
+};
+
 //
 // The signiture of pixel shader functions to be set by the user if using PixelMode::SHADER.
 //
@@ -244,19 +272,25 @@ using PXShader_t = Color4u (*)(Color4u inColor, int pxx, int pxy);
 //
 struct Screen
 {
-  PXShader_t   _pxShader;
-  PositionMode _pmode;
-  SizeMode     _smode;
-  PixelMode    _xmode;
-  Vector2i     _position;        // position w.r.t window space.
-  Vector2i     _manualPosition;  // position w.r.t window space when in manual position mode.
-  Vector2i     _resolution;      // size/dimensions of the virtual screen.
-  int          _pxSize;          // size of virtual pixels (unit: real pixels).
-  int          _pxManualSize;    // size of virtual pixels when in manual size mode.
-  int          _pxCount;         // total number of virtual pixels on the screen.
-  Color4u*     _pxColors;        // accessed [col + (row * width)]
-  Vector2i*    _pxPositions;     // accessed [col + (row * width)]
-  bool         _isEnabled;       // enable/disable drawing this screen to the window.
+  PXShader_t    _pxShader;
+  PositionMode  _pmode;
+  SizeMode      _smode;
+  PixelMode     _xmode;
+  OcclusionMode _omode;
+  Vector2i      _position;        // position w.r.t window space.
+  Vector2i      _manualPosition;  // position w.r.t window space when in manual position mode.
+  Vector2i      _resolution;      // size/dimensions of the virtual screen.
+  int           _pxSize;          // size of virtual pixels (unit: real pixels).
+  int           _pxManualSize;    // size of virtual pixels when in manual size mode.
+  int           _pxCount;         // total number of virtual pixels on the screen.
+  Color4u*      _pxColors;        // accessed [col + (row * width)]
+  Vector2i*     _pxPositions;     // accessed [col + (row * width)]
+  uint8_t*      _opacityMask;     // accessed [col + (row * width)]; 1 if pixel opaque else 0.
+  uint32_t*     _pxIndices;       // indices of the pixels which survived occlusion culling.
+  int           _pxVisibleCount;  // number of indices in _pxIndices; -1 if all pixels are drawn.
+  bool          _isMaskStale;     // if true the opacity mask must be recomputed before use.
+  bool          _isDirty;         // if true pixels have been drawn since the last present.
+  bool          _isEnabled;       // enable/disable drawing this screen to the window.
 };
 
 //
@@ -264,6 +298,28 @@ struct Screen
 //
 using ScreenID_t = int;
 
+//
+// The type of tilemap ids. Primarly used to improve code readability.
+//
+using TilemapID_t = int;
+
+//
+// The sprite id of an empty tilemap cell. Empty cells are not drawn.
+//
+constexpr SpriteID_t EMPTY_TILE {-1};
+
+//
+// The dimensions of the tilemap chunks (unit: cells).
+//
+// A tilemap is a grid of cells in which each cell references a sprite of a single spritesheet.
+// The cells are divided into square chunks and each chunk caches a rasterised image of its
+// cells. Changing a cell only marks its chunk dirty, and a draw call re-rasterises the dirty
+// chunks and copies only those to the screen; clean chunks are not touched at all. Thus a
+// tilemap must be drawn to a screen of its own which is not cleared between draws, and the
+// cost of drawing a tilemap scales with the number of changed chunks rather than set cells.
+//
+constexpr int TILEMAP_CHUNK_SIZE {8};
+
 //
 // Initializes the gfx subsystem. Returns true if success and false if fatal error.
 //
@@ -274,6 +330,12 @@ bool initialize(std::string windowTitle, Vector2i windowSize, bool fullscreen);
 //
 void shutdown();
 
+//
+// Enables or disables waiting for the display's vertical blank in present, so frames are
+// presented in step with the display. Returns false if the driver cannot change it.
+//
+bool setVSync(bool isEnabled);
+
 //
 // Creates a new virtual screen which can be drawn to via a draw call. 
 //
@@ -302,7 +364,8 @@ void onWindowResize(Vector2i windowSize);
 // The naming format for the asset files is:
 //    <name>.<extension>
 //
-// see XML_RESOURCE_EXTENSION_SPRITESHEET and Bmp::FILE_EXTENSION for the extensions.
+// see XML_RESOURCE_EXTENSION_SPRITESHEET and Bmp::FILE_EXTENSION for the extensions. The image
+// may instead be a QOI image (see Qoi::FILE_EXTENSION) which is preferred if both exist.
 //
 //
 // Returns the resource key the loaded spritesheet was mapped to which is needed for the drawing
@@ -327,7 +390,8 @@ void unloadSpritesheet(ResourceKey_t sheetKey);
 // The naming format for the asset files is:
 //    <name>.<extension>
 //
-// see XML_RESOURCE_EXTENSION_FONTS and Bmp::FILE_EXTENSION for the extensions.
+// see XML_RESOURCE_EXTENSION_FONTS and Bmp::FILE_EXTENSION for the extensions. The image
+// may instead be a QOI image (see Qoi::FILE_EXTENSION) which is preferred if both exist.
 //
 // Returns the resource key the loaded font was mapped to which is needed for the drawing
 // routines. Internally fonts are reference counted and thus can be loaded multiple times
@@ -417,6 +481,55 @@ void drawLine(Vector2i p0, Vector2i p1, Color4u color, ScreenID_t screenid);
 //
 void drawPoint(Vector2i position, Color4u color, ScreenID_t screenid);
 
+//
+// Creates a new tilemap of 'size' cells (x=cols, y=rows) where each cell is 'cellSize' pixels.
+// All cells are initially empty. The sprites of the cells are taken from the spritesheet
+// 'sheetKey'. The sprite's bottom-left pixel is drawn at the bottom-left pixel of its cell
+// (sprite origins are ignored) and sprites larger than the cell are clipped to the cell.
+//
+// Returns the integer id of the tilemap for use with the tilemap functions. As with screens,
+// ids start at 0 and increase by 1 with each new tilemap created.
+//
+TilemapID_t createTilemap(Vector2i size, Vector2i cellSize, ResourceKey_t sheetKey);
+
+//
+// Sets the sprite of a tilemap cell. Pass EMPTY_TILE to clear the cell. Cells are only marked
+// for re-rasterisation if the sprite actually changes, so it is cheap to set a cell to the
+// sprite it already has.
+//
+void setTile(int row, int col, SpriteID_t spriteid, TilemapID_t tilemapid);
+
+//
+// Returns the sprite id of a tilemap cell, or EMPTY_TILE for an empty cell.
+//
+SpriteID_t getTile(int row, int col, TilemapID_t tilemapid);
+
+//
+// Sets all cells of a tilemap to EMPTY_TILE.
+//
+void clearTilemap(TilemapID_t tilemapid);
+
+//
+// Marks every chunk of a tilemap dirty so the next draw copies the whole tilemap to the screen.
+// Call after the screen a tilemap is drawn to has been cleared or drawn over.
+//
+void invalidateTilemap(TilemapID_t tilemapid);
+
+//
+// Draws a tilemap with the bottom-left pixel of cell [0, 0] at position. Only the chunks which
+// are dirty are re-rasterised and copied to the screen (see TILEMAP_CHUNK_SIZE); the copy
+// overwrites the chunk's area, empty cells included, so cells cleared since the last draw are
+// erased. Screen pixel shaders are applied as chunks are copied.
+//
+void drawTilemap(Vector2i position, TilemapID_t tilemapid, ScreenID_t screenid);
+
+//
+// Draws tilemaps stacked as layers (the first at the bottom) to one screen, as drawTilemap.
+// A chunk dirty in any layer is redrawn from all the layers so layers can share a screen. The
+// layerCount tilemaps in layerids must all have the same size and cell size.
+//
+void drawTilemapLayers(Vector2i position, const TilemapID_t* layerids, int layerCount, ScreenID_t screenid);
+
 //
 // Issues opengl calls to render results of (software) draw calls and then swaps the buffers.
 //
@@ -427,6 +540,11 @@ void present();
 //
 void setScreenPixelMode(PixelMode mode, ScreenID_t screenid);
 
+//
+// Changes the occlusion mode of a screen. See the OcclusionMode enumeration for details.
+//
+void setScreenOcclusionMode(OcclusionMode mode, ScreenID_t screenid);
+
 //
 // Changes the size mode of a screen with immediate effect.
 //
@@ -23,6 +23,7 @@ LOGSTR msg_log_to_stderr = "logging to standard error";
 
 LOGSTR msg_eng_fail_sdl_init = "failed to initialize SDL";
 LOGSTR msg_eng_locking_fps = "locking fps to";
+LOGSTR msg_eng_update_rate = "updating game logic at";
 LOGSTR msg_eng_fail_load_splash = "failed to splash sprite : skipping splash screen";
 LOGSTR msg_eng_fail_init_game = "failed to initialize the game";
 
@@ -41,6 +42,7 @@ LOGSTR msg_gfx_fail_set_opengl_attribute = "failed to set opengl attribute";
 LOGSTR msg_gfx_opengl_version = "using opengl version";
 LOGSTR msg_gfx_opengl_renderer = "using opengl renderer";
 LOGSTR msg_gfx_opengl_vendor = "using opengl vendor";
+LOGSTR msg_gfx_fail_set_vsync = "failed to set the swap interval for vsync";
 LOGSTR msg_gfx_loading_spritesheets = "starting spritesheet loading";
 LOGSTR msg_gfx_loading_spritesheet = "loading spritesheet";
 LOGSTR msg_gfx_spritesheet_already_loaded = "spritesheet already loaded";
@@ -77,6 +79,17 @@ LOGSTR msg_sfx_sound_already_loaded = "sound already loaded";
 LOGSTR msg_sfx_music_already_loaded = "music already loaded";
 LOGSTR msg_sfx_fail_load_sound = "failed to load sound";
 LOGSTR msg_sfx_fail_load_music = "failed to load music";
+LOGSTR msg_sfx_fail_convert_sound = "failed to convert sound to the audio device format";
+LOGSTR msg_sfx_fail_attach_sound = "failed to prepare sound data for playback";
+LOGSTR msg_sfx_fail_open_render = "failed to open file to render audio to";
+LOGSTR msg_sfx_render_done = "rendered audio offline : [seconds:mix ms per second]";
+LOGSTR msg_sfx_sound_evicted = "evicted sound data to stay within the sound budget : sound key";
+LOGSTR msg_sfx_fail_reload_sound = "failed to reload evicted sound";
+LOGSTR msg_sfx_sound_cache_hit = "loaded converted sound from cache";
+LOGSTR msg_sfx_fail_write_sound_cache = "failed to write converted sound to cache";
+LOGSTR msg_sfx_music_underruns = "music stream ran dry during playback : count";
+LOGSTR msg_sfx_mixer_play_errors = "SDL_mixer refused queued sound plays : count";
+LOGSTR msg_sfx_command_queue_full = "audio command queue full; command dropped";
 LOGSTR msg_sfx_using_error_sound = "using error sound to substitute sound";
 LOGSTR msg_sfx_no_error_music = "unloaded music is substituted with silence";
 LOGSTR msg_sfx_error_sound_usage = "error sound usage count";
@@ -86,9 +99,11 @@ LOGSTR msg_sfx_unloading_nonexistent_sound = "trying to unload nonexistent sound
 LOGSTR msg_sfx_unloading_nonexistent_music = "trying to unload nonexistent music with music key";
 LOGSTR msg_sfx_already_unloading_sound = "trying to add sound to unload queue multiple times : sound key";
 LOGSTR msg_sfx_playing_nonexistent_sound = "trying to play nonexistent sound with key";
+LOGSTR msg_sfx_configuring_nonexistent_sound = "trying to configure nonexistent sound with key";
 LOGSTR msg_sfx_playing_nonexistent_music = "trying to play nonexistent music with key";
 LOGSTR msg_sfx_fail_play_sound = "failed to play sound with key";
 LOGSTR msg_sfx_fail_play_music = "failed to play music with key";
+LOGSTR msg_sfx_invalid_bus = "trying to configure nonexistent mix bus";
 
 //
 // xml log strings.
@@ -116,6 +131,7 @@ LOGSTR msg_bmp_corrupted = "expected a bitmap image file; file corrupted or wron
 LOGSTR msg_bmp_unsupported_colorspace = "loaded bitmap image using unsupported non-sRGB color space";
 LOGSTR msg_bmp_unsupported_compression = "loaded bitmap image using unsupported compression mode";
 LOGSTR msg_bmp_unsupported_size = "loaded bitmap image has unsupported size";
+LOGSTR msg_bmp_qoi_corrupted = "expected a qoi image file; file corrupted or wrong type";
 
 //
 // wav file log strings.
@@ -129,6 +145,7 @@ LOGSTR msg_wav_not_wave = "file not a wave file";
 LOGSTR msg_wav_fmt_chunk_missing = "missing format chunk";
 LOGSTR msg_wav_not_pcm = "detected non-pcm sound data in wave : unsupported";
 LOGSTR msg_wav_bad_compressed = "detected compressed pcm data in wave : unsupported";
+LOGSTR msg_wav_bad_adpcm_layout = "detected unsupported ima adpcm block layout";
 LOGSTR msg_wav_odd_channels = "detected unsupported number of sound channels";
 LOGSTR msg_wav_odd_sample_bits = "detected unsupported number of bits per sample";
 LOGSTR msg_wav_data_chunk_missing = "missing data chunk";
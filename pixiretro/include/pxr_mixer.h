@@ -0,0 +1,134 @@
+#ifndef _PIXIRETRO_MIXER_H_
+#define _PIXIRETRO_MIXER_H_
+
+#include <vector>
+#include <cinttypes>
+
+namespace pxr
+{
+namespace sfx
+{
+
+//
+// A software mixer which mixes many voices of signed 16-bit pcm into a single output stream.
+//
+// Voices are mixed in blocks of BLOCK_FRAMES into a float accumulator using SIMD where
+// available (see pxr_simd.h) and the accumulator is then written out as either signed 16-bit
+// or 32-bit float samples. All voice sources must have the same sample rate and number of
+// channels as the output; conversion is expected to have been done when the sounds were loaded.
+//
+// Every change of voice volume is ramped linearly over a number of frames to avoid clicks;
+// fades are simply long ramps.
+//
+// Each block can be handed to a block callback before it is written out, e.g. to run effects
+// over the mix or to mix in other sources (see pxr_bus.h).
+//
+// The mixer does no locking of its own; the owner must serialise calls to the voice functions
+// with calls to mix, e.g. by only calling them from the thread which mixes.
+//
+class Mixer
+{
+public:
+  static constexpr int BLOCK_FRAMES {256};
+  static constexpr int MAX_VOLUME {128};
+  static constexpr int ALL_VOICES {-1};
+  static constexpr int NULL_VOICE {-2};
+  static constexpr int INFINITE_LOOPS {-1};
+  static constexpr int FOREVER {-1};
+
+  //
+  // Number of frames over which a change in volume is ramped.
+  //
+  static constexpr int VOLUME_RAMP_FRAMES {64};
+
+  using FinishedCallback_t = void (*)(int voice);
+
+  //
+  // Called with the accumulated frames of each block, as floats in units of 16-bit samples
+  // (unclamped), which it may modify in place.
+  //
+  using BlockCallback_t = void (*)(float* accumulator, int frames);
+
+public:
+  Mixer();
+
+  void initialize(int numVoices, int numChannels);
+
+  //
+  // Called (from within mix) whenever a voice stops playing of its own accord or is stopped.
+  //
+  void setFinishedCallback(FinishedCallback_t callback) {_onFinished = callback;}
+
+  //
+  // Called (from within mix) with every block once its voices are mixed.
+  //
+  void setBlockCallback(BlockCallback_t callback) {_onBlock = callback;}
+
+  //
+  // Starts playing samples on a voice which must not be playing. Voices are chosen by the owner
+  // so the choice can be made ahead of the call, e.g. on another thread.
+  // The samples must remain valid until the voice finishes. Plays the sound loops + 1 times, or
+  // forever if loops == INFINITE_LOOPS, fading in over fadeFrames and stopping after playFrames
+  // unless playFrames == FOREVER. Invalid samples finish the voice immediately.
+  //
+  void play(int voice, const int16_t* samples, int frameCount, int loops, int fadeFrames, int playFrames);
+
+  //
+  // The following accept ALL_VOICES in place of a voice and ignore NULL_VOICE.
+  //
+  void stop(int voice);
+  void stopTimed(int voice, int frames);
+  void fadeOut(int voice, int frames);
+  void pause(int voice);
+  void resume(int voice);
+  void setVolume(int voice, int volume);
+
+  bool isPlaying(int voice) const;
+  bool isPaused(int voice) const;
+  int getVolume(int voice) const;
+  int getActiveVoiceCount() const;
+  int getNumVoices() const {return static_cast<int>(_voices.size());}
+  int getNumChannels() const {return _numChannels;}
+
+  //
+  // Mixes the next frames of all playing voices into out, overwriting it.
+  //
+  void mix(int16_t* out, int frames);
+  void mix(float* out, int frames);
+
+private:
+  struct Voice
+  {
+    const int16_t* _samples;
+    int _frameCount;
+    int _position;
+    int _loopsRemaining;
+    int _framesUntilStop;
+    int _volume;
+    float _gain;
+    float _gainTarget;
+    float _gainStep;
+    int _rampFramesLeft;
+    bool _isActive;
+    bool _isPaused;
+    bool _isFadingOut;
+  };
+
+private:
+  template<typename Fn> void forVoices(int voice, Fn fn);
+  void startRamp(Voice& v, float target, int frames);
+  void finish(int voice);
+  void mixBlock(int frames);
+
+private:
+  std::vector<Voice> _voices;
+  std::vector<float> _accumulator;
+  int _numChannels;
+  FinishedCallback_t _onFinished;
+  BlockCallback_t _onBlock;
+};
+
+} // namespace sfx
+} // namespace pxr
+
+#endif
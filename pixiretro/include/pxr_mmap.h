@@ -0,0 +1,107 @@
+#ifndef _PIXIRETRO_IO_MMAP_H_
+#define _PIXIRETRO_IO_MMAP_H_
+
+#include <string>
+#include <vector>
+#include <cinttypes>
+#include <cstddef>
+
+namespace pxr
+{
+namespace io
+{
+
+//
+// Read-only view of the entire contents of a file.
+//
+// On posix systems the file is memory mapped, on other systems (or if mapping fails) the file
+// is read into memory in a single read. Either way the contents can be decoded directly from
+// memory without any further syscalls.
+//
+class MappedFile
+{
+public:
+  MappedFile();
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool open(const std::string& filepath);
+  void close();
+
+  const uint8_t* getData() const {return _data;}
+  size_t getSize() const {return _size;}
+  bool isOpen() const {return _data != nullptr;}
+
+private:
+  bool readWhole(const std::string& filepath);
+
+private:
+  const uint8_t* _data;
+  size_t _size;
+  bool _isMapped;
+
+  //
+  // Holds the file contents when the file could not be mapped.
+  //
+  std::vector<uint8_t> _buffer;
+};
+
+//
+// Helper to read little-endian values from a byte buffer with bounds checking. Reads which
+// would overrun the buffer return false and set the reader into a failed state after which all
+// subsequent reads also fail.
+//
+class ByteReader
+{
+public:
+  ByteReader(const uint8_t* data, size_t size) : _data{data}, _size{size}, _pos{0}, _isFailed{false} {}
+
+  template<typename T> bool read(T& value)
+  {
+    if(_isFailed || _size - _pos < sizeof(T)){
+      _isFailed = true;
+      return false;
+    }
+    uint64_t raw {0};
+    for(size_t i = 0; i < sizeof(T); ++i)
+      raw |= static_cast<uint64_t>(_data[_pos + i]) << (i * 8);
+    value = static_cast<T>(raw);
+    _pos += sizeof(T);
+    return true;
+  }
+
+  bool seek(size_t pos)
+  {
+    if(_isFailed || pos > _size){
+      _isFailed = true;
+      return false;
+    }
+    _pos = pos;
+    return true;
+  }
+
+  bool skip(size_t bytes) {return seek(_pos + bytes);}
+
+  //
+  // Returns true if the range [pos, pos + bytes) lies within the buffer.
+  //
+  bool isInBounds(size_t pos, size_t bytes) const {return pos <= _size && bytes <= _size - pos;}
+
+  size_t getPosition() const {return _pos;}
+  size_t getSize() const {return _size;}
+  const uint8_t* getData() const {return _data;}
+  bool isFailed() const {return _isFailed;}
+
+private:
+  const uint8_t* _data;
+  size_t _size;
+  size_t _pos;
+  bool _isFailed;
+};
+
+} // namespace io
+} // namespace pxr
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef _PIXIRETRO_IO_QOI_H_
+#define _PIXIRETRO_IO_QOI_H_
+
+#include <string>
+#include <vector>
+#include <cinttypes>
+#include "pxr_bmp.h"
+
+namespace pxr
+{
+namespace io
+{
+
+//
+// Encodes and decodes QOI ("Quite OK Image", see qoiformat.org) images to and from Bmp images.
+//
+// QOI is a lossless format which typically compresses pixel art to a fraction of the size of
+// an uncompressed bitmap and decodes in a single pass. Bmp::load decodes files with the QOI
+// file extension via this class so QOI images can be used anywhere a bitmap can.
+//
+// QOI images are stored top row first, whereas Bmp images keep the origin in the bottom-left,
+// thus rows are flipped when coding.
+//
+class Qoi
+{
+public:
+  static constexpr const char* FILE_EXTENSION {".qoi"};
+
+public:
+  static bool decode(const uint8_t* data, size_t size, Bmp& image);
+  static void encode(const Bmp& image, std::vector<uint8_t>& data);
+  static bool save(const std::string& filepath, const Bmp& image);
+
+private:
+  static constexpr uint32_t QOIMAGIC {0x716f6966}; // "qoif" read big endian.
+  static constexpr int HEADER_SIZE_BYTES {14};
+  static constexpr int PADDING_SIZE_BYTES {8};
+
+  static constexpr uint8_t OP_INDEX {0x00};
+  static constexpr uint8_t OP_DIFF  {0x40};
+  static constexpr uint8_t OP_LUMA  {0x80};
+  static constexpr uint8_t OP_RUN   {0xc0};
+  static constexpr uint8_t OP_RGB   {0xfe};
+  static constexpr uint8_t OP_RGBA  {0xff};
+  static constexpr uint8_t OP_MASK  {0xc0};
+
+  static constexpr int MAX_RUN {62};
+  static constexpr int INDEX_SIZE {64};
+};
+
+} // namespace io
+} // namespace pxr
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef _PIXIRETRO_RESAMPLE_H_
+#define _PIXIRETRO_RESAMPLE_H_
+
+#include <vector>
+#include <cinttypes>
+
+namespace pxr
+{
+namespace sfx
+{
+
+//
+// Converts interleaved float samples from one sample rate to another with a Kaiser windowed
+// sinc filter, which band-limits the signal to the lower of the two rates so downsampling
+// does not alias and upsampling does not image.
+//
+// The filter is tabulated at construction for a number of fractional offsets (phases) between
+// input samples; an output sample is the dot product of the input about its position with the
+// filter of its phase. The quality trades filter length for speed:
+//
+//    RESAMPLE_FAST - 16 taps, the nearest of 64 phases; a polyphase filter bank.
+//
+//    RESAMPLE_BEST - 64 taps, interpolated between 512 phases; effectively the windowed sinc
+//                    evaluated at the exact position of every output sample.
+//
+// Tap counts are those for upsampling; downsampling widens the filter by the rate ratio.
+//
+class Resampler
+{
+public:
+  enum Quality
+  {
+    RESAMPLE_FAST,
+    RESAMPLE_BEST
+  };
+
+public:
+  Resampler();
+
+  void initialize(int inRate_hz, int outRate_hz, int quality);
+
+  int getInRate() const {return _inRate_hz;}
+  int getOutRate() const {return _outRate_hz;}
+  int getQuality() const {return _quality;}
+
+  //
+  // The number of frames output for a given number of input frames.
+  //
+  int getOutFrameCount(int inFrames) const;
+
+  //
+  // Resamples inFrames frames of numChannels interleaved samples into out, which must have
+  // room for getOutFrameCount(inFrames) frames. Input beyond either end is taken as silence.
+  //
+  void process(const float* in, int inFrames, int numChannels, float* out) const;
+
+private:
+  int _inRate_hz;
+  int _outRate_hz;
+  int _quality;
+  int _numTaps;
+  int _numPhases;
+
+  //
+  // Row p holds the taps for an output position p / _numPhases of the way from one input
+  // sample to the next; there are _numPhases + 1 rows so interpolation needs no wrap.
+  //
+  std::vector<float> _filters;
+};
+
+} // namespace sfx
+} // namespace pxr
+
+#endif
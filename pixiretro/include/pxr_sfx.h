@@ -3,6 +3,7 @@
 
 #include <SDL2/SDL_audio.h>
 #include <limits>
+#include <vector>
 
 namespace pxr
 {
@@ -15,6 +16,11 @@ namespace sfx
 constexpr const char* RESOURCE_PATH_SOUNDS = "assets/sounds/";
 constexpr const char* RESOURCE_PATH_MUSIC = "assets/music/";
 
+//
+// Where sounds converted to the device format are cached; safe to delete at any time.
+//
+constexpr const char* RESOURCE_PATH_SOUND_CACHE = "cache/sounds/";
+
 //
 // The type of unique keys mapped to sound resources. 
 //
@@ -56,7 +62,8 @@ enum OutputMode
 //
 // See SDL_audio.h for more details of audio sample formats.
 //
-// note: This module only supports little-endian integer output formats (designed for x86).
+// note: This module only supports little-endian integer output formats (designed for x86), 
+//       except for the native backend which supports only S16 and F32 output.
 // 
 // note: U16 == U16LSB
 //       U32 == U32LSB
@@ -73,12 +80,44 @@ enum SampleFormat : uint16_t
   SAMPLE_FORMAT_S16    = AUDIO_S16,    // Signed 16-bit samples little endian.
   SAMPLE_FORMAT_S32LSB = AUDIO_S32LSB, // Signed 32-bit samples little endian.
   SAMPLE_FORMAT_S32    = AUDIO_S32,    // Signed 32-bit samples little endian.
+  SAMPLE_FORMAT_F32LSB = AUDIO_F32LSB, // 32-bit float samples little endian (native backend only).
+};
+
+//
+// The mixer which plays sounds.
+//
+//    BACKEND_SDL_MIXER - sounds are played on SDL_mixer channels.
+//
+//    BACKEND_NATIVE    - sounds are mixed by the engine's own SIMD mixer (see pxr_mixer.h) 
+//                        in the SDL audio callback, bypassing SDL_mixer. Supports many more
+//                        simultaneous sounds (set _numMixChannels in the hundreds if needed)
+//                        and ramps all volume changes. Works with SDL's dummy audio driver
+//                        (SDL_AUDIODRIVER=dummy) for headless runs.
+//
+// Both backends expose the same api; channels are simply voices of the native mixer.
+//
+enum MixerBackend
+{
+  BACKEND_SDL_MIXER,
+  BACKEND_NATIVE
+};
+
+//
+// The quality of the resampling of sounds whose sampling frequency differs from the device's,
+// see pxr_resample.h. Sounds are converted once and cached on disk, so the cost of the best
+// quality is only paid the first time a sound is loaded.
+//
+enum ResampleQuality
+{
+  RESAMPLE_QUALITY_FAST,
+  RESAMPLE_QUALITY_BEST
 };
 
 static constexpr int DEFAULT_SAMPLING_FREQ_HZ {22050               };
 static constexpr int DEFAULT_SAMPLE_FORMAT    {SAMPLE_FORMAT_S16LSB};
 static constexpr int DEFAULT_CHUNK_SIZE       {4096                };
 static constexpr int DEFAULT_NUM_MIX_CHANNELS {16                  };
+static constexpr int DEFAULT_SOUND_BUDGET_KB  {32 * 1024           };
 
 struct SFXConfiguration
 {
@@ -87,6 +126,23 @@ struct SFXConfiguration
   int      _outputMode      {OutputMode::MONO        };
   int      _chunkSize       {DEFAULT_CHUNK_SIZE      };
   int      _numMixChannels  {DEFAULT_NUM_MIX_CHANNELS};
+  int      _backend         {BACKEND_SDL_MIXER       };
+  int      _resampleQuality {RESAMPLE_QUALITY_BEST   };
+
+  //
+  // The most memory loaded sounds may hold before the least recently played of those not
+  // playing are evicted; 0 is unlimited. See loadSoundWAV.
+  //
+  int      _soundBudget_kb  {DEFAULT_SOUND_BUDGET_KB };
+
+  //
+  // If set no audio device is opened; instead the mix is rendered offline to this wave file in
+  // lockstep with onUpdate, which renders dt seconds of audio each call (in whole chunks of
+  // _chunkSize frames). Music is streamed synchronously before every chunk, so given the same
+  // calls the file is the same bit for bit, whatever the speed of the machine. Always uses the
+  // native backend; set _sampleFormat to S16 or F32. The string must outlive the module.
+  //
+  const char* _renderPath   {nullptr                 };
 };
 
 //
@@ -100,11 +156,73 @@ bool initialize(SFXConfiguration sfxconf = SFXConfiguration{});
 void shutdown();
 
 //
-// Called by the engine every tick to service the module, e.g. to unload any sounds in the
-// unload queue.
+// Called by the engine every frame, dt being the real time since the last call, to service the
+// module, e.g. to unload any sounds in the unload queue and to queue the next node of a music
+// sequence. Must keep being called while the game is paused or sequenced music will stop at the
+// end of its current node. When rendering offline this also renders dt seconds of audio.
 //
 void onUpdate(float dt);
 
+//
+// Health of the link between the game thread and the audio thread. Calls which change playback
+// are queued as commands which the audio thread applies at the start of its next callback;
+// latency is the time from queueing a command to the audio thread applying it. High-water
+// marks are the most entries ever waiting in each queue and so show how close the queues
+// have come to overflowing (overflowing commands are dropped).
+//
+// Music nodes are prefetched on a worker thread while the node before them plays; a miss is a
+// node whose prefetch completed only after the node before it had ended, leaving a gap.
+//
+// Sound memory is the pcm held by loaded sounds against the budget; reloads are plays of
+// sounds which had been evicted.
+//
+// The audio callback is timed on the audio thread into histograms:
+//
+//    callback mix      - the time to fill one buffer; commands, voices and music.
+//
+//    callback interval - the time from the start of one callback to the start of the next,
+//                        which should be steady at the buffer period.
+//
+//    play latency      - the time from a play call to the callback which mixes the first
+//                        samples of the sound (the device's own buffering comes on top).
+//
+// An underrun is a callback which took longer to mix than its buffer takes to play, so the
+// device will have run dry.
+//
+struct TimingStats
+{
+  int   _count;
+  float _p50_ms;
+  float _p99_ms;
+  float _max_ms;
+};
+
+struct SFXStats
+{
+  int   _commandsApplied;
+  int   _commandsDropped;
+  float _commandLatencyMean_ms;
+  float _commandLatencyMax_ms;
+  int   _commandQueueHighWater;
+  int   _commandQueueCapacity;
+  int   _finishedQueueHighWater;
+  int   _finishedQueueCapacity;
+  int   _musicUnderruns;
+  int   _musicPrefetchHits;
+  int   _musicPrefetchMisses;
+  int   _soundMemory_kb;
+  int   _soundBudget_kb;
+  int   _soundEvictions;
+  int   _soundReloads;
+  TimingStats _callbackMix;
+  TimingStats _callbackInterval;
+  TimingStats _playLatency;
+  float _bufferPeriod_ms;
+  int   _audioUnderruns;
+};
+
+SFXStats getStats();
+
 //////////////////////////////////////////////////////////////////////////////////////////////////
 // SOUND EFFECTS
 //////////////////////////////////////////////////////////////////////////////////////////////////
@@ -138,7 +256,17 @@ static constexpr int MAX_VOLUME {128};
 extern ResourceKey_t errorSoundKey;
 
 //
-// Load a WAV sound.
+// Load a WAV sound. Both PCM and IMA ADPCM compressed sounds are supported (see pxr_wav.h);
+// compressed sounds are decoded on load.
+//
+// Sounds not already in the format the mixer plays are converted to it on load (resampled,
+// remixed to the device's number of channels and requantised) and the result is cached in
+// RESOURCE_PATH_SOUND_CACHE, from which later loads map it directly without any conversion.
+//
+// Loaded sounds are held in memory within the budget set in the configuration. When over
+// budget the least recently played sounds which are not playing have their data evicted;
+// their keys stay valid and an evicted sound is reloaded (from the cache) when next played.
+// Music is streamed from disk as it plays and so never counts against the budget.
 //
 // Returns the resouce key the sound is mapped to which is needed to later play the sound.
 //
@@ -161,6 +289,39 @@ ResourceKey_t loadSoundWAV(ResourceName_t soundName);
 //
 void queueUnloadSound(ResourceKey_t soundKey);
 
+//
+// The importance of a sound when channels run out. A play which finds every channel busy stops
+// the oldest play of the lowest priority no higher than its own and takes over its channel; if
+// all channels are playing sounds of higher priority the play fails. Sounds default to
+// PRIORITY_NORMAL.
+//
+enum SoundPriority
+{
+  PRIORITY_LOW,
+  PRIORITY_NORMAL,
+  PRIORITY_HIGH,
+  PRIORITY_CRITICAL,
+  PRIORITY_COUNT
+};
+
+void setSoundPriority(ResourceKey_t soundKey, int priority);
+
+//
+// Limits the number of channels a sound may play on at once; a play beyond the limit stops
+// the oldest play of the sound and takes over its channel. Useful for sounds which are
+// triggered in rapid succession so they cannot crowd out other sounds. A limit of 0 (the
+// default) is unlimited.
+//
+static constexpr int UNLIMITED_INSTANCES {0};
+
+void setSoundInstanceLimit(ResourceKey_t soundKey, int maxInstances);
+
+//
+// Makes the music duck (see setMusicDucking) while any play of the sound is playing, e.g. so
+// important cues cut through. Takes effect from the sound's next play.
+//
+void setSoundDucksMusic(ResourceKey_t soundKey, bool ducksMusic);
+
 //
 // Play a sound. These functions return the channel the sound is playing on which can be used to
 // manipulate the playback.
@@ -204,8 +365,15 @@ int getMusicVolume();
 // MUSIC FUNCTIONS
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
-static constexpr float PLAY_MUSIC_FOREVER {std::numeric_limits<float>::max()};
+static constexpr int PLAY_MUSIC_FOREVER {-1};
 
+//
+// A node plays its music for _playDuration_ms, fading in over the first _fadeInDuration_ms
+// and out over the last _fadeOutDuration_ms, and the next node in the sequence starts on the
+// very next sample. Nodes are timed in samples by the audio thread so transitions are exact
+// regardless of the frame rate or hitches in the game loop. A play duration of 
+// PLAY_MUSIC_FOREVER plays the node forever.
+//
 struct MusicSequenceNode
 {
   ResourceKey_t _musicKey;
@@ -222,12 +390,60 @@ void playMusic(MusicSequence_t sequence, bool loop = true);
 void stopMusic();
 void pauseMusic();
 void resumeMusic();
+
+//
+// Report the music as last heard, so reflect calls which change the music only once the audio
+// device has consumed them, i.e. up to one audio callback (see _chunkSize) later.
+//
 bool isMusicPlaying();
 bool isMusicPaused();
 bool isMusicFadingIn();
 bool isMusicFadingOut();
 void setMusicVolume(int volume);
 
+//////////////////////////////////////////////////////////////////////////////////////////////////
+// BUSES
+//////////////////////////////////////////////////////////////////////////////////////////////////
+
+//
+// Effects applied to whole groups of sources on the audio thread, in blocks, after mixing (see
+// pxr_bus.h); far cheaper than effects per channel. Each bus has a volume and a low-pass
+// filter, and the music bus also ducks under sounds set to duck it.
+//
+//    BUS_SFX    - all sound channels; only processed by the native backend, since SDL_mixer
+//                 mixes its channels itself (use channel volumes there instead).
+//
+//    BUS_MUSIC  - the music, on both backends.
+//
+//    BUS_MASTER - the final mix, on both backends.
+//
+// Changes are smoothed: volumes ramp over ramp_ms and cutoffs glide over glide_ms. A cutoff
+// of NO_LOW_PASS glides the filter open and then removes it. Buses left at full volume with no
+// filter cost nothing.
+//
+enum MixBus
+{
+  BUS_MASTER,
+  BUS_SFX,
+  BUS_MUSIC,
+  BUS_COUNT
+};
+
+static constexpr int NO_LOW_PASS {0};
+
+void setBusVolume(int bus, int volume, int ramp_ms = 0);
+void setBusLowPass(int bus, int cutoff_hz, int glide_ms = 0);
+
+//
+// The music falls to duckedVolume over attack_ms when a ducking sound starts and recovers over
+// release_ms once none are playing.
+//
+static constexpr int DEFAULT_DUCKED_VOLUME {48};
+static constexpr int DEFAULT_DUCK_ATTACK_MS {20};
+static constexpr int DEFAULT_DUCK_RELEASE_MS {400};
+
+void setMusicDucking(int duckedVolume, int attack_ms, int release_ms);
+
 } // namespace sfx
 } // namespace pxr
 
@@ -0,0 +1,50 @@
+#ifndef _PIXIRETRO_SIMD_H_
+#define _PIXIRETRO_SIMD_H_
+
+//
+// Detects the SIMD instruction sets enabled for the build and includes the matching intrinsics
+// headers. Code using SIMD should test these macros and always provide a scalar fallback.
+//
+//      PXR_SIMD_SSE2  - defined on all x86-64 builds (SSE2 is part of the base instruction set).
+//
+//      PXR_SIMD_SSSE3 - defined if the build enables SSSE3, see the PXR_ENABLE_SSSE3 cmake 
+//                       option (off by default, since the built binary then requires SSSE3).
+//
+//      PXR_SIMD_SSSE3_DISPATCH - defined if the build does not enable SSSE3 but the compiler can
+//                       build single functions for it; such functions are marked PXR_TARGET_SSSE3 
+//                       and must only be called if isSSSE3Supported() (checks the cpu at runtime).
+//
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PXR_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(PXR_SIMD_SSE2) && defined(__SSSE3__)
+#define PXR_SIMD_SSSE3
+#define PXR_TARGET_SSSE3
+#include <tmmintrin.h>
+#elif defined(PXR_SIMD_SSE2) && (defined(__GNUC__) || defined(__clang__))
+#define PXR_SIMD_SSSE3_DISPATCH
+#define PXR_TARGET_SSSE3 __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+#endif
+
+namespace pxr
+{
+
+#if defined(PXR_SIMD_SSSE3) || defined(PXR_SIMD_SSSE3_DISPATCH)
+inline bool isSSSE3Supported()
+{
+#ifdef PXR_SIMD_SSSE3
+  return true;
+#else
+  static const bool isSupported {__builtin_cpu_supports("ssse3") != 0};
+  return isSupported;
+#endif
+}
+#endif
+
+} // namespace pxr
+
+#endif
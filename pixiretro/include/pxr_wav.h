@@ -2,7 +2,10 @@
 #define _PIXIRETRO_WAVSOUND_H_
 
 #include <string>
+#include <fstream>
+#include <vector>
 #include <cinttypes>
+#include "pxr_mmap.h"
 
 namespace pxr
 {
@@ -13,11 +16,19 @@ namespace io
 // Represent a wave (.wav) sound file.
 //
 // This class only supports wave sounds with:
-//      
-//      sample depths == 8 or 16
+//
+//      sample depths == 8, 16 or 24, or IMA ADPCM (format 0x11) compressed
 //      num channels  == 1 or 2
 //
-// i.e. mono8, mono16, stereo8 or stereo16.
+// i.e. mono8, mono16, mono24, stereo8, stereo16 or stereo24.
+//
+// The file is memory mapped and kept mapped for the lifetime of the loaded sound; the sample
+// data is not copied but points directly into the mapping. Thus the sample data is only valid
+// until the next call to load or until the Wav is destroyed.
+//
+// IMA ADPCM sounds are the exception; they are decoded once on load (or decode) to 16-bit 
+// samples held by the Wav, and the mapping is released. They are thereafter indistinguishable from 16-bit
+// sounds.
 //
 class Wav
 {
@@ -26,73 +37,182 @@ public:
 
 public:
   Wav();
-  ~Wav();
+  ~Wav() = default;
+
+  Wav(const Wav&) = delete;
+  Wav& operator=(const Wav&) = delete;
 
   bool load(std::string filepath);
+  void unload();
+
+  //
+  // Load in two steps: open maps the file and reads only its headers, so the format can be
+  // checked (and the file's bytes read) before paying to decode anything; decode then makes
+  // the sample data available. For uncompressed sounds decode does nothing, the sample data
+  // being the mapping itself. Compressed sounds release the mapping as they are decoded.
+  //
+  bool open(std::string filepath);
+  void decode();
+
+  //
+  // The whole file as mapped; only valid between open and decode for compressed sounds.
+  //
+  const uint8_t* getFileData() const {return _file.getData();}
+  size_t getFileSize() const {return _file.getSize();}
+
+  //
+  // Encodes a loaded 16-bit sound as IMA ADPCM and writes it as a wave file, for use in place
+  // of the original at a quarter of the size.
+  //
+  static bool saveImaAdpcm(const std::string& filepath, const Wav& source);
 
-  const void* getSampleData() const {return reinterpret_cast<void*>(_waveData);}
+  //
+  // Sample data is stored exactly as in the file, i.e. for stereo sounds the samples are
+  // interleaved with the left channel coming first (lower index) than the right. 8-bit samples
+  // are unsigned whereas 16-bit and 24-bit samples are signed little-endian.
+  //
+  const void* getSampleData() const {return reinterpret_cast<const void*>(_sampleData);}
   int getSampleDataSize() const {return _waveSizeBytes;}
   int getSampleRate() const {return _sampleRate;}
   int getNumChannels() const {return _numChannels;}
   int getBitsPerSample() const {return _bitsPerSample;}
+  int getFrameCount() const {return _blockAlign > 0 ? _waveSizeBytes / _blockAlign : 0;}
 
 private:
 
   //
-  // These magics are in little endian format.
-  //
-  static constexpr int32_t RIFFMAGIC   {0x46464952};
-  static constexpr int32_t WAVEMAGIC   {0x45564157};
-  static constexpr int32_t FORMATMAGIC {0x20746d66};
-  static constexpr int32_t DATAMAGIC   {0x61746164};
-
-  //
-  // Used to guard against excessive file sizes.
+  // Used to guard against excessive file sizes. Larger sounds should be streamed with a
+  // WavStream instead.
   //
   static constexpr int ONE_MEBIBYTE {1024 * 1024};
   static constexpr int SOUND_DATA_SIZE_MAX_BYTES {10 * ONE_MEBIBYTE};
 
-  struct RiffHeader
-  {
-    int32_t _riffMagic;
-    int32_t _chunkSize;
-    int32_t _waveMagic;
-  };
-
-  struct FormatSubChunk
-  {
-    int32_t _formatMagic;
-    int32_t _subChunkSize;
-    int16_t _audioFormat;
-    int16_t _numChannels;
-    int32_t _sampleRate;
-    int32_t _byteRate;
-    int16_t _blockAlign;
-    int16_t _bitsPerSample;
-  };
-
-  struct DataSubChunk
-  {
-    int32_t _dataMagic;
-    int32_t _subChunkSize;
-  };
+  //
+  // The size of the code data of each channel of an encoded block.
+  //
+  static constexpr int IMA_CHANNEL_CODE_BYTES {508};
 
 private:
-  void unload();
+  MappedFile _file;
 
-private:
+  //
+  // The samples of compressed sounds.
+  //
+  std::vector<int16_t> _decoded;
 
   //
-  // Raw wave sound data. For stereo data the samples are interleaved with the left channel
-  // coming first (lower index) than the right. This formatting is such as to be compatible
-  // with openal.
+  // Points into the mapped file, or to the decoded samples.
   //
-  char* _waveData;
+  const uint8_t* _sampleData;
 
   int _waveSizeBytes;
   int _sampleRate;
   int _bitsPerSample;
   int _numChannels;
+  int _blockAlign;
+
+  //
+  // The layout of compressed data still to be decoded; _samplesPerBlock is 0 otherwise.
+  //
+  size_t _encodedOffset;
+  size_t _encodedBlocks;
+  int _encodedBlockAlign;
+  int _samplesPerBlock;
+};
+
+//
+// Reads the sample data of a wave file incrementally from disk so that only the data being
+// read is ever in memory; intended for long sounds such as music loops. Supports the same
+// formats as Wav.
+//
+// IMA ADPCM data is read a few blocks at a time and decoded as it is read, so the stream reads
+// like a 16-bit stream while only a quarter of the bytes are read from disk.
+//
+class WavStream
+{
+public:
+  WavStream();
+  ~WavStream() = default;
+
+  WavStream(const WavStream&) = delete;
+  WavStream& operator=(const WavStream&) = delete;
+
+  bool open(const std::string& filepath);
+  void close();
+
+  //
+  // Reads up to maxBytes of sample data into dst, only ever reading whole frames. Returns the
+  // number of bytes read which is 0 once the end of the data is reached. The data of compressed
+  // streams is returned decoded.
+  //
+  size_t read(uint8_t* dst, size_t maxBytes);
+
+  //
+  // Seeks back to the first sample frame.
+  //
+  void rewind();
+
+  bool isOpen() const {return _file.is_open();}
+  int getSampleDataSize() const {return static_cast<int>(_frameCount * _numChannels * (_bitsPerSample / 8));}
+  int getSampleRate() const {return _sampleRate;}
+  int getNumChannels() const {return _numChannels;}
+  int getBitsPerSample() const {return _bitsPerSample;}
+  int getFrameCount() const {return static_cast<int>(_frameCount);}
+
+private:
+  size_t readCompressed(uint8_t* dst, size_t maxBytes);
+  bool decodeNextBlocks();
+
+private:
+  std::ifstream _file;
+  size_t _dataOffset;
+  size_t _dataSize;
+  size_t _position;
+  size_t _frameCount;
+  int _sampleRate;
+  int _bitsPerSample;
+  int _numChannels;
+
+  //
+  // The size of a frame in the file, or of a block of compressed frames.
+  //
+  int _blockAlign;
+
+  //
+  // Compressed streams only; 0 for uncompressed streams.
+  //
+  int _samplesPerBlock;
+  size_t _framesDecoded;
+  std::vector<uint8_t> _blocks;
+  std::vector<int16_t> _decoded;
+  size_t _decodedPosition;
+};
+
+//
+// Writes a wave file incrementally as samples are produced, e.g. to record a mix. Writes
+// 16-bit integer or 32-bit float samples. The sizes in the headers are only known once all
+// samples are written so are filled in by close; a file not closed has zero sizes.
+//
+class WavWriter
+{
+public:
+  WavWriter();
+  ~WavWriter();
+
+  WavWriter(const WavWriter&) = delete;
+  WavWriter& operator=(const WavWriter&) = delete;
+
+  bool open(const std::string& filepath, int sampleRate, int numChannels, bool isFloat);
+  bool write(const void* samples, size_t bytes);
+  bool close();
+
+  bool isOpen() const {return _file.is_open();}
+  size_t getFrameCount() const {return _blockAlign > 0 ? _dataSize / _blockAlign : 0;}
+
+private:
+  std::ofstream _file;
+  size_t _dataSize;
+  int _blockAlign;
 };
 
 } // namespace io
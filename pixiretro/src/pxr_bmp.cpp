@@ -5,13 +5,16 @@
 
 #include <cinttypes>
 #include <vector>
-#include <fstream>
 #include <cmath>
 #include <cstring>
 #include <cassert>
+#include <algorithm>
 #include <sstream>
 #include "../include/pxr_color.h"
 #include "../include/pxr_bmp.h"
+#include "../include/pxr_mmap.h"
+#include "../include/pxr_qoi.h"
+#include "../include/pxr_simd.h"
 #include "../include/pxr_log.h"
 
 namespace pxr
@@ -19,130 +22,290 @@ namespace pxr
 namespace io
 {
 
-Bmp::Bmp() :
-  _pixels{nullptr},
-  _size{0,0}
-{}
+//
+// Pixel layouts with dedicated row converters. Layouts are named by their byte order in the 
+// file, e.g. BGRA32 stores blue in the first byte. An X channel is padding which converts to 
+// alpha=0 as with the generic masked conversion.
+//
+enum class PixelLayout
+{
+  GENERIC,
+  BGRA32,
+  BGRX32,
+  ARGB32,
+  BGR24,
+  RGB555,
+  RGB565
+};
+
+static PixelLayout choosePixelLayout(int bitsPerPixel, uint32_t redMask, uint32_t greenMask, 
+                                     uint32_t blueMask, uint32_t alphaMask)
+{
+  if(bitsPerPixel == 32 && redMask == 0x00ff0000 && greenMask == 0x0000ff00 && blueMask == 0x000000ff){
+    if(alphaMask == 0xff000000) return PixelLayout::BGRA32;
+    if(alphaMask == 0x00000000) return PixelLayout::BGRX32;
+  }
+  if(bitsPerPixel == 32 && redMask == 0x0000ff00 && greenMask == 0x00ff0000 && 
+     blueMask == 0xff000000 && alphaMask == 0x000000ff)
+    return PixelLayout::ARGB32;
+  if(bitsPerPixel == 24 && redMask == 0xff0000 && greenMask == 0x00ff00 && blueMask == 0x0000ff)
+    return PixelLayout::BGR24;
+  if(bitsPerPixel == 16 && redMask == 0x7c00 && greenMask == 0x03e0 && blueMask == 0x001f &&
+     (alphaMask == 0x8000 || alphaMask == 0))
+    return PixelLayout::RGB555;
+  if(bitsPerPixel == 16 && redMask == 0xf800 && greenMask == 0x07e0 && blueMask == 0x001f && alphaMask == 0)
+    return PixelLayout::RGB565;
+  return PixelLayout::GENERIC;
+}
 
-Bmp::~Bmp()
+//
+// Row converters. All converters produce exactly the result of the generic masked conversion,
+// i.e. channels are extracted by mask and shift but are not rescaled to 8-bits.
+//
+// The 32-bit converters process 4 pixels per iteration with SSE2 lane shifts; the 24-bit 
+// converter needs SSSE3 byte shuffles (used only if the cpu has them, see pxr_simd.h); the 
+// 16-bit converters process 8 pixels per iteration.
+//
+static inline uint32_t loadPixel32(const uint8_t* src)
 {
-  freePixels();
+  uint32_t raw;
+  memcpy(&raw, src, sizeof(raw));
+  return raw;
 }
 
-Bmp::Bmp(const Bmp& other) :
-  _pixels{nullptr},
-  _size{0, 0}
+static void convertRowBGRA32(const uint8_t* src, gfx::Color4u* dst, int width, uint32_t alphaMask)
 {
-  _size = other._size;
-  _pixels = new gfx::Color4u*[_size._y];
-  for(int row = 0; row < _size._y; ++row){
-    _pixels[row] = new gfx::Color4u[_size._x];
-    memcpy(static_cast<void*>(_pixels[row]), static_cast<void*>(other._pixels[row]), _size._x * sizeof(gfx::Color4u));
+  int col {0};
+#ifdef PXR_SIMD_SSE2
+  const __m128i rbMask = _mm_set1_epi32(0x000000ff);
+  const __m128i gMask = _mm_set1_epi32(0x0000ff00);
+  const __m128i aMask = _mm_set1_epi32(alphaMask);
+  for(; col + 4 <= width; col += 4){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (col * 4)));
+    __m128i r = _mm_and_si128(_mm_srli_epi32(v, 16), rbMask);
+    __m128i b = _mm_slli_epi32(_mm_and_si128(v, rbMask), 16);
+    __m128i ga = _mm_and_si128(v, _mm_or_si128(gMask, aMask));
+    __m128i rgba = _mm_or_si128(_mm_or_si128(r, b), ga);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + col), rgba);
+  }
+#endif
+  for(; col < width; ++col){
+    uint32_t raw = loadPixel32(src + (col * 4));
+    dst[col] = gfx::Color4u{
+      static_cast<uint8_t>(raw >> 16), 
+      static_cast<uint8_t>(raw >> 8), 
+      static_cast<uint8_t>(raw), 
+      static_cast<uint8_t>((raw & alphaMask) >> 24)
+    };
   }
 }
 
-Bmp::Bmp(Bmp&& other)
+static void convertRowARGB32(const uint8_t* src, gfx::Color4u* dst, int width)
 {
-  _pixels = other._pixels;
-  other._pixels = nullptr;
-  _size = other._size;
-  other._size.zero();
+  int col {0};
+#ifdef PXR_SIMD_SSE2
+  for(; col + 4 <= width; col += 4){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (col * 4)));
+    __m128i rgba = _mm_or_si128(_mm_srli_epi32(v, 8), _mm_slli_epi32(v, 24));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + col), rgba);
+  }
+#endif
+  for(; col < width; ++col){
+    uint32_t raw = loadPixel32(src + (col * 4));
+    dst[col] = gfx::Color4u{
+      static_cast<uint8_t>(raw >> 8), 
+      static_cast<uint8_t>(raw >> 16), 
+      static_cast<uint8_t>(raw >> 24), 
+      static_cast<uint8_t>(raw)
+    };
+  }
 }
 
-Bmp& Bmp::operator=(const Bmp& other)
+#if defined(PXR_SIMD_SSSE3) || defined(PXR_SIMD_SSSE3_DISPATCH)
+//
+// Returns the number of pixels converted; the rest are left to the scalar loop.
+//
+PXR_TARGET_SSSE3 static int convertRowBGR24SSSE3(const uint8_t* src, gfx::Color4u* dst, int width)
 {
-  if(_pixels != nullptr && _size == other._size){ 
-    for(int row = 0; row < _size._y; ++row){
-      memcpy(static_cast<void*>(_pixels[row]), static_cast<void*>(other._pixels[row]), _size._x * sizeof(gfx::Color4u));
-    }
-    return *this;
+  int col {0};
+  // each iteration converts 4 pixels (12 bytes) but loads 16 bytes thus stop early.
+  const __m128i shuffle = _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+  for(; (col * 3) + 16 <= width * 3; col += 4){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (col * 3)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + col), _mm_shuffle_epi8(v, shuffle));
   }
+  return col;
+}
+#endif
 
-  freePixels();
-  _size = other._size;
-  _pixels = new gfx::Color4u*[_size._y];
-  for(int row = 0; row < _size._y; ++row){
-    _pixels[row] = new gfx::Color4u[_size._x];
-    memcpy(static_cast<void*>(_pixels[row]), static_cast<void*>(other._pixels[row]), _size._x * sizeof(gfx::Color4u));
+static void convertRowBGR24(const uint8_t* src, gfx::Color4u* dst, int width)
+{
+  int col {0};
+#if defined(PXR_SIMD_SSSE3) || defined(PXR_SIMD_SSSE3_DISPATCH)
+  if(isSSSE3Supported())
+    col = convertRowBGR24SSSE3(src, dst, width);
+#endif
+  for(; col < width; ++col){
+    const uint8_t* px = src + (col * 3);
+    dst[col] = gfx::Color4u{px[2], px[1], px[0], 0};
   }
-  return *this;
+}
+
+template<int RedShift, int GreenShift, int BlueShift, int AlphaShift>
+static void convertRow16(const uint8_t* src, gfx::Color4u* dst, int width, uint16_t redMask, 
+                         uint16_t greenMask, uint16_t blueMask, uint16_t alphaMask)
+{
+  int col {0};
+#ifdef PXR_SIMD_SSE2
+  const __m128i rMask = _mm_set1_epi16(redMask);
+  const __m128i gMask = _mm_set1_epi16(greenMask);
+  const __m128i bMask = _mm_set1_epi16(blueMask);
+  const __m128i aMask = _mm_set1_epi16(alphaMask);
+  for(; col + 8 <= width; col += 8){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + (col * 2)));
+    __m128i r = _mm_srli_epi16(_mm_and_si128(v, rMask), RedShift);
+    __m128i g = _mm_srli_epi16(_mm_and_si128(v, gMask), GreenShift);
+    __m128i b = _mm_srli_epi16(_mm_and_si128(v, bMask), BlueShift);
+    __m128i a = _mm_srli_epi16(_mm_and_si128(v, aMask), AlphaShift);
+    __m128i rg = _mm_or_si128(r, _mm_slli_epi16(g, 8));
+    __m128i ba = _mm_or_si128(b, _mm_slli_epi16(a, 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + col), _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + col + 4), _mm_unpackhi_epi16(rg, ba));
+  }
+#endif
+  for(; col < width; ++col){
+    uint16_t raw = static_cast<uint16_t>(src[col * 2] | (src[(col * 2) + 1] << 8));
+    dst[col] = gfx::Color4u{
+      static_cast<uint8_t>((raw & redMask) >> RedShift), 
+      static_cast<uint8_t>((raw & greenMask) >> GreenShift), 
+      static_cast<uint8_t>((raw & blueMask) >> BlueShift), 
+      static_cast<uint8_t>((raw & alphaMask) >> AlphaShift)
+    };
+  }
+}
+
+Bmp::Bmp() :
+  _storage{},
+  _pixels{nullptr},
+  _size{0,0},
+  _stride{0}
+{}
+
+//
+// Copies share the pixel storage of the original; see detachPixels.
+//
+Bmp::Bmp(const Bmp& other) = default;
+Bmp& Bmp::operator=(const Bmp& other) = default;
+
+Bmp::Bmp(Bmp&& other) :
+  _storage{std::move(other._storage)},
+  _pixels{other._pixels},
+  _size{other._size},
+  _stride{other._stride}
+{
+  other._pixels = nullptr;
+  other._size.zero();
+  other._stride = 0;
 }
 
 Bmp& Bmp::operator=(Bmp&& other)
 {
-  freePixels();   
+  _storage = std::move(other._storage);
   _pixels = other._pixels;
-  other._pixels = nullptr;
   _size = other._size;
+  _stride = other._stride;
+  other._pixels = nullptr;
   other._size.zero();
+  other._stride = 0;
   return *this;
 }
 
 const gfx::Color4u Bmp::getPixel(int row, int col)
 {
   assert(0 <= row && row < _size._y);
-  assert(0 <= col && col <= _size._x);
-  return _pixels[row][col];
+  assert(0 <= col && col < _size._x);
+  return _pixels[(row * _stride) + col];
 }
 
 const gfx::Color4u* Bmp::getRow(int row)
 {
   assert(0 <= row && row < _size._y);
-  return _pixels[row];
+  return _pixels + (row * _stride);
 }
 
 bool Bmp::load(std::string filepath)
 {
-  std::ifstream file {filepath, std::ios_base::binary};
-  if(!file){
+  MappedFile file {};
+  if(!file.open(filepath)){
     log::log(log::ERROR, log::msg_bmp_fail_open, filepath);
     return false;
   }
 
+  std::string extension {Qoi::FILE_EXTENSION};
+  if(filepath.size() >= extension.size() && 
+     filepath.compare(filepath.size() - extension.size(), extension.size(), extension) == 0)
+  {
+    if(!Qoi::decode(file.getData(), file.getSize(), *this)){
+      log::log(log::ERROR, log::msg_bmp_qoi_corrupted, filepath);
+      return false;
+    }
+    return true;
+  }
+
+  ByteReader reader {file.getData(), file.getSize()};
+
   FileHeader fileHead {};
-  file.read(reinterpret_cast<char*>(&fileHead._fileMagic), sizeof(fileHead._fileMagic));
+  reader.read(fileHead._fileMagic);
 
   if(fileHead._fileMagic != BMPMAGIC){
     log::log(log::ERROR, log::msg_bmp_corrupted, filepath);
     return false;
   }
 
-  file.read(reinterpret_cast<char*>(&fileHead._fileSize_bytes), sizeof(fileHead._fileSize_bytes));
-  file.read(reinterpret_cast<char*>(&fileHead._reserved0), sizeof(fileHead._reserved0));
-  file.read(reinterpret_cast<char*>(&fileHead._reserved1), sizeof(fileHead._reserved1));
-  file.read(reinterpret_cast<char*>(&fileHead._pixelOffset_bytes), sizeof(fileHead._pixelOffset_bytes));
+  reader.read(fileHead._fileSize_bytes);
+  reader.read(fileHead._reserved0);
+  reader.read(fileHead._reserved1);
+  reader.read(fileHead._pixelOffset_bytes);
 
   InfoHeader infoHead {};
-  file.read(reinterpret_cast<char*>(&infoHead._headerSize_bytes), sizeof(infoHead._headerSize_bytes));
-  file.read(reinterpret_cast<char*>(&infoHead._bmpWidth_px), sizeof(infoHead._bmpWidth_px));
-  file.read(reinterpret_cast<char*>(&infoHead._bmpHeight_px), sizeof(infoHead._bmpHeight_px));
-  file.read(reinterpret_cast<char*>(&infoHead._numColorPlanes), sizeof(infoHead._numColorPlanes));
-  file.read(reinterpret_cast<char*>(&infoHead._bitsPerPixel), sizeof(infoHead._bitsPerPixel));
-  file.read(reinterpret_cast<char*>(&infoHead._compression), sizeof(infoHead._compression));
-  file.read(reinterpret_cast<char*>(&infoHead._imageSize_bytes), sizeof(infoHead._imageSize_bytes));
-  file.read(reinterpret_cast<char*>(&infoHead._xResolution_pxPm), sizeof(infoHead._xResolution_pxPm));
-  file.read(reinterpret_cast<char*>(&infoHead._yResolution_pxPm), sizeof(infoHead._yResolution_pxPm));
-  file.read(reinterpret_cast<char*>(&infoHead._numPaletteColors), sizeof(infoHead._numPaletteColors));
-  file.read(reinterpret_cast<char*>(&infoHead._numImportantColors), sizeof(infoHead._numImportantColors));
+  reader.read(infoHead._headerSize_bytes);
+  reader.read(infoHead._bmpWidth_px);
+  reader.read(infoHead._bmpHeight_px);
+  reader.read(infoHead._numColorPlanes);
+  reader.read(infoHead._bitsPerPixel);
+  reader.read(infoHead._compression);
+  reader.read(infoHead._imageSize_bytes);
+  reader.read(infoHead._xResolution_pxPm);
+  reader.read(infoHead._yResolution_pxPm);
+  reader.read(infoHead._numPaletteColors);
+  reader.read(infoHead._numImportantColors);
+
+  if(reader.isFailed() || 
+     infoHead._headerSize_bytes < V1INFOHEADER_SIZE_BYTES || 
+     !reader.isInBounds(FILEHEADER_SIZE_BYTES, infoHead._headerSize_bytes))
+  {
+    log::log(log::ERROR, log::msg_bmp_corrupted, filepath);
+    return false;
+  }
 
   int infoHeadVersion {1};
 
   if(infoHead._headerSize_bytes >= V2INFOHEADER_SIZE_BYTES ||
     (infoHead._headerSize_bytes == V1INFOHEADER_SIZE_BYTES && infoHead._compression == BI_BITFIELDS))
   {
-    file.read(reinterpret_cast<char*>(&infoHead._redMask), sizeof(infoHead._redMask));
-    file.read(reinterpret_cast<char*>(&infoHead._greenMask), sizeof(infoHead._greenMask));
-    file.read(reinterpret_cast<char*>(&infoHead._blueMask), sizeof(infoHead._blueMask));
+    reader.read(infoHead._redMask);
+    reader.read(infoHead._greenMask);
+    reader.read(infoHead._blueMask);
     infoHeadVersion = 2;
   }
 
   if(infoHead._headerSize_bytes >= V3INFOHEADER_SIZE_BYTES){
-    file.read(reinterpret_cast<char*>(&infoHead._alphaMask), sizeof(infoHead._alphaMask));
+    reader.read(infoHead._alphaMask);
     infoHeadVersion = 3;
   }
 
   if(infoHead._headerSize_bytes >= V4INFOHEADER_SIZE_BYTES){
-    file.read(reinterpret_cast<char*>(&infoHead._colorSpaceMagic), sizeof(infoHead._colorSpaceMagic));
+    reader.read(infoHead._colorSpaceMagic);
     if(infoHead._colorSpaceMagic != SRGBMAGIC){
       log::log(log::ERROR, log::msg_bmp_unsupported_colorspace, std::string{});
       return false;
@@ -154,28 +317,59 @@ bool Bmp::load(std::string filepath)
     infoHeadVersion = 5;
   }
 
-  if(infoHead._compression != BI_RGB && infoHead._compression != BI_BITFIELDS){
+  if(reader.isFailed()){
+    log::log(log::ERROR, log::msg_bmp_corrupted, filepath);
+    return false;
+  }
+
+  bool isRle = (infoHead._compression == BI_RLE8 && infoHead._bitsPerPixel == 8) ||
+               (infoHead._compression == BI_RLE4 && infoHead._bitsPerPixel == 4);
+
+  if(infoHead._compression != BI_RGB && infoHead._compression != BI_BITFIELDS && !isRle){
     log::log(log::ERROR, log::msg_bmp_unsupported_compression, std::string{});
     return false;
   }
 
-  _size = Vector2i{infoHead._bmpWidth_px, std::abs(infoHead._bmpHeight_px)};
-  if(_size._x <= 0 || _size._y <= 0 || _size._x > BMP_MAX_WIDTH || _size._y > BMP_MAX_HEIGHT){
+  // run-length encoded bitmaps cannot be top-down.
+  if(isRle && infoHead._bmpHeight_px < 0){
+    log::log(log::ERROR, log::msg_bmp_corrupted, filepath);
+    return false;
+  }
+
+  Vector2i size {infoHead._bmpWidth_px, std::abs(infoHead._bmpHeight_px)};
+  if(size._x <= 0 || size._y <= 0 || size._x > BMP_MAX_WIDTH || size._y > BMP_MAX_HEIGHT){
     std::stringstream ss{};
-    ss << "[w:" << _size._x << ",h:" << _size._y << "]";
+    ss << "[w:" << size._x << ",h:" << size._y << "]";
     log::log(log::ERROR, log::msg_bmp_unsupported_size, ss.str());
     return false;
   }
 
+  //
+  // Validate the pixel array lies within the file before decoding so the decoders can read
+  // the mapping unchecked. The size of run-length encoded data is not known until decoded so
+  // the rle decoder checks its reads as it goes.
+  //
+  int rowSize_bytes = std::ceil((infoHead._bitsPerPixel * infoHead._bmpWidth_px) / 32.f) * 4.f;  
+  size_t pixelArraySize_bytes = isRle ? 0 : static_cast<size_t>(rowSize_bytes) * size._y;
+  if(!reader.isInBounds(fileHead._pixelOffset_bytes, pixelArraySize_bytes)){
+    log::log(log::ERROR, log::msg_bmp_corrupted, filepath);
+    return false;
+  }
+
+  _size = size;
   reallocatePixels();
 
+  bool isExtracted {false};
   switch(infoHead._bitsPerPixel)
   {
   case 1:
   case 2:
   case 4:
   case 8:
-    extractIndexedPixels(file, fileHead, infoHead);
+    if(isRle)
+      isExtracted = extractRlePixels(reader, fileHead, infoHead);
+    else
+      isExtracted = extractIndexedPixels(reader, fileHead, infoHead);
     break;
   case 16:
     if(infoHead._compression == BI_RGB){
@@ -185,14 +379,14 @@ bool Bmp::load(std::string filepath)
       if(infoHeadVersion < 3)
         infoHead._alphaMask = 0x8000;
     }
-    extractPixels(file, fileHead, infoHead); 
+    isExtracted = extractPixels(reader, fileHead, infoHead); 
     break;
   case 24:
     infoHead._redMask   = 0xff0000;      // default masks.
     infoHead._greenMask = 0x00ff00;
     infoHead._blueMask  = 0x0000ff;
     infoHead._alphaMask = 0x000000;
-    extractPixels(file, fileHead, infoHead); 
+    isExtracted = extractPixels(reader, fileHead, infoHead); 
     break;
   case 32:
     if(infoHead._compression == BI_RGB){
@@ -202,10 +396,17 @@ bool Bmp::load(std::string filepath)
       if(infoHeadVersion < 3)
         infoHead._alphaMask = 0xff000000;
     }
-    extractPixels(file, fileHead, infoHead); 
+    isExtracted = extractPixels(reader, fileHead, infoHead); 
     break;
   }
 
+  if(!isExtracted){
+    log::log(log::ERROR, log::msg_bmp_corrupted, filepath);
+    freePixels();
+    _size.zero();
+    return false;
+  }
+
   return true;
 }
 
@@ -221,47 +422,82 @@ void Bmp::clear(gfx::Color4u color)
   if(_pixels == nullptr)
     return;
 
-  for(int row = 0; row < _size._y; ++row)
-    for(int col = 0; col < _size._x; ++col)
-      _pixels[row][col] = color;
+  // no need to copy the shared pixels since all are overwritten.
+  if(_storage.use_count() > 1)
+    reallocatePixels();
+
+  std::fill(_pixels, _pixels + getPixelCount(), color);
+}
+
+gfx::Color4u* Bmp::getPixelsMutable()
+{
+  detachPixels();
+  return _pixels;
+}
+
+void Bmp::detachPixels()
+{
+  if(_storage.use_count() <= 1)
+    return;
+
+  std::shared_ptr<gfx::Color4u[]> shared {std::move(_storage)};
+  reallocatePixels();
+  memcpy(static_cast<void*>(_pixels), static_cast<const void*>(shared.get()), getPixelCount() * sizeof(gfx::Color4u));
 }
 
 void Bmp::freePixels()
 {
-  if(_pixels != nullptr){
-    for(int row = 0; row < _size._y; ++row)
-      delete[] _pixels[row];
-    delete[] _pixels;
-  }
+  _storage.reset();
   _pixels = nullptr;
 }
 
+//
+// Always allocates new storage thus never modifies pixels shared with other images.
+//
 void Bmp::reallocatePixels()
 {
-  freePixels();
-  _pixels = new gfx::Color4u*[_size._y];
-  for(int row = 0; row < _size._y; ++row)
-    _pixels[row] = new gfx::Color4u[_size._x];
+  _stride = _size._x;
+  _storage.reset(new gfx::Color4u[getPixelCount()]);
+  _pixels = _storage.get();
 }
 
-void Bmp::extractIndexedPixels(std::ifstream& file, FileHeader& fileHead, InfoHeader& infoHead)
+bool Bmp::extractPalette(const ByteReader& reader, const InfoHeader& infoHead, std::vector<gfx::Color4u>& palette)
 {
-  // extract the color palette.
-  std::vector<gfx::Color4u> palette {};
-  file.seekg(FILEHEADER_SIZE_BYTES + infoHead._headerSize_bytes, std::ios::beg);
-  for(uint8_t i = 0; i < infoHead._numPaletteColors; ++i){
-    char bytes[4];
-    file.read(bytes, 4);
+  int maxPaletteColors = 0x01 << infoHead._bitsPerPixel;
+  int numPaletteColors = infoHead._numPaletteColors == 0 ? maxPaletteColors : infoHead._numPaletteColors;
+  numPaletteColors = std::min(numPaletteColors, maxPaletteColors);
 
-    // colors expected in the byte order blue (0), green (1), red (2), alpha (3).
-    uint8_t red = static_cast<uint8_t>(bytes[2]);
-    uint8_t green = static_cast<uint8_t>(bytes[1]);
-    uint8_t blue = static_cast<uint8_t>(bytes[0]);
-    uint8_t alpha = static_cast<uint8_t>(bytes[3]);
+  size_t paletteOffset_bytes = FILEHEADER_SIZE_BYTES + infoHead._headerSize_bytes;
+  if(!reader.isInBounds(paletteOffset_bytes, numPaletteColors * 4))
+    return false;
 
-    palette.push_back(gfx::Color4u{red, green, blue, alpha});
+  // unused indices are left transparent.
+  palette.assign(maxPaletteColors, gfx::Color4u{0, 0, 0, 0});
+  const uint8_t* bytes = reader.getData() + paletteOffset_bytes;
+  bool hasAlpha {false};
+  for(int i = 0; i < numPaletteColors; ++i, bytes += 4){
+    // colors expected in the byte order blue (0), green (1), red (2), alpha (3).
+    palette[i] = gfx::Color4u{bytes[2], bytes[1], bytes[0], bytes[3]};
+    hasAlpha |= (bytes[3] != 0);
   }
 
+  //
+  // Most editors write the 4th palette byte as a reserved zero rather than an alpha, which 
+  // would make every pixel transparent; treat such palettes as opaque.
+  //
+  if(!hasAlpha)
+    for(int i = 0; i < numPaletteColors; ++i)
+      palette[i]._a = 255;
+
+  return true;
+}
+
+bool Bmp::extractIndexedPixels(const ByteReader& reader, const FileHeader& fileHead, const InfoHeader& infoHead)
+{
+  std::vector<gfx::Color4u> palette {};
+  if(!extractPalette(reader, infoHead, palette))
+    return false;
+
   int rowSize_bytes = std::ceil((infoHead._bitsPerPixel * infoHead._bmpWidth_px) / 32.f) * 4.f;  
   int numPixelsPerByte = 8 / infoHead._bitsPerPixel;
 
@@ -271,43 +507,115 @@ void Bmp::extractIndexedPixels(std::ifstream& file, FileHeader& fileHead, InfoHe
 
   int numRows = std::abs(infoHead._bmpHeight_px);
   bool isTopOrigin = (infoHead._bmpHeight_px < 0);
-  int pixelOffset_bytes = static_cast<int>(fileHead._pixelOffset_bytes);
+  const uint8_t* rowBytes = reader.getData() + fileHead._pixelOffset_bytes;
   int rowOffset_bytes {rowSize_bytes};
   if(isTopOrigin){
-    pixelOffset_bytes += (numRows - 1) * rowSize_bytes;
+    rowBytes += (numRows - 1) * rowSize_bytes;
     rowOffset_bytes *= -1;
   }
 
-  int seekPos {pixelOffset_bytes};
-  char* buffer = new char[rowSize_bytes];
-
   // for each row of pixels.
   for(int row = 0; row < numRows; ++row){
-    file.seekg(seekPos);
-    file.read(static_cast<char*>(buffer), rowSize_bytes);
+    gfx::Color4u* pixels = _pixels + (row * _stride);
 
     // for each pixel in the row.
     int col {0};
     int byteNo {0};
     int bytePixelNo {0};
-    uint8_t byte = static_cast<uint8_t>(buffer[byteNo]);
+    uint8_t byte = rowBytes[byteNo];
     while(col < infoHead._bmpWidth_px){
       if(bytePixelNo >= numPixelsPerByte){
-        byte = static_cast<uint8_t>(buffer[++byteNo]);
+        byte = rowBytes[++byteNo];
         bytePixelNo = 0;
       }
       int shift = infoHead._bitsPerPixel * (numPixelsPerByte - 1 - bytePixelNo);
       uint8_t index = (byte & (mask << shift)) >> shift;
-      _pixels[row][col] = palette[index];
+      pixels[col] = palette[index];
       ++col;
       ++bytePixelNo;
     }
-    seekPos += rowOffset_bytes;
+    rowBytes += rowOffset_bytes;
+  }
+
+  return true;
+}
+
+//
+// Decodes BI_RLE8 and BI_RLE4 pixel data. The data is a sequence of 2-byte codes; either an
+// encoded run [count, index(es)] or an escape [0, code]. Escape codes are 0 (end of row), 1 (end
+// of bitmap), 2 (delta: skip the following [dx, dy] pixels) or 3+ (an absolute run of that many
+// pixel indices, padded to a 2-byte boundary). For RLE4 runs alternate between the high and low
+// nibbles of the index byte. Pixels skipped by deltas or early row/bitmap ends are transparent.
+//
+bool Bmp::extractRlePixels(const ByteReader& reader, const FileHeader& fileHead, const InfoHeader& infoHead)
+{
+  std::vector<gfx::Color4u> palette {};
+  if(!extractPalette(reader, infoHead, palette))
+    return false;
+
+  clear(gfx::Color4u{0, 0, 0, 0});
+
+  bool isRle4 = (infoHead._compression == BI_RLE4);
+  const uint8_t* data = reader.getData() + fileHead._pixelOffset_bytes;
+  const uint8_t* end = reader.getData() + reader.getSize();
+  if(infoHead._imageSize_bytes != 0 && reader.isInBounds(fileHead._pixelOffset_bytes, infoHead._imageSize_bytes))
+    end = data + infoHead._imageSize_bytes;
+
+  int row {0};
+  int col {0};
+
+  // writes pixels clipped to the image; rle data may legally overrun the width.
+  auto writePixel = [this, &palette, &row, &col](uint8_t index){
+    if(col < _size._x && row < _size._y)
+      _pixels[(row * _stride) + col] = palette[index];
+    ++col;
+  };
+
+  while(end - data >= 2 && row < _size._y){
+    uint8_t count = data[0];
+    uint8_t value = data[1];
+    data += 2;
+
+    if(count > 0){
+      for(int i = 0; i < count; ++i)
+        writePixel(isRle4 ? ((i & 0x01) ? (value & 0x0f) : (value >> 4)) : value);
+      continue;
+    }
+
+    switch(value)
+    {
+    case 0:
+      col = 0;
+      ++row;
+      break;
+    case 1:
+      return true;
+    case 2:
+      if(end - data < 2)
+        return false;
+      col += data[0];
+      row += data[1];
+      data += 2;
+      break;
+    default:
+    {
+      int numBytes = isRle4 ? (value + 1) / 2 : value;
+      int paddedNumBytes = numBytes + (numBytes & 0x01);
+      if(end - data < numBytes)
+        return false;
+      for(int i = 0; i < value; ++i)
+        writePixel(isRle4 ? ((i & 0x01) ? (data[i / 2] & 0x0f) : (data[i / 2] >> 4)) : data[i]);
+      data += std::min<ptrdiff_t>(paddedNumBytes, end - data);
+      break;
+    }
+    }
   }
-  delete[] buffer;
+
+  // tolerate a missing end of bitmap code provided the data was not cut short mid-code.
+  return true;
 }
 
-void Bmp::extractPixels(std::ifstream& file, FileHeader& fileHead, InfoHeader& infoHead)
+bool Bmp::extractPixels(const ByteReader& reader, const FileHeader& fileHead, const InfoHeader& infoHead)
 {
   // note: this function handles 16-bit, 24-bit and 32-bit pixels.
 
@@ -322,13 +630,53 @@ void Bmp::extractPixels(std::ifstream& file, FileHeader& fileHead, InfoHeader& i
 
   int numRows = std::abs(infoHead._bmpHeight_px);
   bool isTopOrigin = (infoHead._bmpHeight_px < 0);
-  int pixelOffset_bytes = static_cast<int>(fileHead._pixelOffset_bytes);
+  const uint8_t* rowBytes = reader.getData() + fileHead._pixelOffset_bytes;
   int rowOffset_bytes {rowSize_bytes};
   if(isTopOrigin){
-    pixelOffset_bytes += (numRows - 1) * rowSize_bytes;
+    rowBytes += (numRows - 1) * rowSize_bytes;
     rowOffset_bytes *= -1;
   }
 
+  if(infoHead._redMask == 0 || infoHead._greenMask == 0 || infoHead._blueMask == 0)
+    return false;
+
+  PixelLayout layout = choosePixelLayout(infoHead._bitsPerPixel, infoHead._redMask, 
+                                         infoHead._greenMask, infoHead._blueMask, 
+                                         infoHead._alphaMask);
+
+  if(layout != PixelLayout::GENERIC){
+    for(int row = 0; row < numRows; ++row){
+      gfx::Color4u* pixels = _pixels + (row * _stride);
+      switch(layout)
+      {
+      case PixelLayout::BGRA32:
+        convertRowBGRA32(rowBytes, pixels, infoHead._bmpWidth_px, 0xff000000);
+        break;
+      case PixelLayout::BGRX32:
+        convertRowBGRA32(rowBytes, pixels, infoHead._bmpWidth_px, 0x00000000);
+        break;
+      case PixelLayout::ARGB32:
+        convertRowARGB32(rowBytes, pixels, infoHead._bmpWidth_px);
+        break;
+      case PixelLayout::BGR24:
+        convertRowBGR24(rowBytes, pixels, infoHead._bmpWidth_px);
+        break;
+      case PixelLayout::RGB555:
+        convertRow16<10, 5, 0, 15>(rowBytes, pixels, infoHead._bmpWidth_px, 0x7c00, 0x03e0, 0x001f, infoHead._alphaMask);
+        break;
+      case PixelLayout::RGB565:
+        convertRow16<11, 5, 0, 0>(rowBytes, pixels, infoHead._bmpWidth_px, 0xf800, 0x07e0, 0x001f, 0x0000);
+        break;
+      default:
+        assert(0);
+      }
+      rowBytes += rowOffset_bytes;
+    }
+    return true;
+  }
+
+  // generic fallback for any other channel masks.
+
   // shift values are needed when using channel masks to extract color channel data from
   // the raw pixel bytes.
   int redShift {0};
@@ -342,13 +690,9 @@ void Bmp::extractPixels(std::ifstream& file, FileHeader& fileHead, InfoHeader& i
   if(infoHead._alphaMask)
     while((infoHead._alphaMask & (0x01 << alphaShift)) == 0) ++alphaShift;
 
-  int seekPos {pixelOffset_bytes};
-  char* buffer = new char[rowSize_bytes];
-
   // for each row of pixels.
   for(int row = 0; row < numRows; ++row){
-    file.seekg(seekPos);
-    file.read(static_cast<char*>(buffer), rowSize_bytes);
+    gfx::Color4u* pixels = _pixels + (row * _stride);
 
     // for each pixel in row.
     for(int col = 0; col < infoHead._bmpWidth_px; ++col){
@@ -356,10 +700,10 @@ void Bmp::extractPixels(std::ifstream& file, FileHeader& fileHead, InfoHeader& i
 
       // for each pixel byte.
       for(int i = 0; i < pixelSize_bytes; ++i){
-        uint8_t pixelByte = buffer[(col * pixelSize_bytes) + i];
+        uint8_t pixelByte = rowBytes[(col * pixelSize_bytes) + i];
 
         // 0rth byte of pixel stored in LSB of rawPixelBytes.
-        rawPixelBytes |= static_cast<uint32_t>(pixelByte << (i * 8));
+        rawPixelBytes |= static_cast<uint32_t>(pixelByte) << (i * 8);
       }
 
       uint8_t red = (rawPixelBytes & infoHead._redMask) >> redShift;
@@ -376,11 +720,12 @@ void Bmp::extractPixels(std::ifstream& file, FileHeader& fileHead, InfoHeader& i
       //uint8_t alpha = infoHead._alphaMask == 0 ? 
       //  (rawPixelBytes & infoHead._alphaMask) >> alphaShift : 255;
 
-      _pixels[row][col] = gfx::Color4u{red, green, blue, alpha};
+      pixels[col] = gfx::Color4u{red, green, blue, alpha};
     }
-    seekPos += rowOffset_bytes;
+    rowBytes += rowOffset_bytes;
   }
-  delete[] buffer;
+
+  return true;
 }
 
 } // namespace io
@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include "../include/pxr_bus.h"
+#include "../include/pxr_simd.h"
+
+namespace pxr
+{
+namespace sfx
+{
+
+//
+// The cutoff a glide into or out of filtering starts or ends at, as a fraction of the sample
+// rate; high enough that the filter is all but transparent there.
+//
+static constexpr float openCutoffRatio {0.45f};
+static constexpr float minCutoff_hz {20.f};
+
+//
+// State below this is flushed to zero after every call so silence never decays into denormals.
+//
+static constexpr float denormalThreshold {1e-15f};
+
+#ifdef PXR_SIMD_SSE2
+//
+// Filters 4 consecutive samples of one channel given the block matrices of the filter; s holds
+// the state in its first 2 lanes.
+//
+static inline __m128 filterQuad(__m128 x, __m128& s, const __m128* yb, const __m128* sb)
+{
+  __m128 x0 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(0, 0, 0, 0));
+  __m128 x1 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(1, 1, 1, 1));
+  __m128 x2 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2, 2, 2, 2));
+  __m128 x3 = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3));
+  __m128 s1 = _mm_shuffle_ps(s, s, _MM_SHUFFLE(0, 0, 0, 0));
+  __m128 s2 = _mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1));
+
+  __m128 y = _mm_add_ps(
+    _mm_add_ps(_mm_mul_ps(x0, yb[0]), _mm_mul_ps(x1, yb[1])),
+    _mm_add_ps(_mm_mul_ps(x2, yb[2]), _mm_mul_ps(x3, yb[3]))
+  );
+  y = _mm_add_ps(y, _mm_add_ps(_mm_mul_ps(s1, yb[4]), _mm_mul_ps(s2, yb[5])));
+
+  __m128 t = _mm_add_ps(
+    _mm_add_ps(_mm_mul_ps(x0, sb[0]), _mm_mul_ps(x1, sb[1])),
+    _mm_add_ps(_mm_mul_ps(x2, sb[2]), _mm_mul_ps(x3, sb[3]))
+  );
+  s = _mm_add_ps(t, _mm_add_ps(_mm_mul_ps(s1, sb[4]), _mm_mul_ps(s2, sb[5])));
+  return y;
+}
+#endif
+
+//
+// Scales numSamples interleaved samples by a gain which starts at gain and changes by gainStep
+// every frame.
+//
+static void applyGain(float* samples, int numSamples, int numChannels, float gain, float gainStep)
+{
+  int s {0};
+
+#ifdef PXR_SIMD_SSE2
+  //
+  // As the mixer's kernel; lanes of the same frame share a gain.
+  //
+  __m128 g = _mm_set_ps(
+    gain + gainStep * (3 / numChannels),
+    gain + gainStep * (2 / numChannels),
+    gain + gainStep * (1 / numChannels),
+    gain
+  );
+  __m128 gstep = _mm_set1_ps(gainStep * (4 / numChannels));
+  for(; s + 4 <= numSamples; s += 4){
+    _mm_storeu_ps(samples + s, _mm_mul_ps(_mm_loadu_ps(samples + s), g));
+    g = _mm_add_ps(g, gstep);
+  }
+#endif
+
+  for(; s < numSamples; ++s)
+    samples[s] *= gain + gainStep * (s / numChannels);
+}
+
+Biquad::Biquad() :
+  _b0{1.f},
+  _b1{0.f},
+  _b2{0.f},
+  _a1{0.f},
+  _a2{0.f},
+  _s1{},
+  _s2{},
+  _yBlock{},
+  _sBlock{}
+{}
+
+void Biquad::setLowPass(float cutoff_hz, int sampleRate_hz)
+{
+  double w0 = 2.0 * M_PI * std::clamp<double>(cutoff_hz, minCutoff_hz, 0.49 * sampleRate_hz) / sampleRate_hz;
+  double cosw0 = std::cos(w0);
+  double alpha = std::sin(w0) * M_SQRT1_2;    // sin(w0) / 2Q with Q = 1 / sqrt(2)
+  double a0 = 1.0 + alpha;
+  double b0 = (1.0 - cosw0) * 0.5 / a0;
+  double b1 = (1.0 - cosw0) / a0;
+  double b2 = b0;
+  double a1 = -2.0 * cosw0 / a0;
+  double a2 = (1.0 - alpha) / a0;
+
+  _b0 = static_cast<float>(b0);
+  _b1 = static_cast<float>(b1);
+  _b2 = static_cast<float>(b2);
+  _a1 = static_cast<float>(a1);
+  _a2 = static_cast<float>(a2);
+
+  //
+  // The block matrices are the responses of 4 steps of the recursion to each block input alone.
+  //
+  for(int i = 0; i < NUM_BLOCK_INPUTS; ++i){
+    double x[4] {};
+    double s1 {i == 4 ? 1.0 : 0.0};
+    double s2 {i == 5 ? 1.0 : 0.0};
+    if(i < 4) x[i] = 1.0;
+    for(int n = 0; n < 4; ++n){
+      double y = b0 * x[n] + s1;
+      s1 = b1 * x[n] - a1 * y + s2;
+      s2 = b2 * x[n] - a2 * y;
+      _yBlock[i][n] = static_cast<float>(y);
+    }
+    _sBlock[i][0] = static_cast<float>(s1);
+    _sBlock[i][1] = static_cast<float>(s2);
+    _sBlock[i][2] = 0.f;
+    _sBlock[i][3] = 0.f;
+  }
+}
+
+void Biquad::reset()
+{
+  _s1.fill(0.f);
+  _s2.fill(0.f);
+}
+
+void Biquad::process(float* samples, int frames, int numChannels)
+{
+  assert(0 < numChannels && numChannels <= MAX_CHANNELS);
+  int f {0};
+
+#ifdef PXR_SIMD_SSE2
+  __m128 yb[NUM_BLOCK_INPUTS], sb[NUM_BLOCK_INPUTS];
+  for(int i = 0; i < NUM_BLOCK_INPUTS; ++i){
+    yb[i] = _mm_load_ps(_yBlock[i]);
+    sb[i] = _mm_load_ps(_sBlock[i]);
+  }
+
+  if(numChannels == 1){
+    __m128 s = _mm_set_ps(0.f, 0.f, _s2[0], _s1[0]);
+    for(; f + 4 <= frames; f += 4)
+      _mm_storeu_ps(samples + f, filterQuad(_mm_loadu_ps(samples + f), s, yb, sb));
+    _s1[0] = _mm_cvtss_f32(s);
+    _s2[0] = _mm_cvtss_f32(_mm_shuffle_ps(s, s, _MM_SHUFFLE(1, 1, 1, 1)));
+  }
+  else{
+
+    //
+    // Deinterleave 4 stereo frames into a vector per channel and back again after; the two
+    // channels are independent so their filtering overlaps in the pipeline.
+    //
+    __m128 sl = _mm_set_ps(0.f, 0.f, _s2[0], _s1[0]);
+    __m128 sr = _mm_set_ps(0.f, 0.f, _s2[1], _s1[1]);
+    for(; f + 4 <= frames; f += 4){
+      __m128 a = _mm_loadu_ps(samples + f * 2);
+      __m128 b = _mm_loadu_ps(samples + f * 2 + 4);
+      __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+      __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+      l = filterQuad(l, sl, yb, sb);
+      r = filterQuad(r, sr, yb, sb);
+      _mm_storeu_ps(samples + f * 2, _mm_unpacklo_ps(l, r));
+      _mm_storeu_ps(samples + f * 2 + 4, _mm_unpackhi_ps(l, r));
+    }
+    _s1[0] = _mm_cvtss_f32(sl);
+    _s2[0] = _mm_cvtss_f32(_mm_shuffle_ps(sl, sl, _MM_SHUFFLE(1, 1, 1, 1)));
+    _s1[1] = _mm_cvtss_f32(sr);
+    _s2[1] = _mm_cvtss_f32(_mm_shuffle_ps(sr, sr, _MM_SHUFFLE(1, 1, 1, 1)));
+  }
+#endif
+
+  for(int c = 0; c < numChannels; ++c){
+    float s1 {_s1[c]}, s2 {_s2[c]};
+    for(int n = f; n < frames; ++n){
+      float& sample = samples[n * numChannels + c];
+      float x = sample;
+      float y = _b0 * x + s1;
+      s1 = _b1 * x - _a1 * y + s2;
+      s2 = _b2 * x - _a2 * y;
+      sample = y;
+    }
+    _s1[c] = std::abs(s1) < denormalThreshold ? 0.f : s1;
+    _s2[c] = std::abs(s2) < denormalThreshold ? 0.f : s2;
+  }
+}
+
+Bus::Bus() :
+  _filter{},
+  _numChannels{0},
+  _sampleRate_hz{0},
+  _gain{1.f},
+  _gainTarget{1.f},
+  _gainStep{0.f},
+  _rampFramesLeft{0},
+  _cutoff_hz{0.f},
+  _cutoffTarget_hz{0.f},
+  _glideFramesLeft{0},
+  _isFiltering{false},
+  _duck{1.f},
+  _duckedGain{1.f},
+  _attackStep{1.f},
+  _releaseStep{1.f},
+  _isDucked{false}
+{}
+
+void Bus::initialize(int numChannels, int sampleRate_hz)
+{
+  assert(0 < numChannels && numChannels <= Biquad::MAX_CHANNELS);
+  *this = Bus{};
+  _numChannels = numChannels;
+  _sampleRate_hz = sampleRate_hz;
+}
+
+void Bus::setGain(float gain, int rampFrames)
+{
+  _gainTarget = std::max(0.f, gain);
+  _rampFramesLeft = std::max(1, rampFrames);
+  _gainStep = (_gainTarget - _gain) / _rampFramesLeft;
+}
+
+void Bus::setLowPass(float cutoff_hz, int glideFrames)
+{
+  float open_hz = openCutoffRatio * _sampleRate_hz;
+  if(!_isFiltering){
+    if(cutoff_hz == NO_LOW_PASS)
+      return;
+    _isFiltering = true;
+    _filter.reset();
+    _cutoff_hz = open_hz;
+  }
+
+  _cutoffTarget_hz = cutoff_hz == NO_LOW_PASS ? NO_LOW_PASS : std::clamp(cutoff_hz, minCutoff_hz, open_hz);
+  _glideFramesLeft = std::max(0, glideFrames);
+  if(_glideFramesLeft == 0){
+    if(_cutoffTarget_hz == NO_LOW_PASS){
+      _isFiltering = false;
+      return;
+    }
+    _cutoff_hz = _cutoffTarget_hz;
+  }
+  _filter.setLowPass(_cutoff_hz, _sampleRate_hz);
+}
+
+void Bus::setDucking(float duckedGain, int attackFrames, int releaseFrames)
+{
+  _duckedGain = std::clamp(duckedGain, 0.f, 1.f);
+  _attackStep = (1.f - _duckedGain) / std::max(1, attackFrames);
+  _releaseStep = (1.f - _duckedGain) / std::max(1, releaseFrames);
+}
+
+void Bus::setDucked(bool isDucked)
+{
+  _isDucked = isDucked;
+}
+
+bool Bus::isBypassed() const
+{
+  return _numChannels == 0 ||
+         (!_isFiltering && _rampFramesLeft == 0 && _gain == 1.f && _duck == 1.f && !_isDucked);
+}
+
+float Bus::stepTowards(float value, float target, float step)
+{
+  return value < target ? std::min(value + step, target) : std::max(value - step, target);
+}
+
+void Bus::glideCutoff(int frames)
+{
+  if(_glideFramesLeft == 0)
+    return;
+
+  float target_hz = _cutoffTarget_hz == NO_LOW_PASS ? openCutoffRatio * _sampleRate_hz : _cutoffTarget_hz;
+  int step = std::min(frames, _glideFramesLeft);
+  _cutoff_hz *= std::pow(target_hz / _cutoff_hz, static_cast<float>(step) / _glideFramesLeft);
+  _glideFramesLeft -= step;
+  if(_glideFramesLeft == 0){
+    _cutoff_hz = target_hz;
+    if(_cutoffTarget_hz == NO_LOW_PASS){
+      _isFiltering = false;
+      return;
+    }
+  }
+  _filter.setLowPass(_cutoff_hz, _sampleRate_hz);
+}
+
+void Bus::process(float* samples, int frames)
+{
+  if(isBypassed() || frames <= 0)
+    return;
+
+  if(_isFiltering){
+    glideCutoff(frames);
+    if(_isFiltering)
+      _filter.process(samples, frames, _numChannels);
+  }
+
+  //
+  // The gain and the duck are both stepped once per call and the product ramped linearly
+  // across the frames, which is near enough over a block.
+  //
+  float gain0 = _gain * _duck;
+  if(_rampFramesLeft > 0){
+    int step = std::min(frames, _rampFramesLeft);
+    _rampFramesLeft -= step;
+    _gain = _rampFramesLeft == 0 ? _gainTarget : _gain + _gainStep * step;
+  }
+  if(_isDucked)
+    _duck = stepTowards(_duck, _duckedGain, _attackStep * frames);
+  else
+    _duck = stepTowards(_duck, 1.f, _releaseStep * frames);
+  float gain1 = _gain * _duck;
+
+  if(gain0 == 1.f && gain1 == 1.f)
+    return;
+  applyGain(samples, frames * _numChannels, _numChannels, gain0, (gain1 - gain0) / frames);
+}
+
+} // namespace sfx
+} // namespace pxr
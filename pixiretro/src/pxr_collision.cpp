@@ -90,8 +90,10 @@ static void findPixelIntersections(const AABB& aOverlap,
   assert(0 <= aSheetOverlap._ymax && aSheetOverlap._ymax < aSheet._image.getHeight());
   assert(0 <= bSheetOverlap._ymax && bSheetOverlap._ymax < bSheet._image.getHeight());
 
-  const gfx::Color4u* const* aPixels = aSheet._image.getPixels();
-  const gfx::Color4u* const* bPixels = bSheet._image.getPixels();
+  const gfx::Color4u* aPixels = aSheet._image.getPixels();
+  const gfx::Color4u* bPixels = bSheet._image.getPixels();
+  int aStride = aSheet._image.getStride();
+  int bStride = bSheet._image.getStride();
 
   int overlapWidth = aSheetOverlap._xmax - aSheetOverlap._xmin;
   int overlapHeight = aSheetOverlap._ymax - aSheetOverlap._ymin;
@@ -106,7 +108,7 @@ static void findPixelIntersections(const AABB& aOverlap,
       bPxRow = bSheetOverlap._ymin + row;
       bPxCol = bSheetOverlap._xmin + col;
 
-      if(aPixels[aPxRow][aPxCol]._a == 0 || bPixels[bPxRow][bPxCol]._a == 0)
+      if(aPixels[(aPxRow * aStride) + aPxCol]._a == 0 || bPixels[(bPxRow * bStride) + bPxCol]._a == 0)
         continue;
 
       cr._aPixels.push_back({aPxCol, aPxRow});
@@ -1,5 +1,6 @@
 #include <SDL2/SDL.h>
 #include <thread>
+#include <algorithm>
 #include <sstream>
 #include <iomanip>
 #include <cassert>
@@ -87,6 +88,17 @@ void Engine::Ticker::doTicks(Duration_t gameNow, Duration_t realNow)
   }
 }
 
+float Engine::Ticker::getTickAlpha(Duration_t gameNow, Duration_t realNow) const
+{
+  //
+  // Ticks still accumulated have not been done so the last tick done is behind the ticker's now.
+  //
+  Duration_t now = _isChasingGameNow ? gameNow : realNow;
+  Duration_t lastTickNow = _tickerNow - (_tickPeriod * _ticksAccumulated);
+  float alpha = static_cast<float>((now - lastTickNow).count()) / _tickPeriod.count();
+  return std::clamp(alpha, 0.f, 1.f);
+}
+
 void Engine::Ticker::reset()
 {
   _tickerNow = Duration_t::zero();
@@ -97,6 +109,106 @@ void Engine::Ticker::reset()
   _ticksAccumulated = 0;
 }
 
+Engine::FramePacer::FramePacer(Duration_t framePeriod, bool isVSynced) :
+  _framePeriod{framePeriod},
+  _spinThreshold{maxSpinThreshold / 2},
+  _maxOvershoot{0},
+  _nextDeadline{},
+  _lastFrameStart{},
+  _jitterHistory_ms{},
+  _jitterHead{0},
+  _missedDeadlines{0},
+  _isVSynced{isVSynced}
+{
+  _jitterHistory_ms.reserve(JITTER_HISTORY_SIZE);
+}
+
+void Engine::FramePacer::reset()
+{
+  _nextDeadline = Clock_t::now() + _framePeriod;
+  _lastFrameStart = TimePoint_t{};
+  _jitterHistory_ms.clear();
+  _jitterHead = 0;
+  _missedDeadlines = 0;
+}
+
+void Engine::FramePacer::waitForNextFrame()
+{
+  auto now = Clock_t::now();
+  if(now - _nextDeadline > _framePeriod){
+    auto missed = (now - _nextDeadline) / _framePeriod;
+    _nextDeadline += missed * _framePeriod;
+    _missedDeadlines += static_cast<int>(missed);
+  }
+
+  TimePoint_t wakeTime = _isVSynced ? _nextDeadline - vsyncSlack : _nextDeadline;
+  sleepUntil(wakeTime);
+  while(Clock_t::now() < wakeTime)
+    std::this_thread::yield();
+
+  //
+  // Spin for a little longer than the worst recent overshoot; the worst decays so one bad
+  // sleep does not raise the cost of every wait after it for good.
+  //
+  _spinThreshold = std::clamp(_maxOvershoot + _maxOvershoot / 2, minSpinThreshold, maxSpinThreshold);
+  _maxOvershoot -= _maxOvershoot / 64;
+
+  _nextDeadline += _framePeriod;
+  if(!_isVSynced)
+    recordJitter(Clock_t::now());
+}
+
+void Engine::FramePacer::onPresent()
+{
+  if(!_isVSynced)
+    return;
+  auto now = Clock_t::now();
+  _nextDeadline = now + _framePeriod;
+  recordJitter(now);
+}
+
+void Engine::FramePacer::sleepUntil(TimePoint_t deadline)
+{
+  while(true){
+    auto remaining = deadline - Clock_t::now();
+    if(remaining <= _spinThreshold)
+      return;
+    auto sleep = remaining - _spinThreshold;
+    auto sleepStart = Clock_t::now();
+    std::this_thread::sleep_for(sleep);
+    _maxOvershoot = std::max(_maxOvershoot, Duration_t{(Clock_t::now() - sleepStart) - sleep});
+  }
+}
+
+void Engine::FramePacer::recordJitter(TimePoint_t frameStart)
+{
+  if(_lastFrameStart != TimePoint_t{}){
+    Duration_t error = std::chrono::abs(Duration_t{frameStart - _lastFrameStart} - _framePeriod);
+    float jitter_ms = static_cast<float>(error.count()) / oneMillisecond.count();
+    if(static_cast<int>(_jitterHistory_ms.size()) < JITTER_HISTORY_SIZE)
+      _jitterHistory_ms.push_back(jitter_ms);
+    else
+      _jitterHistory_ms[_jitterHead] = jitter_ms;
+    _jitterHead = (_jitterHead + 1) % JITTER_HISTORY_SIZE;
+  }
+  _lastFrameStart = frameStart;
+}
+
+Engine::FramePacer::JitterStats Engine::FramePacer::getJitterStats() const
+{
+  JitterStats stats {};
+  stats._spinThreshold_ms = static_cast<float>(_spinThreshold.count()) / oneMillisecond.count();
+  stats._missedDeadlines = _missedDeadlines;
+  if(_jitterHistory_ms.empty())
+    return stats;
+  std::vector<float> sorted {_jitterHistory_ms};
+  std::sort(sorted.begin(), sorted.end());
+  stats._p50_ms = sorted[sorted.size() / 2];
+  stats._p99_ms = sorted[sorted.size() * 99 / 100];
+  stats._max_ms = sorted.back();
+  return stats;
+}
+
 void Engine::initialize(std::unique_ptr<Game> game)
 {
   log::initialize();
@@ -110,7 +222,11 @@ void Engine::initialize(std::unique_ptr<Game> game)
     exit(EXIT_FAILURE);
   }
 
-  if(!sfx::initialize()){
+  sfx::SFXConfiguration sfxconf {};
+  if(_rc.getBoolValue(EngineRC::KEY_AUDIO_RENDER))
+    sfxconf._renderPath = audioRenderPath;
+
+  if(!sfx::initialize(sfxconf)){
     log::log(log::FATAL, log::msg_sfx_fail_init);
     exit(EXIT_FAILURE);
   }
@@ -166,9 +282,20 @@ void Engine::initialize(std::unique_ptr<Game> game)
   Duration_t tickPeriod {static_cast<int64_t>(1.0e9 / static_cast<double>(_fpsLockHz))};
   log::log(log::INFO, log::msg_eng_locking_fps, std::to_string(_fpsLockHz) + "hz");
 
-  _updateTicker = Ticker{&Engine::onSplashUpdateTick, this, tickPeriod, 5, true};
+  //
+  // The update rate is independent of the fps lock so game logic can run at a fixed, lower
+  // rate while draws (at the fps lock) interpolate between updates (see Scene::onDraw).
+  //
+  _updateRateHz = _rc.getIntValue(EngineRC::KEY_UPDATE_RATE);
+  Duration_t updatePeriod {static_cast<int64_t>(1.0e9 / static_cast<double>(_updateRateHz))};
+  log::log(log::INFO, log::msg_eng_update_rate, std::to_string(_updateRateHz) + "hz");
+
+  _updateTicker = Ticker{&Engine::onSplashUpdateTick, this, updatePeriod, 5, true};
   _drawTicker = Ticker{&Engine::onSplashDrawTick, this, tickPeriod, 1, false};
 
+  bool isVSynced = _rc.getBoolValue(EngineRC::KEY_VSYNC) && gfx::setVSync(true);
+  _framePacer = FramePacer{tickPeriod, isVSynced};
+
   //_splashSoundKey = sfx::loadSound(splashName);
   _splashSpriteKey = gfx::loadSpritesheet(splashName);
   if(gfx::isErrorSpritesheet(_splashSpriteKey)){
@@ -215,10 +342,12 @@ void Engine::shutdown()
 void Engine::run()
 {
   _realClock.reset();
+  _framePacer.reset();
   while(!_isSplashDone) 
     mainloop();
   
   _realClock.reset();
+  _framePacer.reset();
   _gameClock.reset();
   _updateTicker.reset();
   _drawTicker.reset();
@@ -228,9 +357,8 @@ void Engine::run()
 
 void Engine::mainloop()
 {
-  auto frameStart = Clock_t::now();
-
-  _gameClock.update(_realClock.update()); 
+  auto realDt = _realClock.update();
+  _gameClock.update(realDt); 
   auto gameNow = _gameClock.getNow();
   auto realNow = _realClock.getNow();
 
@@ -262,10 +390,16 @@ void Engine::mainloop()
           if(!_isSplashDone)
             continue;
           _gameClock.togglePause();
-          if(_gameClock.isPaused())
+          if(_gameClock.isPaused()){
             gfx::enableScreen(_pauseScreenId);
-          else
+            sfx::setBusLowPass(sfx::BUS_MASTER, pausedAudioCutoff_hz, pauseAudioTransition_ms);
+            sfx::setBusVolume(sfx::BUS_MASTER, pausedAudioVolume, pauseAudioTransition_ms);
+          }
+          else{
             gfx::disableScreen(_pauseScreenId);
+            sfx::setBusLowPass(sfx::BUS_MASTER, sfx::NO_LOW_PASS, pauseAudioTransition_ms);
+            sfx::setBusVolume(sfx::BUS_MASTER, sfx::MAX_VOLUME, pauseAudioTransition_ms);
+          }
           break;
         }
         else if(event.key.keysym.sym == toggleDrawEngineStatsKey){
@@ -288,6 +422,14 @@ void Engine::mainloop()
   }
 
   _updateTicker.doTicks(gameNow, realNow);
+
+  //
+  // Serviced every frame on real time rather than on update ticks as the game clock (and so 
+  // the update ticker) can be paused whilst music, which is sequenced and streamed by the 
+  // service, keeps playing.
+  //
+  sfx::onUpdate(static_cast<float>(durationToSeconds(realDt)));
+
   _drawTicker.doTicks(gameNow, realNow);
 
   if(_updateTicker.isNewTickFrequencySample() || _drawTicker.isNewTickFrequencySample())
@@ -303,9 +445,7 @@ void Engine::mainloop()
     _framesDoneThisSecond = 0;
   }
 
-  auto framePeriod = Clock_t::now() - frameStart;
-  if(framePeriod < minFramePeriod)
-    std::this_thread::sleep_for(minFramePeriod - framePeriod); 
+  _framePacer.waitForNextFrame();
 }
 
 void Engine::drawEngineStats()
@@ -337,6 +477,65 @@ void Engine::drawEngineStats()
                  << " -- real=" << realHours << ":" << realMins << ":" << realSecs;
   gfx::drawText({10, 10}, ss.str(), _engineFontKey, gfx::colors::white, _statsScreenId);
 
+  std::stringstream().swap(ss);
+
+  sfx::SFXStats sfxStats = sfx::getStats();
+  ss << std::setprecision(3);
+  ss << "audio cmd latency [ms] -- mean=" << sfxStats._commandLatencyMean_ms
+     << " max=" << sfxStats._commandLatencyMax_ms
+     << " -- queue peak=" << sfxStats._commandQueueHighWater << "/" << sfxStats._commandQueueCapacity
+     << " dropped=" << sfxStats._commandsDropped;
+  gfx::drawText({10, 30}, ss.str(), _engineFontKey, gfx::colors::white, _statsScreenId);
+
+  std::stringstream().swap(ss);
+
+  ss << "music prefetch -- hits=" << sfxStats._musicPrefetchHits
+     << " misses=" << sfxStats._musicPrefetchMisses
+     << " -- underruns=" << sfxStats._musicUnderruns;
+  gfx::drawText({10, 40}, ss.str(), _engineFontKey, gfx::colors::white, _statsScreenId);
+
+  std::stringstream().swap(ss);
+
+  ss << "sound memory [kB] -- " << sfxStats._soundMemory_kb << "/" << sfxStats._soundBudget_kb
+     << " -- evictions=" << sfxStats._soundEvictions
+     << " reloads=" << sfxStats._soundReloads;
+  gfx::drawText({10, 50}, ss.str(), _engineFontKey, gfx::colors::white, _statsScreenId);
+
+  std::stringstream().swap(ss);
+
+  ss << "audio mix [ms] -- p50=" << sfxStats._callbackMix._p50_ms
+     << " p99=" << sfxStats._callbackMix._p99_ms
+     << " max=" << sfxStats._callbackMix._max_ms
+     << " -- period=" << sfxStats._bufferPeriod_ms
+     << " underruns=" << sfxStats._audioUnderruns;
+  gfx::drawText({10, 60}, ss.str(), _engineFontKey, gfx::colors::white, _statsScreenId);
+
+  std::stringstream().swap(ss);
+
+  ss << "audio callback interval [ms] -- p50=" << sfxStats._callbackInterval._p50_ms
+     << " p99=" << sfxStats._callbackInterval._p99_ms
+     << " max=" << sfxStats._callbackInterval._max_ms;
+  gfx::drawText({10, 70}, ss.str(), _engineFontKey, gfx::colors::white, _statsScreenId);
+
+  std::stringstream().swap(ss);
+
+  ss << "sound play latency [ms] -- p50=" << sfxStats._playLatency._p50_ms
+     << " p99=" << sfxStats._playLatency._p99_ms
+     << " max=" << sfxStats._playLatency._max_ms
+     << " -- plays=" << sfxStats._playLatency._count;
+  gfx::drawText({10, 80}, ss.str(), _engineFontKey, gfx::colors::white, _statsScreenId);
+
+  std::stringstream().swap(ss);
+
+  FramePacer::JitterStats jitter = _framePacer.getJitterStats();
+  ss << std::setprecision(3);
+  ss << "frame jitter [ms] -- p50=" << jitter._p50_ms
+     << " p99=" << jitter._p99_ms
+     << " max=" << jitter._max_ms
+     << " -- spin=" << jitter._spinThreshold_ms
+     << " missed=" << jitter._missedDeadlines;
+  gfx::drawText({10, 90}, ss.str(), _engineFontKey, gfx::colors::white, _statsScreenId);
+
   _needRedrawEngineStats = false;
 }
 
@@ -367,7 +566,6 @@ void Engine::onUpdateTick(float tickPeriodSeconds)
   double nowSeconds = durationToSeconds(_gameClock.getNow());
   _game->onUpdate(nowSeconds, tickPeriodSeconds);
   input::onUpdate();
-  sfx::onUpdate(tickPeriodSeconds);
 }
 
 void Engine::onDrawTick(float tickPeriodSeconds)
@@ -375,12 +573,14 @@ void Engine::onDrawTick(float tickPeriodSeconds)
   gfx::clearWindowColor(_clearColor);
 
   double nowSeconds = durationToSeconds(_gameClock.getNow());
-  _game->onDraw(nowSeconds, tickPeriodSeconds);
+  float alpha = _updateTicker.getTickAlpha(_gameClock.getNow(), _realClock.getNow());
+  _game->onDraw(nowSeconds, tickPeriodSeconds, alpha);
 
   if(_isDrawingEngineStats)
     drawEngineStats();
 
   gfx::present();
+  _framePacer.onPresent();
 
 }
 
@@ -430,6 +630,7 @@ void Engine::onSplashDrawTick(float tickPeriodSeconds)
     drawEngineStats();
 
   gfx::present();
+  _framePacer.onPresent();
 }
 
 void Engine::onSplashExit()
@@ -6,6 +6,7 @@
 #include <string>
 #include <cstring>
 #include <sstream>
+#include <fstream>
 #include <cinttypes>
 #include <limits>
 #include <cassert>
@@ -18,6 +19,7 @@
 #include "../include/pxr_rect.h"
 #include "../include/pxr_color.h"
 #include "../include/pxr_bmp.h"
+#include "../include/pxr_qoi.h"
 #include "../include/pxr_log.h"
 
 using namespace tinyxml2;
@@ -77,6 +79,44 @@ static ResourceKey_t errorSpritesheetKey;
 static SpritesheetResource errorSpritesheet;
 static FontResource errorFont;
 
+struct TilemapChunk
+{
+  std::vector<Color4u> _pxColors;    // cached raster, accessed [col + (row * width)]
+  int _usedCellCount;                // number of non-empty cells in the chunk.
+  bool _isDirty;                     // raster out of date w.r.t the cells?
+};
+
+struct Tilemap
+{
+  ResourceKey_t _sheetKey;
+  Vector2i _size;                    // unit: cells; x=num cols, y=num rows.
+  Vector2i _cellSize;                // unit: pixels.
+  Vector2i _chunkCount;              // unit: chunks; x=num cols, y=num rows.
+  Vector2i _chunkSize;               // unit: pixels.
+  std::vector<SpriteID_t> _cells;    // accessed [col + (row * width)]
+  std::vector<TilemapChunk> _chunks; // accessed [col + (row * width)]
+};
+
+static std::vector<Tilemap> tilemaps;
+
+//
+// Scratch buffers used by drawTilemapLayers to hold the layers being drawn and their sheets.
+//
+static std::vector<Tilemap*> tilemapLayers;
+static std::vector<const Spritesheet*> tilemapLayerSheets;
+
+//
+// Scratch buffers used by present to accumulate the opacity masks of occluding screens.
+//
+static std::vector<uint8_t> occlusionCoverage;
+static std::vector<const Screen*> occludingScreens;
+
+//
+// Set when screens are created, enabled, disabled, moved, resized or change occlusion mode,
+// any of which can change which screens occlude which, so all culling must be redone.
+//
+static bool isOcclusionStale {true};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 //
 // MODULE FUNCTIONS
@@ -242,24 +282,40 @@ static void freeScreens()
   for(auto& screen : screens){
     delete[] screen._pxColors;
     delete[] screen._pxPositions;
+    delete[] screen._opacityMask;
+    delete[] screen._pxIndices;
     screen._pxColors = nullptr;
     screen._pxPositions = nullptr;
+    screen._opacityMask = nullptr;
+    screen._pxIndices = nullptr;
   }
 }
 
 void shutdown()
 {
   freeScreens();
+  tilemaps.clear();
   SDL_GL_DeleteContext(glContext);
   SDL_DestroyWindow(window);
 }
 
+bool setVSync(bool isEnabled)
+{
+  if(SDL_GL_SetSwapInterval(isEnabled ? 1 : 0) < 0){
+    log::log(log::WARN, log::msg_gfx_fail_set_vsync, std::string{SDL_GetError()});
+    return false;
+  }
+  return true;
+}
+
 //
 // Recalculates screen position, pixel size, pixel positions etc to a account for a change in 
 // window size, display resolution or screen mode attributes.
 //
 static void autoAdjustScreen(Vector2i windowSize, Screen& screen)
 {
+  isOcclusionStale = true;
+
   if(screen._smode == SizeMode::AUTO_MIN){
     screen._pxSize = 1;
   }
@@ -328,6 +384,7 @@ int createScreen(Vector2i resolution)
   screen._pmode = PositionMode::CENTER;
   screen._smode = SizeMode::AUTO_MAX;
   screen._xmode = PixelMode::NO_SHADER;
+  screen._omode = OcclusionMode::NONE;
   screen._position = Vector2i{0, 0};
   screen._manualPosition = Vector2i{0, 0};
   screen._resolution = resolution;
@@ -335,12 +392,18 @@ int createScreen(Vector2i resolution)
   screen._pxCount = screen._resolution._x * screen._resolution._y;
   screen._pxColors = new Color4u[screen._pxCount];
   screen._pxPositions = new Vector2i[screen._pxCount];
+  screen._opacityMask = new uint8_t[screen._pxCount];
+  screen._pxIndices = new uint32_t[screen._pxCount];
+  screen._pxVisibleCount = -1;
+  screen._isMaskStale = true;
+  screen._isDirty = true;
   screen._isEnabled = true;
+  isOcclusionStale = true;
 
   clearScreenTransparent(screenid); 
   autoAdjustScreen(windowSize, screen);
 
-  int memkib = ((screen._pxCount * sizeof(Color4u)) + (screen._pxCount * sizeof(Vector2i))) / 1024;
+  int memkib = (screen._pxCount * (sizeof(Color4u) + sizeof(Vector2i) + sizeof(uint8_t) + sizeof(uint32_t))) / 1024;
 
   std::stringstream ss {};
   ss << "resolution:" << resolution._x << "x" << resolution._y << "vpx mem:" << memkib << "kib";
@@ -377,6 +440,20 @@ static ResourceKey_t useErrorFont()
   assert(0);  // This would mean the error font has not been generated.
 }
 
+//
+// Image assets may be stored as either QOI or bitmap images; if both exist the QOI image is
+// preferred as it is smaller and faster to decode.
+//
+static std::string findImagePath(const char* directory, ResourceName_t name)
+{
+  std::string path {directory};
+  path += name;
+  std::string qoipath {path + Qoi::FILE_EXTENSION};
+  if(std::ifstream{qoipath, std::ios_base::binary})
+    return qoipath;
+  return path + Bmp::FILE_EXTENSION;
+}
+
 ResourceKey_t loadSpritesheet(ResourceName_t name)
 {
   log::log(log::INFO, log::msg_gfx_loading_spritesheet, name);
@@ -397,11 +474,7 @@ ResourceKey_t loadSpritesheet(ResourceName_t name)
   resource._name = name;
   resource._referenceCount = 1;
 
-  std::string bmppath{};
-  bmppath += RESOURCE_PATH_SPRITESHEETS;
-  bmppath += name;
-  bmppath += Bmp::FILE_EXTENSION;
-  if(!sheet._image.load(bmppath)){
+  if(!sheet._image.load(findImagePath(RESOURCE_PATH_SPRITESHEETS, name))){
     log::log(log::ERROR, log::msg_gfx_fail_load_asset_bmp, name);
     return useErrorSpritesheet();
   }
@@ -503,11 +576,7 @@ ResourceKey_t loadFont(ResourceName_t name)
   resource._name = name;
   resource._referenceCount = 1;
 
-  std::string bmppath{};
-  bmppath += RESOURCE_PATH_FONTS;
-  bmppath += name;
-  bmppath += Bmp::FILE_EXTENSION;
-  if(!resource._font._image.load(bmppath)){
+  if(!resource._font._image.load(findImagePath(RESOURCE_PATH_FONTS, name))){
     log::log(log::ERROR, log::msg_gfx_fail_load_asset_bmp, name);
     return useErrorFont();
   }
@@ -658,6 +727,8 @@ void clearScreenTransparent(int screenid)
 {
   assert(0 <= screenid && screenid < screens.size());
   memset(screens[screenid]._pxColors, ALPHA_KEY, screens[screenid]._pxCount * sizeof(Color4u));
+  screens[screenid]._isMaskStale = true;
+  screens[screenid]._isDirty = true;
 }
 
 void clearScreenShade(int shade, int screenid)
@@ -665,6 +736,8 @@ void clearScreenShade(int shade, int screenid)
   assert(0 <= screenid && screenid < screens.size());
   shade = std::max(0, std::min(shade, 255));
   memset(screens[screenid]._pxColors, shade, screens[screenid]._pxCount * sizeof(Color4u));
+  screens[screenid]._isMaskStale = true;
+  screens[screenid]._isDirty = true;
 }
 
 void clearScreenColor(Color4u color, int screenid)
@@ -673,6 +746,8 @@ void clearScreenColor(Color4u color, int screenid)
   Screen& screen = screens[screenid];
   for(int px = 0; px < screen._pxCount; ++px)
     screen._pxColors[px] = color;
+  screen._isMaskStale = true;
+  screen._isDirty = true;
 }
 
 void drawSprite(Vector2i position, ResourceKey_t sheetKey, int spriteid, int screenid, 
@@ -680,13 +755,15 @@ void drawSprite(Vector2i position, ResourceKey_t sheetKey, int spriteid, int scr
 {
   assert(0 <= screenid && screenid < screens.size());
   auto& screen = screens[screenid];
+  screen._isDirty = true;
 
   auto search = spritesheets.find(sheetKey);
   if(search == spritesheets.end()){
     assert(0);
   }
   const auto& sheet = search->second._sheet;
-  const Color4u* const * sheetPxs = sheet._image.getPixels();
+  const Color4u* sheetPxs = sheet._image.getPixels();
+  int sheetStride = sheet._image.getStride();
 
   assert(0 <= spriteid);
 
@@ -708,13 +785,13 @@ void drawSprite(Vector2i position, ResourceKey_t sheetKey, int spriteid, int scr
     if(screenRow < 0) continue;
     if(screenRow >= screen._resolution._y) break;
     screenRowOffset = screenRow * screen._resolution._x;
-    spriteRowOffset = sprite._position._y + (mirrorY ? spriteRowMax - spriteRow : spriteRow); 
+    spriteRowOffset = (sprite._position._y + (mirrorY ? spriteRowMax - spriteRow : spriteRow)) * sheetStride; 
     for(int spriteCol = 0; spriteCol <= spriteColMax; ++spriteCol){
       screenCol = screenColBase + spriteCol;
       if(screenCol < 0) continue;
       if(screenCol >= screen._resolution._x) break;
       spriteColOffset = sprite._position._x + (mirrorX ? spriteColMax - spriteCol : spriteCol); 
-      const Color4u& color = sheetPxs[spriteRowOffset][spriteColOffset];
+      const Color4u& color = sheetPxs[spriteRowOffset + spriteColOffset];
       if(color._a == ALPHA_KEY) continue;
       screen._pxColors[screenCol + screenRowOffset] =
         (screen._xmode == PixelMode::SHADER) ? screen._pxShader(color, screenCol, screenRow) : color;
@@ -726,11 +803,13 @@ void drawSpriteColumn(Vector2i position, ResourceKey_t sheetKey, int spriteid, i
 {
   assert(0 <= screenid && screenid < screens.size());
   auto& screen = screens[screenid];
+  screen._isDirty = true;
 
   auto search = spritesheets.find(sheetKey);
   assert(search != spritesheets.end());
   const auto& sheet = search->second._sheet;
-  const Color4u* const * sheetPxs = sheet._image.getPixels();
+  const Color4u* sheetPxs = sheet._image.getPixels();
+  int sheetStride = sheet._image.getStride();
 
   assert(0 <= spriteid);
   spriteid = spriteid < sheet._sprites.size() ? spriteid : 0; // may be an error sheet with 1 sprite.
@@ -751,7 +830,7 @@ void drawSpriteColumn(Vector2i position, ResourceKey_t sheetKey, int spriteid, i
     if(screenRow < 0) continue;
     if(screenRow >= screen._resolution._y) break;
     screenRowOffset = screenRow * screen._resolution._x;
-    const Color4u& color = sheetPxs[sprite._position._y + spriteRow][sheetCol];
+    const Color4u& color = sheetPxs[((sprite._position._y + spriteRow) * sheetStride) + sheetCol];
     if(color._a == ALPHA_KEY) continue;
     screen._pxColors[screenCol + screenRowOffset] =
       (screen._xmode == PixelMode::SHADER) ? screen._pxShader(color, screenCol, screenRow) : color;
@@ -762,11 +841,13 @@ void drawText(Vector2i position, const std::string& text, ResourceKey_t fontKey,
 {
   assert(0 <= screenid && screenid < screens.size());
   auto& screen = screens[screenid];
+  screen._isDirty = true;
 
   auto search = fonts.find(fontKey);
   assert(search != fonts.end());
   auto& font = search->second._font;
-  const Color4u* const* fontPxs = font._image.getPixels();
+  const Color4u* fontPxs = font._image.getPixels();
+  int fontStride = font._image.getStride();
 
   int baseLineY = position._y + font._baseLine;
   for(char c : text){
@@ -784,7 +865,7 @@ void drawText(Vector2i position, const std::string& text, ResourceKey_t fontKey,
         screenCol = position._x + glyphCol + glyph._xoffset;
         if(screenCol < 0) continue;
         if(screenCol >= screen._resolution._x) return;
-        const Color4u& pxcolor = fontPxs[glyph._y + glyphRow][glyph._x + glyphCol];
+        const Color4u& pxcolor = fontPxs[((glyph._y + glyphRow) * fontStride) + glyph._x + glyphCol];
         if(pxcolor._a == ALPHA_KEY) continue;
         screen._pxColors[screenCol + screenRowOffset] =
           (screen._xmode == PixelMode::SHADER) ? screen._pxShader(color, screenCol, screenRow) : color;
@@ -798,6 +879,7 @@ void drawBorderRectangle(iRect rect, Color4u color, int screenid)
 {
   assert(0 <= screenid && screenid < screens.size());
   auto& screen = screens[screenid];
+  screen._isDirty = true;
 
   int xmin = std::clamp(rect._x,           0, screen._resolution._x - 1);
   int xmax = std::clamp(rect._x + rect._w, 0, screen._resolution._x - 1);
@@ -823,6 +905,7 @@ void drawFillRectangle(iRect rect, Color4u color, int screenid)
 {
   assert(0 <= screenid && screenid < screens.size());
   auto& screen = screens[screenid];
+  screen._isDirty = true;
 
   int xmin = std::clamp(rect._x,           0, screen._resolution._x - 1);
   int xmax = std::clamp(rect._x + rect._w, 0, screen._resolution._x - 1);
@@ -839,6 +922,7 @@ void drawLine(Vector2i p0, Vector2i p1, Color4u color, int screenid)
 {
   assert(0 <= screenid && screenid < screens.size());
   auto& screen = screens[screenid];
+  screen._isDirty = true;
 
   p0._x = std::clamp(p0._x, 0, screen._resolution._x - 1);
   p1._x = std::clamp(p1._x, 0, screen._resolution._x - 1);
@@ -898,6 +982,7 @@ void drawPoint(Vector2i position, Color4u color, int screenid)
 {
   assert(0 <= screenid && screenid < screens.size());
   auto& screen = screens[screenid];
+  screen._isDirty = true;
 
   int x{position._x}, y{position._y};
 
@@ -911,8 +996,301 @@ void drawPoint(Vector2i position, Color4u color, int screenid)
         (screen._xmode == PixelMode::SHADER) ? screen._pxShader(color, x, y) : color;
 }
 
+TilemapID_t createTilemap(Vector2i size, Vector2i cellSize, ResourceKey_t sheetKey)
+{
+  assert(size._x > 0 && size._y > 0);
+  assert(cellSize._x > 0 && cellSize._y > 0);
+  assert(spritesheets.find(sheetKey) != spritesheets.end());
+
+  tilemaps.push_back(Tilemap{});
+  TilemapID_t tilemapid = tilemaps.size() - 1;
+
+  auto& tilemap = tilemaps.back();
+
+  tilemap._sheetKey = sheetKey;
+  tilemap._size = size;
+  tilemap._cellSize = cellSize;
+  tilemap._chunkCount._x = (size._x + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+  tilemap._chunkCount._y = (size._y + TILEMAP_CHUNK_SIZE - 1) / TILEMAP_CHUNK_SIZE;
+  tilemap._chunkSize._x = cellSize._x * TILEMAP_CHUNK_SIZE;
+  tilemap._chunkSize._y = cellSize._y * TILEMAP_CHUNK_SIZE;
+  tilemap._cells.resize(size._x * size._y, EMPTY_TILE);
+  tilemap._chunks.resize(tilemap._chunkCount._x * tilemap._chunkCount._y);
+  for(auto& chunk : tilemap._chunks){
+    chunk._pxColors.resize(tilemap._chunkSize._x * tilemap._chunkSize._y, Color4u{});
+    chunk._usedCellCount = 0;
+    chunk._isDirty = false;
+  }
+
+  return tilemapid;
+}
+
+static TilemapChunk& findTilemapChunk(Tilemap& tilemap, int row, int col)
+{
+  int chunkRow = row / TILEMAP_CHUNK_SIZE;
+  int chunkCol = col / TILEMAP_CHUNK_SIZE;
+  return tilemap._chunks[chunkCol + (chunkRow * tilemap._chunkCount._x)];
+}
+
+void setTile(int row, int col, SpriteID_t spriteid, TilemapID_t tilemapid)
+{
+  assert(0 <= tilemapid && tilemapid < static_cast<int>(tilemaps.size()));
+  auto& tilemap = tilemaps[tilemapid];
+
+  assert(0 <= row && row < tilemap._size._y);
+  assert(0 <= col && col < tilemap._size._x);
+  assert(spriteid >= EMPTY_TILE);
+
+  SpriteID_t& cell = tilemap._cells[col + (row * tilemap._size._x)];
+  if(cell == spriteid)
+    return;
+
+  TilemapChunk& chunk = findTilemapChunk(tilemap, row, col);
+  if(cell == EMPTY_TILE) ++chunk._usedCellCount;
+  if(spriteid == EMPTY_TILE) --chunk._usedCellCount;
+  chunk._isDirty = true;
+  cell = spriteid;
+}
+
+SpriteID_t getTile(int row, int col, TilemapID_t tilemapid)
+{
+  assert(0 <= tilemapid && tilemapid < static_cast<int>(tilemaps.size()));
+  auto& tilemap = tilemaps[tilemapid];
+  assert(0 <= row && row < tilemap._size._y);
+  assert(0 <= col && col < tilemap._size._x);
+  return tilemap._cells[col + (row * tilemap._size._x)];
+}
+
+void clearTilemap(TilemapID_t tilemapid)
+{
+  assert(0 <= tilemapid && tilemapid < static_cast<int>(tilemaps.size()));
+  auto& tilemap = tilemaps[tilemapid];
+  std::fill(tilemap._cells.begin(), tilemap._cells.end(), EMPTY_TILE);
+  for(auto& chunk : tilemap._chunks){
+    chunk._isDirty = chunk._isDirty || chunk._usedCellCount > 0;
+    chunk._usedCellCount = 0;
+  }
+}
+
+//
+// Redraws all cells of a chunk into the chunk's raster cache.
+//
+static void rasteriseChunk(Tilemap& tilemap, const Spritesheet& sheet, int chunkRow, int chunkCol)
+{
+  TilemapChunk& chunk = tilemap._chunks[chunkCol + (chunkRow * tilemap._chunkCount._x)];
+  std::fill(chunk._pxColors.begin(), chunk._pxColors.end(), Color4u{});
+  chunk._isDirty = false;
+
+  if(chunk._usedCellCount == 0)
+    return;
+
+  const Color4u* sheetPxs = sheet._image.getPixels();
+  int sheetStride = sheet._image.getStride();
+
+  int rowBase = chunkRow * TILEMAP_CHUNK_SIZE;
+  int colBase = chunkCol * TILEMAP_CHUNK_SIZE;
+  int rowMax = std::min(rowBase + TILEMAP_CHUNK_SIZE, tilemap._size._y);
+  int colMax = std::min(colBase + TILEMAP_CHUNK_SIZE, tilemap._size._x);
+
+  for(int row = rowBase; row < rowMax; ++row){
+    for(int col = colBase; col < colMax; ++col){
+      SpriteID_t spriteid = tilemap._cells[col + (row * tilemap._size._x)];
+      if(spriteid == EMPTY_TILE) continue;
+      spriteid = (spriteid < static_cast<int>(sheet._sprites.size())) ? spriteid : 0; // may be an error sheet with 1 sprite.
+      const Sprite& sprite = sheet._sprites[spriteid];
+      int spriteRowMax = std::min(sprite._size._y, tilemap._cellSize._y);
+      int spriteColMax = std::min(sprite._size._x, tilemap._cellSize._x);
+      int chunkPxRowBase = (row - rowBase) * tilemap._cellSize._y;
+      int chunkPxColBase = (col - colBase) * tilemap._cellSize._x;
+      for(int spriteRow = 0; spriteRow < spriteRowMax; ++spriteRow){
+        const Color4u* src = sheetPxs + ((sprite._position._y + spriteRow) * sheetStride) + sprite._position._x;
+        Color4u* dst = chunk._pxColors.data() + chunkPxColBase +
+                       ((chunkPxRowBase + spriteRow) * tilemap._chunkSize._x);
+        memcpy(static_cast<void*>(dst), static_cast<const void*>(src), spriteColMax * sizeof(Color4u));
+      }
+    }
+  }
+}
+
+void invalidateTilemap(TilemapID_t tilemapid)
+{
+  assert(0 <= tilemapid && tilemapid < static_cast<int>(tilemaps.size()));
+  for(auto& chunk : tilemaps[tilemapid]._chunks)
+    chunk._isDirty = true;
+}
+
+//
+// Overwrites the screen area of a chunk with the top-most opaque pixel of the chunk's layers,
+// or with transparency where no layer has an opaque pixel, so cells emptied since the last
+// draw are erased.
+//
+static void copyChunkLayers(Vector2i position, const std::vector<Tilemap*>& layers, 
+                            int chunkRow, int chunkCol, Screen& screen)
+{
+  const Tilemap& base = *layers.front();
+  int chunkIndex = chunkCol + (chunkRow * base._chunkCount._x);
+  int screenRowBase = position._y + (chunkRow * base._chunkSize._y);
+  int screenColBase = position._x + (chunkCol * base._chunkSize._x);
+  int pxRowMin = std::max(0, -screenRowBase);
+  int pxColMin = std::max(0, -screenColBase);
+  int pxRowMax = std::min(base._chunkSize._y, screen._resolution._y - screenRowBase);
+  int pxColMax = std::min(base._chunkSize._x, screen._resolution._x - screenColBase);
+
+  for(int chunkPxRow = pxRowMin; chunkPxRow < pxRowMax; ++chunkPxRow){
+    int screenRow = screenRowBase + chunkPxRow;
+    int screenRowOffset = screenRow * screen._resolution._x;
+    int chunkPxRowOffset = chunkPxRow * base._chunkSize._x;
+    for(int chunkPxCol = pxColMin; chunkPxCol < pxColMax; ++chunkPxCol){
+      int screenCol = screenColBase + chunkPxCol;
+      Color4u color {};
+      for(auto it = layers.rbegin(); it != layers.rend(); ++it){
+        const Color4u& layerColor = (*it)->_chunks[chunkIndex]._pxColors[chunkPxCol + chunkPxRowOffset];
+        if(layerColor._a == ALPHA_KEY) continue;
+        color = (screen._xmode == PixelMode::SHADER) ? screen._pxShader(layerColor, screenCol, screenRow) : layerColor;
+        break;
+      }
+      screen._pxColors[screenCol + screenRowOffset] = color;
+    }
+  }
+}
+
+void drawTilemapLayers(Vector2i position, const TilemapID_t* layerids, int layerCount, ScreenID_t screenid)
+{
+  assert(0 <= screenid && screenid < static_cast<int>(screens.size()));
+  assert(layerids != nullptr && layerCount > 0);
+  auto& screen = screens[screenid];
+
+  auto& layers = tilemapLayers;
+  auto& sheets = tilemapLayerSheets;
+  layers.clear();
+  sheets.clear();
+  for(int i = 0; i < layerCount; ++i){
+    TilemapID_t tilemapid = layerids[i];
+    assert(0 <= tilemapid && tilemapid < static_cast<int>(tilemaps.size()));
+    Tilemap& tilemap = tilemaps[tilemapid];
+    assert(layers.empty() || tilemap._size == layers.front()->_size);
+    assert(layers.empty() || tilemap._cellSize == layers.front()->_cellSize);
+    auto search = spritesheets.find(tilemap._sheetKey);
+    assert(search != spritesheets.end());
+    layers.push_back(&tilemap);
+    sheets.push_back(&search->second._sheet);
+  }
+
+  const Tilemap& base = *layers.front();
+  for(int chunkRow = 0; chunkRow < base._chunkCount._y; ++chunkRow){
+    for(int chunkCol = 0; chunkCol < base._chunkCount._x; ++chunkCol){
+      int chunkIndex = chunkCol + (chunkRow * base._chunkCount._x);
+      bool isChunkDirty {false};
+      for(int layer = 0; layer < layerCount; ++layer){
+        if(!layers[layer]->_chunks[chunkIndex]._isDirty) continue;
+        rasteriseChunk(*layers[layer], *sheets[layer], chunkRow, chunkCol);
+        isChunkDirty = true;
+      }
+      if(!isChunkDirty)
+        continue;
+
+      copyChunkLayers(position, layers, chunkRow, chunkCol, screen);
+      screen._isMaskStale = true;
+      screen._isDirty = true;
+    }
+  }
+}
+
+void drawTilemap(Vector2i position, TilemapID_t tilemapid, ScreenID_t screenid)
+{
+  drawTilemapLayers(position, &tilemapid, 1, screenid);
+}
+
+static void computeOpacityMask(Screen& screen)
+{
+  for(int px = 0; px < screen._pxCount; ++px)
+    screen._opacityMask[px] = (screen._pxColors[px]._a != ALPHA_KEY) ? 1 : 0;
+  screen._isMaskStale = false;
+}
+
+static bool isScreenOverlapping(const Screen& a, const Screen& b)
+{
+  return a._position == b._position && 
+         a._pxSize == b._pxSize && 
+         a._resolution == b._resolution;
+}
+
+static void accumulateCoverage(const Screen& screen)
+{
+  for(int px = 0; px < screen._pxCount; ++px)
+    occlusionCoverage[px] |= screen._opacityMask[px];
+}
+
+//
+// Walks the enabled screens from the top of the stack down accumulating the opacity masks of 
+// occluding screens, building for each screen the list of its pixels not hidden by an opaque
+// pixel of a screen above it. Screens with nothing above them to occlude them are flagged to 
+// be drawn whole.
+//
+// Accumulated coverage is reset whenever the walk reaches a screen which does not overlap the
+// screens above it exactly; occlusion between such screens is simply not tested.
+//
+// The culling of the previous present is kept for screens which have not been drawn to and
+// whose coverage has not changed since, so a present of unchanged screens costs nothing. The 
+// coverage itself is only accumulated once a screen needs culling.
+//
+static void cullOccludedPixels()
+{
+  const Screen* coverageScreen {nullptr};
+  bool isCoverageChanged {false};
+  bool isCoverageBuilt {false};
+
+  for(auto it = screens.rbegin(); it != screens.rend(); ++it){
+    Screen& screen = *it;
+    if(!screen._isEnabled)
+      continue;
+
+    if(coverageScreen == nullptr || !isScreenOverlapping(*coverageScreen, screen)){
+      coverageScreen = &screen;
+      occludingScreens.clear();
+      isCoverageChanged = isOcclusionStale;
+      isCoverageBuilt = false;
+    }
+
+    if(screen._isDirty || isCoverageChanged){
+      if(!occludingScreens.empty()){
+        if(!isCoverageBuilt){
+          occlusionCoverage.assign(screen._pxCount, 0);
+          for(const Screen* occluder : occludingScreens)
+            accumulateCoverage(*occluder);
+          isCoverageBuilt = true;
+        }
+        int count {0};
+        for(int px = 0; px < screen._pxCount; ++px){
+          if(occlusionCoverage[px] || screen._pxColors[px]._a == ALPHA_KEY) continue;
+          screen._pxIndices[count++] = px;
+        }
+        screen._pxVisibleCount = count;
+      }
+      else
+        screen._pxVisibleCount = -1;
+    }
+
+    if(screen._omode != OcclusionMode::NONE){
+      if(screen._isMaskStale || (screen._omode == OcclusionMode::DYNAMIC && screen._isDirty)){
+        computeOpacityMask(screen);
+        isCoverageChanged = true;
+      }
+      if(isCoverageBuilt)
+        accumulateCoverage(screen);
+      occludingScreens.push_back(&screen);
+    }
+
+    screen._isDirty = false;
+  }
+
+  isOcclusionStale = false;
+}
+
 void present()
 {
+  cullOccludedPixels();
+
   for(auto& screen : screens){
     if(!screen._isEnabled) 
       continue;
@@ -920,7 +1298,10 @@ void present()
     glVertexPointer(2, GL_INT, 0, screen._pxPositions);
     glColorPointer(4, GL_UNSIGNED_BYTE, 0, screen._pxColors);
     glPointSize(screen._pxSize);
-    glDrawArrays(GL_POINTS, 0, screen._pxCount);
+    if(screen._pxVisibleCount < 0)
+      glDrawArrays(GL_POINTS, 0, screen._pxCount);
+    else if(screen._pxVisibleCount > 0)
+      glDrawElements(GL_POINTS, screen._pxVisibleCount, GL_UNSIGNED_INT, screen._pxIndices);
   }
 
   SDL_GL_SwapWindow(window);
@@ -932,6 +1313,15 @@ void setScreenPixelMode(PixelMode mode, int screenid)
   screens[screenid]._xmode = mode;
 }
 
+void setScreenOcclusionMode(OcclusionMode mode, int screenid)
+{
+  assert(0 <= screenid && screenid < screens.size());
+  auto& screen = screens[screenid];
+  screen._omode = mode;
+  screen._isMaskStale = true;
+  isOcclusionStale = true;
+}
+
 void setScreenSizeMode(SizeMode mode, int screenid)
 {
   assert(0 <= screenid && screenid < screens.size());
@@ -978,12 +1368,14 @@ void enableScreen(int screenid)
 {
   assert(0 <= screenid && screenid < screens.size());
   screens[screenid]._isEnabled = true;
+  isOcclusionStale = true;
 }
 
 void disableScreen(int screenid)
 {
   assert(0 <= screenid && screenid < screens.size());
   screens[screenid]._isEnabled = false;
+  isOcclusionStale = true;
 }
 
 Vector2i calculateTextSize(const std::string& text, ResourceKey_t fontKey)
@@ -0,0 +1,342 @@
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include "../include/pxr_mixer.h"
+#include "../include/pxr_simd.h"
+
+namespace pxr
+{
+namespace sfx
+{
+
+//
+// Adds numSamples interleaved samples of src into accum scaled by a gain which starts at gain
+// and changes by gainStep every frame.
+//
+static void mixSamples(float* accum, const int16_t* src, int numSamples, int numChannels, float gain, float gainStep)
+{
+  int s {0};
+
+#ifdef PXR_SIMD_SSE2
+  //
+  // Each vector lane holds one sample so with stereo sources pairs of lanes share a frame, and
+  // so a gain. Channel counts of 1 and 2 both divide the 4 lanes evenly.
+  //
+  __m128 g0 = _mm_set_ps(
+    gain + gainStep * (3 / numChannels),
+    gain + gainStep * (2 / numChannels),
+    gain + gainStep * (1 / numChannels),
+    gain
+  );
+  __m128 gstep = _mm_set1_ps(gainStep * (4 / numChannels));
+  __m128 g1 = _mm_add_ps(g0, gstep);
+  __m128 gstep2 = _mm_add_ps(gstep, gstep);
+  for(; s + 8 <= numSamples; s += 8){
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + s));
+    __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+    __m128 a0 = _mm_loadu_ps(accum + s);
+    __m128 a1 = _mm_loadu_ps(accum + s + 4);
+    a0 = _mm_add_ps(a0, _mm_mul_ps(_mm_cvtepi32_ps(lo), g0));
+    a1 = _mm_add_ps(a1, _mm_mul_ps(_mm_cvtepi32_ps(hi), g1));
+    _mm_storeu_ps(accum + s, a0);
+    _mm_storeu_ps(accum + s + 4, a1);
+    g0 = _mm_add_ps(g0, gstep2);
+    g1 = _mm_add_ps(g1, gstep2);
+  }
+#endif
+
+  for(; s < numSamples; ++s)
+    accum[s] += src[s] * (gain + gainStep * (s / numChannels));
+}
+
+static void writeSamples(const float* accum, int16_t* out, int numSamples)
+{
+  int s {0};
+
+#ifdef PXR_SIMD_SSE2
+  //
+  // The pack saturates so no explicit clamp is needed.
+  //
+  for(; s + 8 <= numSamples; s += 8){
+    __m128i lo = _mm_cvtps_epi32(_mm_loadu_ps(accum + s));
+    __m128i hi = _mm_cvtps_epi32(_mm_loadu_ps(accum + s + 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + s), _mm_packs_epi32(lo, hi));
+  }
+#endif
+
+  for(; s < numSamples; ++s){
+    float sample = std::clamp(accum[s], -32768.f, 32767.f);
+    out[s] = static_cast<int16_t>(std::lrint(sample));
+  }
+}
+
+static void writeSamples(const float* accum, float* out, int numSamples)
+{
+  constexpr float scale {1.f / 32768.f};
+  int s {0};
+
+#ifdef PXR_SIMD_SSE2
+  const __m128 vscale = _mm_set1_ps(scale);
+  const __m128 vmin = _mm_set1_ps(-1.f);
+  const __m128 vmax = _mm_set1_ps(1.f);
+  for(; s + 4 <= numSamples; s += 4){
+    __m128 x = _mm_mul_ps(_mm_loadu_ps(accum + s), vscale);
+    _mm_storeu_ps(out + s, _mm_min_ps(_mm_max_ps(x, vmin), vmax));
+  }
+#endif
+
+  for(; s < numSamples; ++s)
+    out[s] = std::clamp(accum[s] * scale, -1.f, 1.f);
+}
+
+Mixer::Mixer() :
+  _voices{},
+  _accumulator{},
+  _numChannels{0},
+  _onFinished{nullptr},
+  _onBlock{nullptr}
+{}
+
+void Mixer::initialize(int numVoices, int numChannels)
+{
+  assert(numChannels == 1 || numChannels == 2);
+  _numChannels = numChannels;
+  _voices.assign(numVoices, Voice{});
+  for(auto& v : _voices)
+    v._volume = MAX_VOLUME;
+  _accumulator.assign(BLOCK_FRAMES * numChannels, 0.f);
+}
+
+void Mixer::play(int voice, const int16_t* samples, int frameCount, int loops, int fadeFrames, int playFrames)
+{
+  assert(0 <= voice && voice < static_cast<int>(_voices.size()));
+  Voice& v = _voices[voice];
+  assert(!v._isActive);
+  v._isActive = true;
+  if(samples == nullptr || frameCount <= 0) return finish(voice);
+  v._samples = samples;
+  v._frameCount = frameCount;
+  v._position = 0;
+  v._loopsRemaining = loops;
+  v._framesUntilStop = playFrames;
+  v._isPaused = false;
+  v._isFadingOut = false;
+  float volumeGain = static_cast<float>(v._volume) / MAX_VOLUME;
+  if(fadeFrames > 0){
+    v._gain = 0.f;
+    startRamp(v, volumeGain, fadeFrames);
+  }
+  else{
+    v._gain = v._gainTarget = volumeGain;
+    v._gainStep = 0.f;
+    v._rampFramesLeft = 0;
+  }
+}
+
+template<typename Fn>
+void Mixer::forVoices(int voice, Fn fn)
+{
+  if(voice == NULL_VOICE) return;
+  if(voice == ALL_VOICES){
+    for(int i = 0; i < static_cast<int>(_voices.size()); ++i)
+      fn(i, _voices[i]);
+    return;
+  }
+  assert(0 <= voice && voice < static_cast<int>(_voices.size()));
+  fn(voice, _voices[voice]);
+}
+
+void Mixer::stop(int voice)
+{
+  forVoices(voice, [this](int i, Voice& v){
+    if(v._isActive) finish(i);
+  });
+}
+
+void Mixer::stopTimed(int voice, int frames)
+{
+  forVoices(voice, [this, frames](int i, Voice& v){
+    if(!v._isActive) return;
+    if(frames <= 0) finish(i);
+    else v._framesUntilStop = frames;
+  });
+}
+
+void Mixer::fadeOut(int voice, int frames)
+{
+  forVoices(voice, [this, frames](int i, Voice& v){
+    if(!v._isActive) return;
+    if(frames <= 0) return finish(i);
+    v._isFadingOut = true;
+    startRamp(v, 0.f, frames);
+  });
+}
+
+void Mixer::pause(int voice)
+{
+  forVoices(voice, [](int i, Voice& v){
+    if(v._isActive) v._isPaused = true;
+  });
+}
+
+void Mixer::resume(int voice)
+{
+  forVoices(voice, [](int i, Voice& v){
+    v._isPaused = false;
+  });
+}
+
+void Mixer::setVolume(int voice, int volume)
+{
+  volume = std::clamp(volume, 0, MAX_VOLUME);
+  forVoices(voice, [this, volume](int i, Voice& v){
+    v._volume = volume;
+    if(v._isActive && !v._isFadingOut)
+      startRamp(v, static_cast<float>(volume) / MAX_VOLUME, VOLUME_RAMP_FRAMES);
+  });
+}
+
+bool Mixer::isPlaying(int voice) const
+{
+  if(voice < 0) return false;
+  return _voices[voice]._isActive;
+}
+
+bool Mixer::isPaused(int voice) const
+{
+  if(voice < 0) return false;
+  return _voices[voice]._isActive && _voices[voice]._isPaused;
+}
+
+int Mixer::getVolume(int voice) const
+{
+  if(voice == NULL_VOICE) return 0;
+  if(voice == ALL_VOICES){
+    if(_voices.empty()) return 0;
+    int sum {0};
+    for(const auto& v : _voices)
+      sum += v._volume;
+    return sum / static_cast<int>(_voices.size());
+  }
+  return _voices[voice]._volume;
+}
+
+int Mixer::getActiveVoiceCount() const
+{
+  return static_cast<int>(std::count_if(_voices.begin(), _voices.end(), [](const Voice& v){
+    return v._isActive;
+  }));
+}
+
+void Mixer::startRamp(Voice& v, float target, int frames)
+{
+  v._gainTarget = target;
+  v._rampFramesLeft = std::max(1, frames);
+  v._gainStep = (target - v._gain) / v._rampFramesLeft;
+}
+
+void Mixer::finish(int voice)
+{
+  Voice& v = _voices[voice];
+  v._isActive = false;
+  v._isPaused = false;
+  v._isFadingOut = false;
+  v._samples = nullptr;
+  if(_onFinished != nullptr)
+    _onFinished(voice);
+}
+
+void Mixer::mixBlock(int frames)
+{
+  std::fill_n(_accumulator.begin(), frames * _numChannels, 0.f);
+
+  for(int voice = 0; voice < static_cast<int>(_voices.size()); ++voice){
+    Voice& v = _voices[voice];
+    int done {0};
+    while(v._isActive && !v._isPaused && done < frames){
+
+      //
+      // Split the block into spans over which nothing changes except the gain, which ramps
+      // linearly, so each span can be mixed with a single kernel call.
+      //
+      int span = std::min(frames - done, v._frameCount - v._position);
+      if(v._rampFramesLeft > 0) span = std::min(span, v._rampFramesLeft);
+      if(v._framesUntilStop > 0) span = std::min(span, v._framesUntilStop);
+
+      if(v._gain != 0.f || v._gainStep != 0.f){
+        mixSamples(
+          _accumulator.data() + done * _numChannels,
+          v._samples + v._position * _numChannels,
+          span * _numChannels,
+          _numChannels,
+          v._gain,
+          v._gainStep
+        );
+      }
+
+      v._position += span;
+      done += span;
+
+      if(v._rampFramesLeft > 0){
+        v._rampFramesLeft -= span;
+        v._gain += v._gainStep * span;
+        if(v._rampFramesLeft == 0){
+          v._gain = v._gainTarget;
+          v._gainStep = 0.f;
+          if(v._isFadingOut){
+            finish(voice);
+            break;
+          }
+        }
+      }
+
+      if(v._framesUntilStop > 0){
+        v._framesUntilStop -= span;
+        if(v._framesUntilStop == 0){
+          finish(voice);
+          break;
+        }
+      }
+
+      if(v._position == v._frameCount){
+        if(v._loopsRemaining == 0){
+          finish(voice);
+          break;
+        }
+        if(v._loopsRemaining > 0)
+          --v._loopsRemaining;
+        v._position = 0;
+      }
+    }
+  }
+}
+
+void Mixer::mix(int16_t* out, int frames)
+{
+  while(frames > 0){
+    int block = std::min(frames, BLOCK_FRAMES);
+    mixBlock(block);
+    if(_onBlock != nullptr)
+      _onBlock(_accumulator.data(), block);
+    writeSamples(_accumulator.data(), out, block * _numChannels);
+    out += block * _numChannels;
+    frames -= block;
+  }
+}
+
+void Mixer::mix(float* out, int frames)
+{
+  while(frames > 0){
+    int block = std::min(frames, BLOCK_FRAMES);
+    mixBlock(block);
+    if(_onBlock != nullptr)
+      _onBlock(_accumulator.data(), block);
+    writeSamples(_accumulator.data(), out, block * _numChannels);
+    out += block * _numChannels;
+    frames -= block;
+  }
+}
+
+} // namespace sfx
+} // namespace pxr
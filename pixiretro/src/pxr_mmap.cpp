@@ -0,0 +1,91 @@
+#include <fstream>
+#include "../include/pxr_mmap.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PXR_HAS_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace pxr
+{
+namespace io
+{
+
+MappedFile::MappedFile() :
+  _data{nullptr},
+  _size{0},
+  _isMapped{false},
+  _buffer{}
+{}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+bool MappedFile::open(const std::string& filepath)
+{
+  close();
+
+#ifdef PXR_HAS_MMAP
+  int fd = ::open(filepath.c_str(), O_RDONLY);
+  if(fd < 0)
+    return false;
+
+  struct stat info {};
+  if(fstat(fd, &info) == 0 && info.st_size > 0){
+    void* addr = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(addr != MAP_FAILED){
+      ::close(fd);
+      _data = static_cast<const uint8_t*>(addr);
+      _size = info.st_size;
+      _isMapped = true;
+      return true;
+    }
+  }
+  ::close(fd);
+#endif
+
+  return readWhole(filepath);
+}
+
+void MappedFile::close()
+{
+#ifdef PXR_HAS_MMAP
+  if(_isMapped)
+    munmap(const_cast<uint8_t*>(_data), _size);
+#endif
+  _buffer.clear();
+  _buffer.shrink_to_fit();
+  _data = nullptr;
+  _size = 0;
+  _isMapped = false;
+}
+
+bool MappedFile::readWhole(const std::string& filepath)
+{
+  std::ifstream file {filepath, std::ios_base::binary | std::ios_base::ate};
+  if(!file)
+    return false;
+
+  std::streamsize size = file.tellg();
+  if(size <= 0)
+    return false;
+
+  _buffer.resize(size);
+  file.seekg(0, std::ios::beg);
+  if(!file.read(reinterpret_cast<char*>(_buffer.data()), size)){
+    _buffer.clear();
+    return false;
+  }
+
+  _data = _buffer.data();
+  _size = _buffer.size();
+  return true;
+}
+
+} // namespace io
+} // namespace pxr
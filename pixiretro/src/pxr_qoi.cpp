@@ -0,0 +1,213 @@
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include "../include/pxr_qoi.h"
+
+namespace pxr
+{
+namespace io
+{
+
+static inline int qoiHash(gfx::Color4u px)
+{
+  return ((px._r * 3) + (px._g * 5) + (px._b * 7) + (px._a * 11)) & 0x3f;   // i.e. % 64
+}
+
+static inline uint32_t readBigEndian32(const uint8_t* bytes)
+{
+  return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+         (static_cast<uint32_t>(bytes[2]) << 8)  |  static_cast<uint32_t>(bytes[3]);
+}
+
+static inline void writeBigEndian32(std::vector<uint8_t>& data, uint32_t value)
+{
+  data.push_back(value >> 24);
+  data.push_back(value >> 16);
+  data.push_back(value >> 8);
+  data.push_back(value);
+}
+
+static inline bool operator==(gfx::Color4u a, gfx::Color4u b)
+{
+  return a._r == b._r && a._g == b._g && a._b == b._b && a._a == b._a;
+}
+
+bool Qoi::decode(const uint8_t* data, size_t size, Bmp& image)
+{
+  if(size < HEADER_SIZE_BYTES + PADDING_SIZE_BYTES || readBigEndian32(data) != QOIMAGIC)
+    return false;
+
+  int width = readBigEndian32(data + 4);
+  int height = readBigEndian32(data + 8);
+  int channels = data[12];
+  if(width <= 0 || height <= 0 || width > Bmp::BMP_MAX_WIDTH || height > Bmp::BMP_MAX_HEIGHT)
+    return false;
+  if(channels != 3 && channels != 4)
+    return false;
+
+  image.create(Vector2i{width, height}, gfx::Color4u{0, 0, 0, 0});
+  gfx::Color4u* pixels = image.getPixelsMutable();
+  int stride = image.getStride();
+
+  gfx::Color4u index[INDEX_SIZE];
+  memset(static_cast<void*>(index), 0, sizeof(index));
+  gfx::Color4u px {0, 0, 0, 255};
+  int run {0};
+
+  const uint8_t* p = data + HEADER_SIZE_BYTES;
+  const uint8_t* end = data + size - PADDING_SIZE_BYTES;
+
+  for(int row = height - 1; row >= 0; --row){
+    gfx::Color4u* dst = pixels + (row * stride);
+    int col {0};
+    while(col < width){
+      if(run > 0){
+        int count = std::min(run, width - col);
+        std::fill_n(dst + col, count, px);
+        col += count;
+        run -= count;
+        continue;
+      }
+
+      if(p >= end)
+        return false;
+
+      uint8_t op = *p++;
+      if(op == OP_RGB){
+        if(end - p < 3) return false;
+        px._r = p[0]; px._g = p[1]; px._b = p[2];
+        p += 3;
+      }
+      else if(op == OP_RGBA){
+        if(end - p < 4) return false;
+        px._r = p[0]; px._g = p[1]; px._b = p[2]; px._a = p[3];
+        p += 4;
+      }
+      else if((op & OP_MASK) == OP_INDEX){
+        px = index[op];
+      }
+      else if((op & OP_MASK) == OP_DIFF){
+        px._r += ((op >> 4) & 0x03) - 2;
+        px._g += ((op >> 2) & 0x03) - 2;
+        px._b += ( op       & 0x03) - 2;
+      }
+      else if((op & OP_MASK) == OP_LUMA){
+        if(end - p < 1) return false;
+        int dg = (op & 0x3f) - 32;
+        int b2 = *p++;
+        px._r += dg - 8 + ((b2 >> 4) & 0x0f);
+        px._g += dg;
+        px._b += dg - 8 + (b2 & 0x0f);
+      }
+      else{
+        run = (op & 0x3f) + 1;   // OP_RUN
+      }
+      index[qoiHash(px)] = px;
+
+      if(run == 0)
+        dst[col++] = px;
+    }
+  }
+
+  return true;
+}
+
+void Qoi::encode(const Bmp& image, std::vector<uint8_t>& data)
+{
+  int width = image.getWidth();
+  int height = image.getHeight();
+  const gfx::Color4u* pixels = image.getPixels();
+  int stride = image.getStride();
+
+  data.clear();
+  data.reserve(HEADER_SIZE_BYTES + (width * height * 5) + PADDING_SIZE_BYTES);
+  writeBigEndian32(data, QOIMAGIC);
+  writeBigEndian32(data, width);
+  writeBigEndian32(data, height);
+  data.push_back(4);   // channels: RGBA.
+  data.push_back(0);   // colorspace: sRGB with linear alpha.
+
+  gfx::Color4u index[INDEX_SIZE];
+  memset(static_cast<void*>(index), 0, sizeof(index));
+  gfx::Color4u prev {0, 0, 0, 255};
+  int run {0};
+
+  for(int row = height - 1; row >= 0; --row){
+    const gfx::Color4u* src = pixels + (row * stride);
+    for(int col = 0; col < width; ++col){
+      gfx::Color4u px = src[col];
+
+      if(px == prev){
+        if(++run == MAX_RUN){
+          data.push_back(OP_RUN | (run - 1));
+          run = 0;
+        }
+        continue;
+      }
+
+      if(run > 0){
+        data.push_back(OP_RUN | (run - 1));
+        run = 0;
+      }
+
+      int hash = qoiHash(px);
+      if(index[hash] == px){
+        data.push_back(OP_INDEX | hash);
+      }
+      else{
+        index[hash] = px;
+        if(px._a == prev._a){
+          int dr = static_cast<int8_t>(px._r - prev._r);
+          int dg = static_cast<int8_t>(px._g - prev._g);
+          int db = static_cast<int8_t>(px._b - prev._b);
+          int dgr = dr - dg;
+          int dgb = db - dg;
+          if(-2 <= dr && dr <= 1 && -2 <= dg && dg <= 1 && -2 <= db && db <= 1){
+            data.push_back(OP_DIFF | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2));
+          }
+          else if(-32 <= dg && dg <= 31 && -8 <= dgr && dgr <= 7 && -8 <= dgb && dgb <= 7){
+            data.push_back(OP_LUMA | (dg + 32));
+            data.push_back(((dgr + 8) << 4) | (dgb + 8));
+          }
+          else{
+            data.push_back(OP_RGB);
+            data.push_back(px._r);
+            data.push_back(px._g);
+            data.push_back(px._b);
+          }
+        }
+        else{
+          data.push_back(OP_RGBA);
+          data.push_back(px._r);
+          data.push_back(px._g);
+          data.push_back(px._b);
+          data.push_back(px._a);
+        }
+      }
+      prev = px;
+    }
+  }
+
+  if(run > 0)
+    data.push_back(OP_RUN | (run - 1));
+
+  for(int i = 0; i < PADDING_SIZE_BYTES - 1; ++i)
+    data.push_back(0);
+  data.push_back(1);
+}
+
+bool Qoi::save(const std::string& filepath, const Bmp& image)
+{
+  std::vector<uint8_t> data {};
+  encode(image, data);
+
+  std::ofstream file {filepath, std::ios_base::binary};
+  if(!file)
+    return false;
+
+  file.write(reinterpret_cast<const char*>(data.data()), data.size());
+  return static_cast<bool>(file);
+}
+
+} // namespace io
+} // namespace pxr
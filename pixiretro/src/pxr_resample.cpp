@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+#include "../include/pxr_resample.h"
+
+namespace pxr
+{
+namespace sfx
+{
+
+struct FilterDesign
+{
+  int _halfTaps;
+  int _numPhases;
+  double _kaiserBeta;
+
+  //
+  // The cutoff as a fraction of the lower Nyquist frequency; the transition band sits just
+  // below it.
+  //
+  double _cutoff;
+};
+
+static constexpr FilterDesign fastDesign {8, 64, 6.0, 0.90};
+static constexpr FilterDesign bestDesign {32, 512, 9.0, 0.97};
+
+//
+// The zeroth order modified bessel function of the first kind, by its power series.
+//
+static double besselI0(double x)
+{
+  double sum {1.0}, term {1.0};
+  for(int k = 1; k < 50; ++k){
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if(term < sum * 1e-12) break;
+  }
+  return sum;
+}
+
+Resampler::Resampler() :
+  _inRate_hz{0},
+  _outRate_hz{0},
+  _quality{RESAMPLE_FAST},
+  _numTaps{0},
+  _numPhases{0},
+  _filters{}
+{}
+
+void Resampler::initialize(int inRate_hz, int outRate_hz, int quality)
+{
+  assert(inRate_hz > 0 && outRate_hz > 0);
+  _inRate_hz = inRate_hz;
+  _outRate_hz = outRate_hz;
+  _quality = quality;
+
+  const FilterDesign& design = quality == RESAMPLE_BEST ? bestDesign : fastDesign;
+
+  //
+  // Downsampling must cut off below the output Nyquist frequency; the filter is stretched by
+  // the ratio to keep the same transition band relative to that lower cutoff.
+  //
+  double scale = std::min(1.0, static_cast<double>(outRate_hz) / inRate_hz);
+  int halfTaps = static_cast<int>(std::ceil(design._halfTaps / scale));
+  double cutoff = design._cutoff * scale;
+
+  _numTaps = halfTaps * 2;
+  _numPhases = design._numPhases;
+  _filters.assign(static_cast<size_t>(_numPhases + 1) * _numTaps, 0.f);
+
+  double i0Beta = besselI0(design._kaiserBeta);
+  for(int p = 0; p <= _numPhases; ++p){
+    double frac = static_cast<double>(p) / _numPhases;
+    float* row = _filters.data() + static_cast<size_t>(p) * _numTaps;
+    double sum {0.0};
+    for(int k = 0; k < _numTaps; ++k){
+
+      //
+      // Tap k weights the input sample k - halfTaps + 1 places from the one at or before the
+      // output position.
+      //
+      double t = (k - halfTaps + 1) - frac;
+      double x = t / halfTaps;
+      double window = std::abs(x) < 1.0 ? besselI0(design._kaiserBeta * std::sqrt(1.0 - x * x)) / i0Beta : 0.0;
+      double arg = M_PI * cutoff * t;
+      double sinc = std::abs(arg) < 1e-9 ? 1.0 : std::sin(arg) / arg;
+      double tap = cutoff * sinc * window;
+      row[k] = static_cast<float>(tap);
+      sum += tap;
+    }
+
+    //
+    // Normalise each phase to unity gain at dc so the truncated filter adds no ripple.
+    //
+    for(int k = 0; k < _numTaps; ++k)
+      row[k] = static_cast<float>(row[k] / sum);
+  }
+}
+
+int Resampler::getOutFrameCount(int inFrames) const
+{
+  return static_cast<int>((static_cast<int64_t>(inFrames) * _outRate_hz + _inRate_hz - 1) / _inRate_hz);
+}
+
+void Resampler::process(const float* in, int inFrames, int numChannels, float* out) const
+{
+  int outFrames = getOutFrameCount(inFrames);
+  int halfTaps = _numTaps / 2;
+  std::vector<float> interpolated(_numTaps);
+
+  for(int n = 0; n < outFrames; ++n){
+
+    //
+    // The output position in input frames is n * in / out; kept exact in integers so long
+    // sounds do not drift.
+    //
+    int64_t position = static_cast<int64_t>(n) * _inRate_hz;
+    int base = static_cast<int>(position / _outRate_hz);
+    int64_t remainder = position % _outRate_hz;
+
+    const float* filter {nullptr};
+    if(_quality == RESAMPLE_BEST){
+      double phase = static_cast<double>(remainder) * _numPhases / _outRate_hz;
+      int p = static_cast<int>(phase);
+      float a = static_cast<float>(phase - p);
+      const float* r0 = _filters.data() + static_cast<size_t>(p) * _numTaps;
+      const float* r1 = r0 + _numTaps;
+      for(int k = 0; k < _numTaps; ++k)
+        interpolated[k] = r0[k] + (r1[k] - r0[k]) * a;
+      filter = interpolated.data();
+    }
+    else{
+      int p = static_cast<int>((remainder * _numPhases + _outRate_hz / 2) / _outRate_hz);
+      filter = _filters.data() + static_cast<size_t>(p) * _numTaps;
+    }
+
+    //
+    // Only the taps which land within the input contribute.
+    //
+    int first = base - halfTaps + 1;
+    int k0 = std::max(0, -first);
+    int k1 = std::min(_numTaps, inFrames - first);
+
+    for(int c = 0; c < numChannels; ++c){
+      float sum {0.f};
+      const float* src = in + static_cast<int64_t>(first + k0) * numChannels + c;
+      for(int k = k0; k < k1; ++k)
+        sum += src[(k - k0) * numChannels] * filter[k];
+      out[static_cast<size_t>(n) * numChannels + c] = sum;
+    }
+  }
+}
+
+} // namespace sfx
+} // namespace pxr
@@ -3,11 +3,26 @@
 #include <cmath>
 #include <cassert>
 #include <vector>
+#include <array>
+#include <deque>
+#include <list>
 #include <algorithm>
+#include <memory>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <filesystem>
 #include <SDL2/SDL_mixer.h>
 #include "../include/pxr_sfx.h"
 #include "../include/pxr_log.h"
 #include "../include/pxr_wav.h"
+#include "../include/pxr_mixer.h"
+#include "../include/pxr_resample.h"
+#include "../include/pxr_bus.h"
 
 #include <iostream>
 
@@ -20,26 +35,584 @@ namespace sfx
 // MODULE DATA
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
+//
+// A list of channels linked through the ChannelAllocator.
+//
+struct ChannelList
+{
+  int _head {-1};
+  int _tail {-1};
+  int _count {0};
+};
+
+//
+// The pcm data of a sound is owned by a buffer borrowed from the pcm pool (when the sound had
+// to be converted to the device format), by the memory mapping of the sound's cache file (when
+// it was converted on an earlier load) or by the wav (when the file is already in the device
+// format). Either way SDL_mixer only ever references the data, it never owns a copy.
+//
 struct SoundResource
 {
   std::string _name = "";
   Mix_Chunk* _chunk = nullptr;
   int _referenceCount = 0;
+  uint8_t* _pcm = nullptr;
+  size_t _pcmCapacity = 0;
+  std::unique_ptr<io::Wav> _wav = nullptr;
+  std::unique_ptr<io::MappedFile> _cache = nullptr;
+
+  //
+  // The native mixer plays these samples (signed 16-bit in the device rate and channel count)
+  // rather than the chunk.
+  //
+  const int16_t* _samples = nullptr;
+  int _frameCount = 0;
+
+  int _priority = PRIORITY_NORMAL;
+  int _maxInstances = UNLIMITED_INSTANCES;
+
+  //
+  // The channels whose latest play is of this sound, oldest first (see ChannelAllocator).
+  //
+  ChannelList _instances {};
+
+  //
+  // Plays of this sound for which no finished event has yet been collected; the sound cannot
+  // be unloaded until there are none.
+  //
+  int _unfinishedPlays = 0;
+
+  //
+  // Whether plays duck the music, and the unfinished plays which do.
+  //
+  bool _ducksMusic = false;
+  int _duckingPlays = 0;
+
+  //
+  // The size of the pcm and whether it is loaded; an evicted sound keeps everything else.
+  //
+  size_t _bytes = 0;
+  bool _isResident = false;
+  std::list<ResourceKey_t>::iterator _lruPosition {};
+};
+
+//
+// Recycles the buffers holding converted sound data. Buffers are bucketed by power of two
+// capacity so a freed buffer can be reused by any sound of a similar size, which suits the
+// common pattern of scenes unloading and loading similar sets of sounds. The pool only retains
+// up to a fixed number of free bytes, beyond which released buffers are returned to the heap.
+//
+class PcmPool
+{
+public:
+  static constexpr size_t MIN_CAPACITY {4096};
+  static constexpr size_t MAX_RETAINED_BYTES {8 * 1024 * 1024};
+
+  ~PcmPool() {clear();}
+
+  uint8_t* acquire(size_t bytes, size_t& capacity);
+  void release(uint8_t* buffer, size_t capacity);
+  void clear();
+
+private:
+  std::unordered_map<size_t, std::vector<uint8_t*>> _freeBuffers;
+  size_t _retainedBytes {0};
+};
+
+static PcmPool pcmPool;
+
+//
+// Allocates channels to plays in constant time regardless of the number of channels. Free
+// channels are kept on a stack. Busy channels are kept on a list per priority and on a list
+// per sound, both in the order the channels were last played on, so the channel to steal for
+// a play (the oldest of the lowest priority, or the oldest instance of a sound at its limit)
+// is always the head of a list.
+//
+class ChannelAllocator
+{
+public:
+  void initialize(int numChannels);
+
+  //
+  // Returns a free channel without taking it, or -1 if all are busy.
+  //
+  int findFree() const;
+
+  //
+  // Returns the oldest busy channel of the lowest priority no higher than priority, or -1 if
+  // every channel is playing a sound of higher priority.
+  //
+  int findVictim(int priority) const;
+
+  //
+  // Marks a channel as playing a sound of the given priority. The channel must either be the
+  // channel returned by findFree or be busy, in which case it moves to the back of its lists.
+  //
+  void occupy(int channel, int priority, ChannelList* instances);
+  void release(int channel);
+
+  int getOldest(const ChannelList& list) const {return list._head;}
+
+private:
+  enum Link { LINK_PRIORITY, LINK_INSTANCE, LINK_COUNT };
+
+  struct Node
+  {
+    int _prev[LINK_COUNT];
+    int _next[LINK_COUNT];
+    int _priority;
+    ChannelList* _instances;
+    bool _isBusy;
+  };
+
+  void link(int channel, Link l, ChannelList& list);
+  void unlink(int channel, Link l, ChannelList& list);
+
+private:
+  std::vector<Node> _nodes;
+  std::vector<int> _free;
+  ChannelList _busy[PRIORITY_COUNT];
+};
+
+static ChannelAllocator channelAllocator;
+
+//
+// Maps resource keys to resources in constant time with a slot map, and resource names to keys
+// with a hash map so loading a resource already loaded needs no search.
+//
+// A key holds the index of a slot together with the generation of the slot at insertion; the
+// generation advances whenever a slot is erased, so keys to erased resources are never found
+// even once their slot is reused. Each registry also tags its keys so a sound key is not
+// mistaken for a music key. Keys are never negative.
+//
+// Slots live in a deque so resources never move once inserted.
+//
+template<typename T>
+class ResourceRegistry
+{
+public:
+  explicit ResourceRegistry(ResourceKey_t tag) : _tag{tag} {}
+
+  ResourceKey_t insert(const std::string& name, T resource);
+  void erase(ResourceKey_t key);
+  void clear();
+
+  //
+  // Return nullptr/nullResourceKey if not found.
+  //
+  T* find(ResourceKey_t key);
+  ResourceKey_t findName(const std::string& name) const;
+
+  template<typename Fn>
+  void forEach(Fn fn);
+
+private:
+  static constexpr int INDEX_BITS {16};
+  static constexpr int GENERATION_BITS {14};
+  static constexpr ResourceKey_t INDEX_MASK {(1 << INDEX_BITS) - 1};
+  static constexpr ResourceKey_t GENERATION_MASK {(1 << GENERATION_BITS) - 1};
+  static constexpr ResourceKey_t TAG_MASK {1 << (INDEX_BITS + GENERATION_BITS)};
+
+  struct Slot
+  {
+    T _resource;
+    std::string _name;
+    ResourceKey_t _generation;
+    bool _isOccupied;
+  };
+
+  ResourceKey_t makeKey(int index) const;
+
+private:
+  std::deque<Slot> _slots;
+  std::vector<int> _freeSlots;
+  std::unordered_map<std::string, ResourceKey_t> _names;
+  ResourceKey_t _tag;
+};
+
+static constexpr ResourceKey_t SOUND_KEY_TAG {0};
+static constexpr ResourceKey_t MUSIC_KEY_TAG {1 << 30};
+
+//
+// Reused between sounds as most share a sampling frequency; rebuilt whenever one does not.
+//
+static Resampler soundResampler;
+
+//
+// Cache files are a header followed by the converted pcm. The key hashes the contents of the
+// source file together with everything which determines the conversion, so editing a sound or
+// changing the configuration simply misses the cache.
+//
+struct SoundCacheHeader
+{
+  uint32_t _magic;
+  uint32_t _version;
+  uint64_t _key;
+  uint32_t _samplingFreq_hz;
+  uint16_t _sampleFormat;
+  uint16_t _numChannels;
+  uint32_t _dataSize;
+  uint32_t _reserved;
+};
+
+static_assert(sizeof(SoundCacheHeader) == 32, "sound cache data must stay aligned");
+
+static constexpr uint32_t SOUND_CACHE_MAGIC {0x43525850}; // "PXRC" little endian.
+static constexpr uint32_t SOUND_CACHE_VERSION {1};
+static constexpr const char* SOUND_CACHE_EXTENSION {".pcm"};
+
+//
+// The format of the opened audio device as reported by the mixer, which may differ from the
+// format requested in the configuration.
+//
+struct DeviceSpec
+{
+  int _samplingFreq_hz;
+  uint16_t _sampleFormat;
+  int _numChannels;
 };
 
+static DeviceSpec deviceSpec;
+
+//
+// The in-engine mixer and the audio device it renders to; only used with BACKEND_NATIVE.
+//
+static Mixer nativeMixer;
+static SDL_AudioDeviceID nativeDevice {0};
+
+//
+// Offline rendering only; see SFXConfiguration::_renderPath. The game thread stands in for the
+// audio thread and the streaming thread.
+//
+static io::WavWriter renderWriter;
+static std::vector<uint8_t> renderBuffer;
+static double renderTime_s {0.0};
+static int64_t renderedFrames {0};
+static int64_t renderMixTime_ns {0};
+
+//
+// Music is streamed from disk as it plays so a music resource is only the location of the
+// file; no sample data is resident until the music is played.
+//
 struct MusicResource
 {
   std::string _name = "";
-  Mix_Music* _music = nullptr;
+  std::string _path = "";
   int _referenceCount = 0;
 };
 
+//
+// A single-producer single-consumer ring of bytes. The producer (the streaming thread) and the
+// consumer (the audio thread) may run concurrently without locks. Capacity is a power of 2.
+//
+class PcmRing
+{
+public:
+  void allocate(size_t capacity);
+  size_t write(const uint8_t* src, size_t bytes);
+  size_t read(uint8_t* dst, size_t bytes);
+  size_t getWritable() const {return _capacity - (_head.load(std::memory_order_relaxed) - _tail.load(std::memory_order_acquire));}
+  size_t getReadable() const {return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_relaxed);}
+  size_t getCapacity() const {return _capacity;}
+
+private:
+  std::unique_ptr<uint8_t[]> _buffer {nullptr};
+  size_t _capacity {0};
+
+  //
+  // Total bytes ever written and read; positions in the buffer are these masked by capacity.
+  //
+  std::atomic<size_t> _head {0};
+  std::atomic<size_t> _tail {0};
+};
+
+//
+// Streams a wave file from disk, converting it to the device format, into a fixed size ring
+// from which the audio thread pulls samples. Resident memory is bounded by the ring and
+// scratch buffers no matter the length of the music. Streams loop forever, wrapping back to
+// the start of the file at the end of the data without a gap.
+//
+class MusicStream
+{
+public:
+  static constexpr int RING_DURATION_MS {500};
+  static constexpr size_t FILE_CHUNK_BYTES {16 * 1024};
+
+  MusicStream() = default;
+  ~MusicStream();
+
+  MusicStream(const MusicStream&) = delete;
+  MusicStream& operator=(const MusicStream&) = delete;
+
+  bool open(const std::string& wavpath);
+
+  //
+  // Producer side; tops up the ring with as much data as will fit.
+  //
+  void fill();
+
+  //
+  // Consumer side; called from the audio thread.
+  //
+  size_t read(uint8_t* dst, size_t bytes) {return _ring.read(dst, bytes);}
+
+private:
+  bool refillConverter();
+
+private:
+  io::WavStream _wav {};
+  SDL_AudioStream* _converter {nullptr};
+  PcmRing _ring {};
+  std::vector<uint8_t> _fileChunk {};
+  std::vector<uint8_t> _widenedChunk {};
+  std::vector<uint8_t> _convertedChunk {};
+  int _deviceFrameBytes {0};
+};
+
+//
+// The timeline of a music node in frames. The fade out is within the play duration, ending as
+// the node ends. Nodes which play FOREVER never end and so never fade out.
+//
+struct MusicNodeTiming
+{
+  static constexpr int64_t FOREVER {-1};
+
+  int64_t _fadeInFrames;
+  int64_t _playFrames;
+  int64_t _fadeOutFrames;
+};
+
+//
+// The music as seen by the audio thread, which owns this state and runs the music sequence on
+// its own clock. The game thread queues each node of a sequence (an opened stream and its
+// timing) while the node before it plays and the audio thread starts the queued node on the
+// exact frame the playing node ends, so transitions are gapless and unaffected by the timing
+// of the game loop. Pausing stops the clock.
+//
+struct MusicPlayback
+{
+  MusicStream* _stream {nullptr};
+  MusicNodeTiming _timing {};
+  int64_t _nodeFrame {0};
+  MusicStream* _nextStream {nullptr};
+  MusicNodeTiming _nextTiming {};
+  bool _isPaused {false};
+  int _volume {MAX_VOLUME};
+
+  //
+  // Count of queued nodes taken from the next slot, whether started or discarded by a stop.
+  //
+  uint64_t _nodesTaken {0};
+};
+
+static MusicPlayback musicPlayback;
+
+//
+// A snapshot of the music playback published by the audio thread after each callback; a set
+// of MusicStatus flags in the low bits with the count of nodes taken above them.
+//
+enum MusicStatus
+{
+  MUSIC_PLAYING    = 1 << 0,
+  MUSIC_PAUSED     = 1 << 1,
+  MUSIC_FADING_IN  = 1 << 2,
+  MUSIC_FADING_OUT = 1 << 3
+};
+
+static constexpr int MUSIC_STATUS_FLAG_BITS {4};
+static std::atomic<uint64_t> musicStatus {0};
+
+//
+// Streams handed to the audio thread, held here until the audio thread releases them. The
+// streaming thread keeps all of them topped up.
+//
+static std::vector<std::shared_ptr<MusicStream>> heldMusic;
+
+//
+// The streaming thread sleeps for this period between fills unless woken early.
+//
+static constexpr auto streamPollPeriod {std::chrono::milliseconds(10)};
+static std::thread streamThread;
+static std::mutex streamMutex;
+static std::condition_variable streamWake;
+static bool isStreamThreadRunning {false};
+static std::vector<std::shared_ptr<MusicStream>> streamingMusic;
+
+//
+// A request for the streaming thread to open and prime the stream of the next music node so
+// opening files and decoding the first of their samples never happens on the game thread.
+// Requests are identified so a result for a request which has since been superseded (e.g. by
+// playing another sequence) can be discarded. Guarded by the stream mutex.
+//
+struct MusicPrefetch
+{
+  uint64_t _id {0};
+  std::string _path {};
+  bool _isRequested {false};
+  bool _isDone {false};
+  std::shared_ptr<MusicStream> _stream {nullptr};
+};
+
+static MusicPrefetch musicPrefetch;
+
+//
+// A hit is a prefetched node handed to the audio thread while the node before it was still
+// playing; a miss is one which arrived after the node before it had ended, and so was late.
+//
+static int musicPrefetchHits {0};
+static int musicPrefetchMisses {0};
+
+//
+// Counts blocks of music mixed while the ring was short of data, i.e. the streaming thread
+// failed to keep up.
+//
+static std::atomic<int> musicUnderrunCount {0};
+
+//
+// A single-producer single-consumer queue of trivially copyable items. As with the pcm ring
+// the producer and consumer may run concurrently without locks. Capacity is a power of 2.
+//
+template<typename T>
+class SpscQueue
+{
+public:
+  void allocate(size_t capacity);
+  bool push(const T& item);
+  bool pop(T& item);
+
+  size_t getHighWater() const {return _highWater.load(std::memory_order_relaxed);}
+  size_t getCapacity() const {return _capacity;}
+
+private:
+  std::unique_ptr<T[]> _items {nullptr};
+  size_t _capacity {0};
+  std::atomic<size_t> _head {0};
+  std::atomic<size_t> _tail {0};
+  std::atomic<size_t> _highWater {0};
+};
+
+//
+// A change to playback sent from the game thread to the audio thread. All changes are sent by
+// command on both backends. Native voices take durations in frames; SDL_mixer channels are
+// driven through the Mix_* calls, which take them in milliseconds, from the music hook at the
+// start of each callback (where the audio device is already locked, so the calls never wait).
+//
+struct AudioCommand
+{
+  enum Type
+  {
+    PLAY_VOICE,
+    STOP_VOICE,
+    STOP_VOICE_TIMED,
+    FADE_OUT_VOICE,
+    PAUSE_VOICE,
+    RESUME_VOICE,
+    SET_VOICE_VOLUME,
+    QUEUE_MUSIC_NODE,
+    STOP_MUSIC,
+    PAUSE_MUSIC,
+    RESUME_MUSIC,
+    SET_MUSIC_VOLUME,
+    SET_BUS_VOLUME,
+    SET_BUS_LOW_PASS,
+    SET_MUSIC_DUCKING,
+    DUCK_MUSIC
+  };
+
+  Type _type;
+  int _voice;
+  int _frames;                // fade, or stop delay, duration
+  int _volume;
+  int _loops;
+  int _playFrames;
+  const int16_t* _samples;
+  int _frameCount;
+  Mix_Chunk* _chunk;
+  int _duration_ms;           // as _frames, for SDL_mixer channels
+  int _playDuration_ms;       // as _playFrames, for SDL_mixer channels
+  MusicStream* _stream;
+  MusicNodeTiming _timing;
+  int _bus;
+  int _cutoff_hz;
+  int _releaseFrames;         // _frames is the attack
+  bool _isDucked;
+  int64_t _queued_ns;
+};
+
+static constexpr size_t COMMAND_QUEUE_CAPACITY {1024};
+static SpscQueue<AudioCommand> audioCommands;
+static int commandsDropped {0};
+
+//
+// Written only by the audio thread as it applies commands.
+//
+static std::atomic<size_t> commandsApplied {0};
+static std::atomic<int64_t> commandLatencySum_ns {0};
+static std::atomic<int64_t> commandLatencyMax_ns {0};
+
+//
+// A histogram of durations recorded by the audio thread and read by any other. Buckets are
+// log-linear: each power of 2 of microseconds is split into SUB_BUCKETS equal buckets, so a
+// bucket is never wider than 1/SUB_BUCKETS of the durations in it, from 1us up to ~16s.
+// Counts are relaxed atomics; a summary taken during a record may miss that one sample.
+//
+class TimingHistogram
+{
+public:
+  void record(int64_t duration_ns);
+  TimingStats summarize() const;
+  void reset();
+
+private:
+  static constexpr int SUB_BUCKET_BITS {3};
+  static constexpr int SUB_BUCKETS {1 << SUB_BUCKET_BITS};
+  static constexpr int MAX_SHIFT {21};
+  static constexpr int NUM_BUCKETS {(MAX_SHIFT + 2) * SUB_BUCKETS};
+
+  static int toBucket(int64_t duration_us);
+  static float getBucketMiddle_ms(int bucket);
+
+private:
+  std::array<std::atomic<uint32_t>, NUM_BUCKETS> _buckets {};
+  std::atomic<int64_t> _max_ns {0};
+};
+
+//
+// Timings of the audio callback; see SFXStats. The callback start is only touched by the
+// audio thread. Plays are timed as their commands are applied.
+//
+static TimingHistogram callbackMixTimes;
+static TimingHistogram callbackIntervals;
+static TimingHistogram playLatencies;
+static std::atomic<int> audioUnderruns {0};
+static int64_t callbackStart_ns {0};
+
+//
+// Counts plays SDL_mixer refused when the audio thread applied them, logged on shutdown.
+//
+static std::atomic<int> mixerPlayErrors {0};
+
+//
+// Channels which have finished playing, sent from the audio thread back to the game thread.
+//
+static SpscQueue<int> finishedChannels;
+
+//
+// Streams the audio thread has finished with, sent back to the game thread to be freed. Only a
+// few streams are ever held at once so this only fills if the game thread stops collecting.
+//
+static constexpr size_t RELEASED_MUSIC_QUEUE_CAPACITY {64};
+static SpscQueue<MusicStream*> releasedMusic;
+
+//
+// Feeds the nodes of a music sequence to the audio thread, one node ahead of the node playing.
+//
 class MusicSequencePlayer
 {
 public:
-  enum State { STOPPED, PAUSED, PLAYING, FADING_OUT };
+  enum State { STOPPED, PAUSED, PLAYING };
   MusicSequencePlayer();
-  void onUpdate(float dt);
+  void onUpdate();
   void play(MusicSequence_t sequence, bool loop);
   void stop();
   void pause();
@@ -47,20 +620,39 @@ public:
   State getState() const {return _state;} 
   bool isUsingMusicResource(ResourceKey_t musicKey);
 private:
-  void playNode(const MusicSequenceNode* node);
-  void stopNode(const MusicSequenceNode* node);
-  void onPlayingUpdate(float dt);
-  void onFadingOutUpdate(float dt);
+  static constexpr int NO_NODE {-1};
+  void prefetchNextNode();
+  bool collectPrefetchedNode(uint64_t status);
+  void onNodeFailed();
 private:
   State _state;
   MusicSequence_t _sequence;
-  int _currentNode;
-  float _musicClock_s;
+  int _nextNode;
+  int _prefetchNode;
+  uint64_t _prefetchId;
+  int _failedNodes;
+  uint64_t _nodesQueued;
   bool _isLooping;
+  bool _isFirstNode;
 };
 
 static MusicSequencePlayer musicSequencePlayer;
 
+//
+// The effects buses, only touched by the audio thread (which is sent all changes by command)
+// once a device is open. On the native backend they process the mixer's blocks, otherwise the
+// SDL_mixer callbacks, which convert to and from the block buffer.
+//
+static std::array<Bus, BUS_COUNT> buses;
+static std::array<float, Mixer::BLOCK_FRAMES * Biquad::MAX_CHANNELS> busBlock;
+
+//
+// Plays of sounds which duck the music for which no finished event has yet been collected, and
+// whether the audio thread was last told to duck; the music is ducked while there are any.
+//
+static int duckingPlays {0};
+static bool isMusicDucked {false};
+
 //
 // Nyquist-Shannon sampling theorem states sampling frequency should be atleast twice 
 // that of largest wave frequency. Thus do not make the wave freq > half sampling frequency.
@@ -74,32 +666,64 @@ ResourceKey_t errorSoundKey {0};
 //
 // The set of all loaded sounds accessed via their resource key.
 //
-static ResourceKey_t nextResourceKey {0};
-static std::unordered_map<ResourceKey_t, SoundResource> sounds;
+static ResourceRegistry<SoundResource> sounds {SOUND_KEY_TAG};
+
+//
+// Every loaded sound bar the error sound from least to most recently played, and the bytes of
+// pcm held by those which are resident.
+//
+static std::list<ResourceKey_t> soundLru;
+static size_t soundBytes {0};
+static int soundEvictions {0};
+static int soundReloads {0};
 
 //
 // The set of all loaded music accessed via their resource key.
 //
-static std::unordered_map<ResourceKey_t, MusicResource> music;
+static ResourceRegistry<MusicResource> music {MUSIC_KEY_TAG};
 
 //
-// Music volume is updated in the update function at the next point in which the update will
-// succeed; volume cannot be set during fade effects.
+// The music volume as last set; the audio thread keeps its own copy in the music playback.
 //
-static int musicVolume;
-static bool hasMusicVolumeChanged {false};
+static int musicVolume {MAX_VOLUME};
 
 //
 // The configuration this module was initialized with.
 //
 SFXConfiguration sfxconfiguration;
 
+static bool isNativeBackend()
+{
+  return sfxconfiguration._backend == BACKEND_NATIVE;
+}
+
 //
 // Maintains data on which channel is playing which sound. Channel ids range from 0 up to
-// sfxconfiguration._numMixChannels - 1.
+// sfxconfiguration._numMixChannels - 1. Only accessed on the game thread, which learns of
+// channels finishing from the finished channel queue.
 //
 static std::vector<ResourceKey_t> channelPlayback;
 
+//
+// The number of plays started on each channel for which no finished event has yet been
+// collected. A stolen channel is played on again before the game thread has collected the
+// finish of its previous play so a channel is only free once all of its plays have finished.
+//
+// The sounds of those plays are queued per channel in the order they were played, which is
+// the order they finish in, so each finish can be credited to its sound. A channel with the
+// maximum number of unfinished plays cannot be stolen until some are collected, which bounds
+// the finished channel queue.
+//
+static constexpr int MAX_UNFINISHED_PLAYS {8};
+static std::vector<int> channelUnfinishedPlays;
+static std::vector<int> channelFirstPlay;
+static std::vector<ResourceKey_t> channelPlays;
+
+//
+// The paused state of native voices as last commanded.
+//
+static std::vector<bool> channelPaused;
+
 //
 // An array of current volumes for all mix channels. Stored here because in SDL_Mixer there 
 // appears to be no way to get the volume of a channel without setting it.
@@ -117,143 +741,991 @@ static std::vector<ResourceKey_t> musicUnloadQueue;
 // SOUND FUNCTIONS 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void onChannelFinished(int channel)
+uint8_t* PcmPool::acquire(size_t bytes, size_t& capacity)
 {
-  assert(0 <= channel && channel < sfxconfiguration._numMixChannels);
-  channelPlayback[channel] = nullResourceKey;
+  capacity = MIN_CAPACITY;
+  while(capacity < bytes)
+    capacity <<= 1;
+
+  auto search = _freeBuffers.find(capacity);
+  if(search != _freeBuffers.end() && !search->second.empty()){
+    uint8_t* buffer = search->second.back();
+    search->second.pop_back();
+    _retainedBytes -= capacity;
+    return buffer;
+  }
+  return new uint8_t[capacity];
 }
 
-//
-// Generates a short sinusoidal beep.
-//
-template<typename T>
-Mix_Chunk* generateSineBeep(int waveFreq_hz, float waveDuration_s)
+void PcmPool::release(uint8_t* buffer, size_t capacity)
 {
-  static_assert(std::numeric_limits<T>::is_integer);
-
-  float waveFreq_rad_per_s = waveFreq_hz * 2.f * M_PI;
-  int sampleCount = sfxconfiguration._samplingFreq_hz * waveDuration_s;
-  float samplePeriod_s = 1.f / sfxconfiguration._samplingFreq_hz;
-  T* pcm = new T[sampleCount];
-  for(int s = 0; s < sampleCount; ++s){
-    float sf = sinf(waveFreq_rad_per_s * (s * samplePeriod_s));   // wave equation = sin(wt)
-    if(std::numeric_limits<T>::is_signed){
-      if(sf < 0.f)  pcm[s] = static_cast<T>(sf * std::numeric_limits<T>::min());
-      if(sf >= 0.f) pcm[s] = static_cast<T>(sf * std::numeric_limits<T>::max());
-    }
-    else{
-      pcm[s] = static_cast<T>((sf + 1.f) * (std::numeric_limits<T>::max() / 2));
-    }
+  if(buffer == nullptr) return;
+  if(_retainedBytes + capacity > MAX_RETAINED_BYTES){
+    delete[] buffer;
+    return;
   }
+  _freeBuffers[capacity].push_back(buffer);
+  _retainedBytes += capacity;
+}
 
-  Mix_Chunk* chunk = new Mix_Chunk();
-  chunk->allocated = 1;
-  chunk->abuf = reinterpret_cast<uint8_t*>(pcm);
-  chunk->alen = sampleCount * sizeof(T);
-  chunk->volume = errorSoundVolume;
-  return chunk;
+void PcmPool::clear()
+{
+  for(auto& pair : _freeBuffers)
+    for(uint8_t* buffer : pair.second)
+      delete[] buffer;
+  _freeBuffers.clear();
+  _retainedBytes = 0;
 }
 
-static void generateErrorSound(SampleFormat format)
+void ChannelAllocator::initialize(int numChannels)
 {
-  Mix_Chunk* chunk {nullptr};
-  switch(format){
-    case SAMPLE_FORMAT_U8     : {chunk = generateSineBeep<uint8_t >(errorSoundFreq_hz, errorSoundDuration_s); break;}
-    case SAMPLE_FORMAT_S8     : {chunk = generateSineBeep<int8_t  >(errorSoundFreq_hz, errorSoundDuration_s); break;}
-    case SAMPLE_FORMAT_U16LSB : {chunk = generateSineBeep<uint16_t>(errorSoundFreq_hz, errorSoundDuration_s); break;}
-    case SAMPLE_FORMAT_S16LSB : {chunk = generateSineBeep<int16_t >(errorSoundFreq_hz, errorSoundDuration_s); break;}
-    case SAMPLE_FORMAT_S32LSB : {chunk = generateSineBeep<int32_t >(errorSoundFreq_hz, errorSoundDuration_s); break;}
-    default: assert(0);
-  }
-  SoundResource resource {};
-  resource._name = errorSoundName;
-  resource._chunk = chunk;
-  resource._referenceCount = 0;
-  errorSoundKey = nextResourceKey++;
-  sounds.emplace(std::make_pair(errorSoundKey, resource));
+  _nodes.assign(numChannels, Node{});
+  _free.clear();
+  for(int channel = numChannels - 1; channel >= 0; --channel)
+    _free.push_back(channel);
+  for(auto& list : _busy)
+    list = ChannelList{};
 }
 
-static void freeErrorSound()
+int ChannelAllocator::findFree() const
 {
-  auto search = sounds.find(errorSoundKey);
-  assert(search != sounds.end());
-  auto& resource = search->second;
-  delete[] resource._chunk->abuf;
-  delete resource._chunk;
-  resource._chunk = nullptr;
-  sounds.erase(search);
+  return _free.empty() ? -1 : _free.back();
 }
 
-static bool unloadSound(ResourceKey_t soundKey)
+int ChannelAllocator::findVictim(int priority) const
 {
-  assert(soundKey != errorSoundKey);
-  auto search = sounds.find(soundKey);
-  if(search == sounds.end()){
-    log::log(log::WARN, log::msg_sfx_unloading_nonexistent_sound, std::to_string(soundKey));
+  for(int p = PRIORITY_LOW; p <= priority; ++p)
+    if(_busy[p]._count > 0)
+      return _busy[p]._head;
+  return -1;
+}
+
+void ChannelAllocator::occupy(int channel, int priority, ChannelList* instances)
+{
+  assert(PRIORITY_LOW <= priority && priority < PRIORITY_COUNT);
+  Node& node = _nodes[channel];
+  if(node._isBusy){
+    unlink(channel, LINK_PRIORITY, _busy[node._priority]);
+    unlink(channel, LINK_INSTANCE, *node._instances);
   }
   else{
-    search->second._referenceCount--;
-    if(search->second._referenceCount <= 0){
-      Mix_FreeChunk(search->second._chunk);
-      sounds.erase(search);
-      log::log(log::INFO, log::msg_sfx_sound_unloaded, std::to_string(soundKey));
-    }
+    assert(!_free.empty() && _free.back() == channel);
+    _free.pop_back();
   }
-  return true;
+  node._isBusy = true;
+  node._priority = priority;
+  node._instances = instances;
+  link(channel, LINK_PRIORITY, _busy[priority]);
+  link(channel, LINK_INSTANCE, *instances);
 }
 
-static bool isChannelPlayingSound(ResourceKey_t soundKey)
+void ChannelAllocator::release(int channel)
 {
-  return std::find(channelPlayback.begin(), channelPlayback.end(), soundKey) != channelPlayback.end();
+  Node& node = _nodes[channel];
+  assert(node._isBusy);
+  unlink(channel, LINK_PRIORITY, _busy[node._priority]);
+  unlink(channel, LINK_INSTANCE, *node._instances);
+  node._isBusy = false;
+  node._instances = nullptr;
+  _free.push_back(channel);
 }
 
-static void unloadUnusedSounds()
+void ChannelAllocator::link(int channel, Link l, ChannelList& list)
 {
-  if(soundUnloadQueue.size() == 0) return;
-  soundUnloadQueue.erase(std::remove_if(soundUnloadQueue.begin(), soundUnloadQueue.end(), [](ResourceKey_t soundKey){
+  Node& node = _nodes[channel];
+  node._prev[l] = list._tail;
+  node._next[l] = -1;
+  if(list._tail != -1)
+    _nodes[list._tail]._next[l] = channel;
+  else
+    list._head = channel;
+  list._tail = channel;
+  ++list._count;
+}
+
+void ChannelAllocator::unlink(int channel, Link l, ChannelList& list)
+{
+  Node& node = _nodes[channel];
+  if(node._prev[l] != -1)
+    _nodes[node._prev[l]]._next[l] = node._next[l];
+  else
+    list._head = node._next[l];
+  if(node._next[l] != -1)
+    _nodes[node._next[l]]._prev[l] = node._prev[l];
+  else
+    list._tail = node._prev[l];
+  --list._count;
+}
+
+template<typename T>
+ResourceKey_t ResourceRegistry<T>::insert(const std::string& name, T resource)
+{
+  int index {0};
+  if(_freeSlots.empty()){
+    index = static_cast<int>(_slots.size());
+    assert(index <= INDEX_MASK);
+    _slots.push_back(Slot{T{}, std::string{}, 0, false});
+  }
+  else{
+    index = _freeSlots.back();
+    _freeSlots.pop_back();
+  }
+  Slot& slot = _slots[index];
+  slot._resource = std::move(resource);
+  slot._name = name;
+  slot._isOccupied = true;
+  ResourceKey_t key = makeKey(index);
+  _names[name] = key;
+  return key;
+}
+
+template<typename T>
+void ResourceRegistry<T>::erase(ResourceKey_t key)
+{
+  assert(find(key) != nullptr);
+  int index = key & INDEX_MASK;
+  Slot& slot = _slots[index];
+  auto search = _names.find(slot._name);
+  if(search != _names.end() && search->second == key)
+    _names.erase(search);
+  slot._resource = T{};
+  slot._name.clear();
+  slot._generation = (slot._generation + 1) & GENERATION_MASK;
+  slot._isOccupied = false;
+  _freeSlots.push_back(index);
+}
+
+template<typename T>
+void ResourceRegistry<T>::clear()
+{
+  _slots.clear();
+  _freeSlots.clear();
+  _names.clear();
+}
+
+template<typename T>
+T* ResourceRegistry<T>::find(ResourceKey_t key)
+{
+  if(key < 0 || (key & TAG_MASK) != _tag) return nullptr;
+  int index = key & INDEX_MASK;
+  if(index >= static_cast<int>(_slots.size())) return nullptr;
+  Slot& slot = _slots[index];
+  if(!slot._isOccupied || makeKey(index) != key) return nullptr;
+  return &slot._resource;
+}
+
+template<typename T>
+ResourceKey_t ResourceRegistry<T>::findName(const std::string& name) const
+{
+  auto search = _names.find(name);
+  return search == _names.end() ? nullResourceKey : search->second;
+}
+
+template<typename T>
+template<typename Fn>
+void ResourceRegistry<T>::forEach(Fn fn)
+{
+  for(auto& slot : _slots)
+    if(slot._isOccupied)
+      fn(slot._resource);
+}
+
+template<typename T>
+ResourceKey_t ResourceRegistry<T>::makeKey(int index) const
+{
+  return _tag | (_slots[index]._generation << INDEX_BITS) | index;
+}
+
+template<typename T>
+void SpscQueue<T>::allocate(size_t capacity)
+{
+  size_t pow2 {1};
+  while(pow2 < capacity)
+    pow2 <<= 1;
+  _items = std::make_unique<T[]>(pow2);
+  _capacity = pow2;
+  _head.store(0, std::memory_order_relaxed);
+  _tail.store(0, std::memory_order_relaxed);
+  _highWater.store(0, std::memory_order_relaxed);
+}
+
+template<typename T>
+bool SpscQueue<T>::push(const T& item)
+{
+  size_t head = _head.load(std::memory_order_relaxed);
+  size_t tail = _tail.load(std::memory_order_acquire);
+  if(head - tail == _capacity)
+    return false;
+  _items[head & (_capacity - 1)] = item;
+  _head.store(head + 1, std::memory_order_release);
+  size_t size = head + 1 - tail;
+  if(size > _highWater.load(std::memory_order_relaxed))
+    _highWater.store(size, std::memory_order_relaxed);
+  return true;
+}
+
+template<typename T>
+bool SpscQueue<T>::pop(T& item)
+{
+  size_t tail = _tail.load(std::memory_order_relaxed);
+  size_t head = _head.load(std::memory_order_acquire);
+  if(head == tail)
+    return false;
+  item = _items[tail & (_capacity - 1)];
+  _tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+static int64_t getNow_ns()
+{
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+void TimingHistogram::record(int64_t duration_ns)
+{
+  int bucket = toBucket(std::max<int64_t>(0, duration_ns) / 1000);
+  _buckets[bucket].store(_buckets[bucket].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  if(duration_ns > _max_ns.load(std::memory_order_relaxed))
+    _max_ns.store(duration_ns, std::memory_order_relaxed);
+}
+
+TimingStats TimingHistogram::summarize() const
+{
+  std::array<uint32_t, NUM_BUCKETS> counts;
+  int64_t total {0};
+  for(int b = 0; b < NUM_BUCKETS; ++b){
+    counts[b] = _buckets[b].load(std::memory_order_relaxed);
+    total += counts[b];
+  }
+
+  TimingStats stats {};
+  stats._count = static_cast<int>(total);
+  stats._max_ms = _max_ns.load(std::memory_order_relaxed) / 1e6f;
+  if(total == 0) return stats;
+
+  int64_t p50Rank = (total + 1) / 2;
+  int64_t p99Rank = std::max<int64_t>(1, (total * 99 + 99) / 100);
+  int64_t seen {0};
+  for(int b = 0; b < NUM_BUCKETS; ++b){
+    if(counts[b] == 0) continue;
+    int64_t before = seen;
+    seen += counts[b];
+    if(before < p50Rank && p50Rank <= seen)
+      stats._p50_ms = getBucketMiddle_ms(b);
+    if(before < p99Rank && p99Rank <= seen){
+      stats._p99_ms = getBucketMiddle_ms(b);
+      break;
+    }
+  }
+
+  //
+  // A bucket's middle may lie beyond the largest sample in it.
+  //
+  stats._p50_ms = std::min(stats._p50_ms, stats._max_ms);
+  stats._p99_ms = std::min(stats._p99_ms, stats._max_ms);
+  return stats;
+}
+
+void TimingHistogram::reset()
+{
+  for(auto& bucket : _buckets)
+    bucket.store(0, std::memory_order_relaxed);
+  _max_ns.store(0, std::memory_order_relaxed);
+}
+
+int TimingHistogram::toBucket(int64_t duration_us)
+{
+  if(duration_us < SUB_BUCKETS)
+    return static_cast<int>(duration_us);
+  int msb {0};
+  while((duration_us >> (msb + 1)) != 0)
+    ++msb;
+  int shift = msb - SUB_BUCKET_BITS;
+  if(shift > MAX_SHIFT)
+    return NUM_BUCKETS - 1;
+  int sub = static_cast<int>(duration_us >> shift) - SUB_BUCKETS;
+  return (shift + 1) * SUB_BUCKETS + sub;
+}
+
+float TimingHistogram::getBucketMiddle_ms(int bucket)
+{
+  if(bucket < SUB_BUCKETS)
+    return (bucket + 0.5f) / 1000.f;
+  int shift = bucket / SUB_BUCKETS - 1;
+  int sub = bucket % SUB_BUCKETS;
+  float lower_us = static_cast<float>(static_cast<int64_t>(SUB_BUCKETS + sub) << shift);
+  float width_us = static_cast<float>(int64_t{1} << shift);
+  return (lower_us + width_us * 0.5f) / 1000.f;
+}
+
+//
+// Called on the audio thread at the start and end of every callback, whichever the backend.
+//
+static void beginAudioCallback()
+{
+  int64_t now = getNow_ns();
+  if(callbackStart_ns != 0)
+    callbackIntervals.record(now - callbackStart_ns);
+  callbackStart_ns = now;
+}
+
+static void endAudioCallback(int len)
+{
+  int64_t mix_ns = getNow_ns() - callbackStart_ns;
+  callbackMixTimes.record(mix_ns);
+  int frameBytes = (SDL_AUDIO_BITSIZE(deviceSpec._sampleFormat) / 8) * deviceSpec._numChannels;
+  int64_t period_ns = static_cast<int64_t>(len / frameBytes) * 1000000000 / deviceSpec._samplingFreq_hz;
+  if(mix_ns > period_ns)
+    audioUnderruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+static int msToFrames(int duration_ms)
+{
+  return std::max(1, static_cast<int>(static_cast<int64_t>(duration_ms) * deviceSpec._samplingFreq_hz / 1000));
+}
+
+//
+// Sends a command to the audio thread. Never blocks; if the queue is full the command is
+// dropped and false returned.
+//
+static bool queueAudioCommand(AudioCommand command)
+{
+  command._queued_ns = getNow_ns();
+  if(audioCommands.push(command))
+    return true;
+  ++commandsDropped;
+  log::log(log::WARN, log::msg_sfx_command_queue_full);
+  return false;
+}
+
+//
+// Durations are given in milliseconds and converted to frames for native voices.
+//
+static bool queueVoiceCommand(AudioCommand::Type type, int voice, int duration_ms = 0, int volume = 0)
+{
+  AudioCommand command {};
+  command._type = type;
+  command._voice = voice;
+  command._frames = duration_ms > 0 ? msToFrames(duration_ms) : 0;
+  command._duration_ms = duration_ms;
+  command._volume = volume;
+  return queueAudioCommand(command);
+}
+
+//
+// Tells the audio thread whether to duck the music whenever that changes. A dropped command is
+// retried on the next call, which onUpdate makes every tick.
+//
+static void updateMusicDucking()
+{
+  bool isDucked {duckingPlays > 0};
+  if(isDucked == isMusicDucked)
+    return;
+  AudioCommand command {};
+  command._type = AudioCommand::DUCK_MUSIC;
+  command._isDucked = isDucked;
+  if(queueAudioCommand(command))
+    isMusicDucked = isDucked;
+}
+
+//
+// Called on the audio thread by either backend whenever a channel stops playing.
+//
+static void onChannelFinished(int channel)
+{
+  assert(0 <= channel && channel < sfxconfiguration._numMixChannels);
+
+  //
+  // Cannot overflow; each finish is of a play counted in channelUnfinishedPlays, which never
+  // exceeds MAX_UNFINISHED_PLAYS on any channel.
+  //
+  finishedChannels.push(channel);
+}
+
+static void pushChannelPlay(SoundChannel_t channel, ResourceKey_t soundKey)
+{
+  assert(channelUnfinishedPlays[channel] < MAX_UNFINISHED_PLAYS);
+  int slot = (channelFirstPlay[channel] + channelUnfinishedPlays[channel]) % MAX_UNFINISHED_PLAYS;
+  channelPlays[channel * MAX_UNFINISHED_PLAYS + slot] = soundKey;
+  ++channelUnfinishedPlays[channel];
+}
+
+static ResourceKey_t popChannelPlay(SoundChannel_t channel)
+{
+  assert(channelUnfinishedPlays[channel] > 0);
+  ResourceKey_t soundKey = channelPlays[channel * MAX_UNFINISHED_PLAYS + channelFirstPlay[channel]];
+  channelFirstPlay[channel] = (channelFirstPlay[channel] + 1) % MAX_UNFINISHED_PLAYS;
+  --channelUnfinishedPlays[channel];
+  return soundKey;
+}
+
+static void collectFinishedChannels()
+{
+  int channel {0};
+  while(finishedChannels.pop(channel)){
+    ResourceKey_t soundKey = popChannelPlay(channel);
+    SoundResource* resource = sounds.find(soundKey);
+    assert(resource != nullptr);
+    --resource->_unfinishedPlays;
+    if(resource->_duckingPlays > 0){
+      --resource->_duckingPlays;
+      --duckingPlays;
+    }
+    if(channelUnfinishedPlays[channel] == 0){
+      channelAllocator.release(channel);
+      channelPlayback[channel] = nullResourceKey;
+      channelPaused[channel] = false;
+    }
+  }
+}
+
+//
+// Hands converted pcm to the backend; a Mix_Chunk for SDL_mixer or a sample pointer for the
+// native mixer.
+//
+static bool attachSoundData(const uint8_t* data, int bytes, SoundResource& resource)
+{
+  resource._bytes = bytes;
+  if(isNativeBackend()){
+    resource._samples = reinterpret_cast<const int16_t*>(data);
+    resource._frameCount = bytes / (static_cast<int>(sizeof(int16_t)) * deviceSpec._numChannels);
+    if(resource._frameCount == 0){
+      log::log(log::ERROR, log::msg_sfx_fail_attach_sound, "no sample frames");
+      return false;
+    }
+    return true;
+  }
+
+  // note: the mixer never writes to chunk data; the cast only satisfies the mixer's api.
+  resource._chunk = Mix_QuickLoad_RAW(const_cast<uint8_t*>(data), bytes);
+  if(resource._chunk == nullptr){
+    log::log(log::ERROR, log::msg_sfx_fail_attach_sound, std::string{Mix_GetError()});
+    return false;
+  }
+  return true;
+}
+
+//
+// Generates a short sinusoidal beep.
+//
+template<typename T>
+Mix_Chunk* generateSineBeep(int waveFreq_hz, float waveDuration_s)
+{
+  static_assert(std::numeric_limits<T>::is_integer);
+
+  float waveFreq_rad_per_s = waveFreq_hz * 2.f * M_PI;
+  int sampleCount = sfxconfiguration._samplingFreq_hz * waveDuration_s;
+  float samplePeriod_s = 1.f / sfxconfiguration._samplingFreq_hz;
+  T* pcm = new T[sampleCount];
+  for(int s = 0; s < sampleCount; ++s){
+    float sf = sinf(waveFreq_rad_per_s * (s * samplePeriod_s));   // wave equation = sin(wt)
+    if(std::numeric_limits<T>::is_signed){
+      if(sf < 0.f)  pcm[s] = static_cast<T>(sf * std::numeric_limits<T>::min());
+      if(sf >= 0.f) pcm[s] = static_cast<T>(sf * std::numeric_limits<T>::max());
+    }
+    else{
+      pcm[s] = static_cast<T>((sf + 1.f) * (std::numeric_limits<T>::max() / 2));
+    }
+  }
+
+  Mix_Chunk* chunk = new Mix_Chunk();
+  chunk->allocated = 1;
+  chunk->abuf = reinterpret_cast<uint8_t*>(pcm);
+  chunk->alen = sampleCount * sizeof(T);
+  chunk->volume = errorSoundVolume;
+  return chunk;
+}
+
+static void generateErrorSound(SampleFormat format)
+{
+  Mix_Chunk* chunk {nullptr};
+  switch(format){
+    case SAMPLE_FORMAT_U8     : {chunk = generateSineBeep<uint8_t >(errorSoundFreq_hz, errorSoundDuration_s); break;}
+    case SAMPLE_FORMAT_S8     : {chunk = generateSineBeep<int8_t  >(errorSoundFreq_hz, errorSoundDuration_s); break;}
+    case SAMPLE_FORMAT_U16LSB : {chunk = generateSineBeep<uint16_t>(errorSoundFreq_hz, errorSoundDuration_s); break;}
+    case SAMPLE_FORMAT_S16LSB : {chunk = generateSineBeep<int16_t >(errorSoundFreq_hz, errorSoundDuration_s); break;}
+    case SAMPLE_FORMAT_S32LSB : {chunk = generateSineBeep<int32_t >(errorSoundFreq_hz, errorSoundDuration_s); break;}
+    default: assert(0);
+  }
+  SoundResource resource {};
+  resource._name = errorSoundName;
+  resource._chunk = chunk;
+  resource._referenceCount = 0;
+  if(isNativeBackend())
+    attachSoundData(chunk->abuf, chunk->alen, resource);
+  errorSoundKey = sounds.insert(errorSoundName, std::move(resource));
+}
+
+static void freeErrorSound()
+{
+  SoundResource* resource = sounds.find(errorSoundKey);
+  assert(resource != nullptr);
+  delete[] resource->_chunk->abuf;
+  delete resource->_chunk;
+  resource->_chunk = nullptr;
+  sounds.erase(errorSoundKey);
+}
+
+static void freeSoundResource(SoundResource& resource)
+{
+  //
+  // Chunks created with Mix_QuickLoad_RAW do not own their buffers so this only frees the
+  // chunk itself.
+  //
+  Mix_FreeChunk(resource._chunk);
+  resource._chunk = nullptr;
+  pcmPool.release(resource._pcm, resource._pcmCapacity);
+  resource._pcm = nullptr;
+  resource._pcmCapacity = 0;
+  resource._wav.reset();
+  resource._cache.reset();
+  resource._samples = nullptr;
+  resource._frameCount = 0;
+  if(resource._isResident)
+    soundBytes -= resource._bytes;
+  resource._bytes = 0;
+  resource._isResident = false;
+}
+
+static bool unloadSound(ResourceKey_t soundKey)
+{
+  assert(soundKey != errorSoundKey);
+  SoundResource* resource = sounds.find(soundKey);
+  if(resource == nullptr){
+    log::log(log::WARN, log::msg_sfx_unloading_nonexistent_sound, std::to_string(soundKey));
+  }
+  else{
+    resource->_referenceCount--;
+    if(resource->_referenceCount <= 0){
+      freeSoundResource(*resource);
+      soundLru.erase(resource->_lruPosition);
+      sounds.erase(soundKey);
+      log::log(log::INFO, log::msg_sfx_sound_unloaded, std::to_string(soundKey));
+    }
+  }
+  return true;
+}
+
+static bool isChannelPlayingSound(ResourceKey_t soundKey)
+{
+  SoundResource* resource = sounds.find(soundKey);
+  return resource != nullptr && resource->_unfinishedPlays > 0;
+}
+
+static void unloadUnusedSounds()
+{
+  if(soundUnloadQueue.size() == 0) return;
+  soundUnloadQueue.erase(std::remove_if(soundUnloadQueue.begin(), soundUnloadQueue.end(), [](ResourceKey_t soundKey){
     return !isChannelPlayingSound(soundKey) && unloadSound(soundKey);
-  }));
+  }), soundUnloadQueue.end());
+}
+
+//
+// Evicts the least recently played sounds not playing until within budget. The sound just
+// loaded is spared so a play never evicts its own sound; if the sounds playing alone exceed
+// the budget the rest are evicted as they finish.
+//
+static void evictSounds(ResourceKey_t sparedKey = nullResourceKey)
+{
+  size_t budget = static_cast<size_t>(sfxconfiguration._soundBudget_kb) * 1024;
+  if(budget == 0) return;
+  for(auto it = soundLru.begin(); it != soundLru.end() && soundBytes > budget; ++it){
+    if(*it == sparedKey) continue;
+    SoundResource* resource = sounds.find(*it);
+    assert(resource != nullptr);
+    if(!resource->_isResident || resource->_unfinishedPlays > 0) continue;
+    freeSoundResource(*resource);
+    ++soundEvictions;
+    log::log(log::INFO, log::msg_sfx_sound_evicted, std::to_string(*it));
+  }
+}
+
+static ResourceKey_t returnErrorSound()
+{
+  SoundResource* resource = sounds.find(errorSoundKey);
+  assert(resource != nullptr);
+  resource->_referenceCount++;
+  log::log(log::INFO, log::msg_sfx_error_sound_usage, std::to_string(resource->_referenceCount));
+  return errorSoundKey;
+}
+
+//
+// SDL has no 24-bit sample format so 24-bit wavs are widened to 32-bit before conversion.
+//
+static SDL_AudioFormat getWavFormat(int bitsPerSample)
+{
+  switch(bitsPerSample){
+    case 8  : return AUDIO_U8;
+    case 16 : return AUDIO_S16LSB;
+    default : return AUDIO_S32LSB;
+  }
+}
+
+static void widenS24ToS32(const uint8_t* src, int numSamples, uint8_t* dst)
+{
+  int32_t* out = reinterpret_cast<int32_t*>(dst);
+  for(int s = 0; s < numSamples; ++s, src += 3)
+    out[s] = static_cast<int32_t>((src[0] << 8) | (src[1] << 16) | (static_cast<uint32_t>(src[2]) << 24));
+}
+
+//
+// The format sounds are converted to; the device format for SDL_mixer, signed 16-bit samples
+// for the native mixer. Both use the device rate and channel count.
+//
+static SDL_AudioFormat getMixFormat()
+{
+  return isNativeBackend() ? AUDIO_S16SYS : deviceSpec._sampleFormat;
+}
+
+//
+// Reads the samples of a wav as floats in [-1, 1).
+//
+static void readWavSamples(const io::Wav& wav, std::vector<float>& samples)
+{
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(wav.getSampleData());
+  size_t numSamples = static_cast<size_t>(wav.getFrameCount()) * wav.getNumChannels();
+  samples.resize(numSamples);
+  switch(wav.getBitsPerSample()){
+    case 8:
+      for(size_t s = 0; s < numSamples; ++s)
+        samples[s] = (src[s] - 128) / 128.f;
+      break;
+    case 16:
+      for(size_t s = 0; s < numSamples; ++s, src += 2)
+        samples[s] = static_cast<int16_t>(src[0] | (src[1] << 8)) / 32768.f;
+      break;
+    default:
+      for(size_t s = 0; s < numSamples; ++s, src += 3)
+        samples[s] = static_cast<int32_t>((src[0] << 8) | (src[1] << 16) | (static_cast<uint32_t>(src[2]) << 24)) / 2147483648.f;
+      break;
+  }
+}
+
+//
+// Stereo is mixed down to mono by averaging the channels; mono is spread to both channels.
+//
+static void convertChannels(std::vector<float>& samples, int fromChannels, int toChannels)
+{
+  if(fromChannels == toChannels) return;
+  if(fromChannels == 2){
+    size_t numFrames = samples.size() / 2;
+    for(size_t f = 0; f < numFrames; ++f)
+      samples[f] = 0.5f * (samples[2 * f] + samples[2 * f + 1]);
+    samples.resize(numFrames);
+  }
+  else{
+    size_t numFrames = samples.size();
+    samples.resize(numFrames * 2);
+    for(size_t f = numFrames; f-- > 0;)
+      samples[2 * f] = samples[2 * f + 1] = samples[f];
+  }
+}
+
+template<typename T>
+static void quantizeSamples(const float* samples, size_t numSamples, double scale, double offset, uint8_t* out)
+{
+  constexpr double min = std::numeric_limits<T>::min();
+  constexpr double max = std::numeric_limits<T>::max();
+  T* dst = reinterpret_cast<T*>(out);
+  for(size_t s = 0; s < numSamples; ++s)
+    dst[s] = static_cast<T>(std::clamp(std::nearbyint(samples[s] * scale + offset), min, max));
+}
+
+//
+// Writes float samples in a sample format; returns false for formats this module does not
+// support.
+//
+static bool writeSamples(const float* samples, size_t numSamples, SDL_AudioFormat format, uint8_t* out)
+{
+  switch(format){
+    case AUDIO_U8     : quantizeSamples<uint8_t >(samples, numSamples, 128.0, 128.0, out); return true;
+    case AUDIO_S8     : quantizeSamples<int8_t  >(samples, numSamples, 128.0, 0.0, out); return true;
+    case AUDIO_U16LSB : quantizeSamples<uint16_t>(samples, numSamples, 32768.0, 32768.0, out); return true;
+    case AUDIO_S16LSB : quantizeSamples<int16_t >(samples, numSamples, 32768.0, 0.0, out); return true;
+    case AUDIO_S32LSB : quantizeSamples<int32_t >(samples, numSamples, 2147483648.0, 0.0, out); return true;
+    case AUDIO_F32LSB :
+      for(size_t s = 0; s < numSamples; ++s)
+        reinterpret_cast<float*>(out)[s] = std::clamp(samples[s], -1.f, 1.f);
+      return true;
+    default: return false;
+  }
+}
+
+//
+// 64-bit FNV-1a taken a word at a time rather than a byte at a time; only ever compared with
+// itself so the deviation from the standard is harmless, and it is several times faster.
+//
+static uint64_t hashBytes(const uint8_t* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull)
+{
+  constexpr uint64_t prime {0x100000001b3ull};
+  size_t i {0};
+  for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)){
+    uint64_t word;
+    std::memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * prime;
+  }
+  for(; i < size; ++i)
+    hash = (hash ^ data[i]) * prime;
+  return hash;
+}
+
+//
+// Keys the conversion of an opened (not yet decoded) wav by its file bytes and the device spec.
+//
+static uint64_t makeSoundCacheKey(const io::Wav& wav)
+{
+  uint32_t conversion[] {
+    SOUND_CACHE_VERSION,
+    static_cast<uint32_t>(deviceSpec._samplingFreq_hz),
+    getMixFormat(),
+    static_cast<uint32_t>(deviceSpec._numChannels),
+    static_cast<uint32_t>(sfxconfiguration._resampleQuality)
+  };
+  uint64_t key = hashBytes(wav.getFileData(), wav.getFileSize());
+  return hashBytes(reinterpret_cast<const uint8_t*>(conversion), sizeof(conversion), key);
+}
+
+static std::string getSoundCachePath(const std::string& soundName, uint64_t key)
+{
+  char hex[17];
+  snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(key));
+  std::string path {RESOURCE_PATH_SOUND_CACHE};
+  path += soundName;
+  path += '.';
+  path += hex;
+  path += SOUND_CACHE_EXTENSION;
+  return path;
+}
+
+static bool loadCachedSound(const std::string& cachepath, uint64_t key, SoundResource& resource)
+{
+  auto cache = std::make_unique<io::MappedFile>();
+  if(!cache->open(cachepath) || cache->getSize() < sizeof(SoundCacheHeader))
+    return false;
+
+  SoundCacheHeader header {};
+  std::memcpy(&header, cache->getData(), sizeof(header));
+  bool isValid = 
+    header._magic == SOUND_CACHE_MAGIC &&
+    header._version == SOUND_CACHE_VERSION &&
+    header._key == key &&
+    header._samplingFreq_hz == static_cast<uint32_t>(deviceSpec._samplingFreq_hz) &&
+    header._sampleFormat == getMixFormat() &&
+    header._numChannels == deviceSpec._numChannels &&
+    header._dataSize == cache->getSize() - sizeof(SoundCacheHeader);
+
+  if(!isValid || !attachSoundData(cache->getData() + sizeof(header), header._dataSize, resource))
+    return false;
+
+  resource._cache = std::move(cache);
+  log::log(log::INFO, log::msg_sfx_sound_cache_hit, cachepath);
+  return true;
+}
+
+//
+// Removes the cache files of a sound other than keepPath; the sound's cache files differ only
+// by their keys, which are all the same length.
+//
+static void removeStaleCachedSounds(const std::string& keepPath)
+{
+  namespace fs = std::filesystem;
+
+  fs::path keep {keepPath};
+  std::string keepName = keep.filename().string();
+  size_t keyLength = 16 + std::strlen(SOUND_CACHE_EXTENSION);
+  if(keepName.size() < keyLength)
+    return;
+  std::string prefix = keepName.substr(0, keepName.size() - keyLength);
+
+  std::error_code error {};
+  std::vector<fs::path> stale {};
+  for(const auto& entry : fs::directory_iterator{keep.parent_path(), error}){
+    std::string name = entry.path().filename().string();
+    if(name.size() == keepName.size() && name != keepName && 
+       name.compare(0, prefix.size(), prefix) == 0 &&
+       name.compare(name.size() - std::strlen(SOUND_CACHE_EXTENSION), std::string::npos, SOUND_CACHE_EXTENSION) == 0)
+    {
+      stale.push_back(entry.path());
+    }
+  }
+  for(const auto& path : stale)
+    fs::remove(path, error);
+}
+
+//
+// Written to a temporary file which is then renamed so a partly written file can never be
+// mistaken for a valid one. The sound's previous cache files are then removed; they were
+// converted from an older source or for another device spec.
+//
+static void saveCachedSound(const std::string& cachepath, uint64_t key, const uint8_t* data, size_t bytes)
+{
+  namespace fs = std::filesystem;
+
+  SoundCacheHeader header {};
+  header._magic = SOUND_CACHE_MAGIC;
+  header._version = SOUND_CACHE_VERSION;
+  header._key = key;
+  header._samplingFreq_hz = deviceSpec._samplingFreq_hz;
+  header._sampleFormat = getMixFormat();
+  header._numChannels = deviceSpec._numChannels;
+  header._dataSize = static_cast<uint32_t>(bytes);
+
+  std::error_code error {};
+  fs::create_directories(fs::path{cachepath}.parent_path(), error);
+
+  std::string temppath = cachepath + ".tmp";
+  {
+    std::ofstream file {temppath, std::ios_base::binary};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(data), bytes);
+    if(!file){
+      log::log(log::WARN, log::msg_sfx_fail_write_sound_cache, cachepath);
+      return;
+    }
+  }
+
+  fs::rename(temppath, cachepath, error);
+  if(error){
+    log::log(log::WARN, log::msg_sfx_fail_write_sound_cache, cachepath + " : " + error.message());
+    fs::remove(temppath, error);
+    return;
+  }
+
+  removeStaleCachedSounds(cachepath);
 }
 
-static ResourceKey_t returnErrorSound()
+static bool isMixFormat(const io::Wav& wav)
 {
-  auto search = sounds.find(errorSoundKey);
-  assert(search != sounds.end());
-  search->second._referenceCount++;
-  log::log(log::INFO, log::msg_sfx_error_sound_usage, std::to_string(search->second._referenceCount));
-  return errorSoundKey;
+  return wav.getBitsPerSample() != 24 &&
+         getWavFormat(wav.getBitsPerSample()) == getMixFormat() &&
+         wav.getNumChannels() == deviceSpec._numChannels &&
+         wav.getSampleRate() == deviceSpec._samplingFreq_hz;
 }
 
-ResourceKey_t loadSoundWAV(ResourceName_t soundName)
+//
+// Prepares a wav already in the mix format for playback; the data is referenced directly and
+// the resource takes ownership of the wav to keep the data alive.
+//
+static bool attachWavData(std::unique_ptr<io::Wav> wav, SoundResource& resource)
 {
-  log::log(log::INFO, log::msg_sfx_loading_sound, soundName);
+  wav->decode();
+  const uint8_t* samples = reinterpret_cast<const uint8_t*>(wav->getSampleData());
+  if(!attachSoundData(samples, wav->getSampleDataSize(), resource))
+    return false;
+
+  resource._wav = std::move(wav);
+  return true;
+}
+
+//
+// Converts the samples of a wav once into a pooled buffer, caches the result and releases the
+// wav on return.
+//
+static bool convertSoundData(std::unique_ptr<io::Wav> wav, const std::string& cachepath, uint64_t cacheKey, SoundResource& resource)
+{
+  SDL_AudioFormat mixFormat = getMixFormat();
+  wav->decode();
 
-  for(auto& pair : sounds){
-    if(pair.second._name == soundName){
-      pair.second._referenceCount++;
-      std::string addendum {"reference count="};
-      addendum += std::to_string(pair.second._referenceCount);
-      log::log(log::INFO, log::msg_sfx_sound_already_loaded, addendum);
-      return pair.first;
+  std::vector<float> samples {};
+  readWavSamples(*wav, samples);
+  convertChannels(samples, wav->getNumChannels(), deviceSpec._numChannels);
+
+  if(wav->getSampleRate() != deviceSpec._samplingFreq_hz){
+    int quality = sfxconfiguration._resampleQuality == RESAMPLE_QUALITY_BEST ? Resampler::RESAMPLE_BEST : Resampler::RESAMPLE_FAST;
+    if(soundResampler.getInRate() != wav->getSampleRate() || 
+       soundResampler.getOutRate() != deviceSpec._samplingFreq_hz || 
+       soundResampler.getQuality() != quality){
+      soundResampler.initialize(wav->getSampleRate(), deviceSpec._samplingFreq_hz, quality);
     }
+    int numFrames = static_cast<int>(samples.size() / deviceSpec._numChannels);
+    std::vector<float> resampled(static_cast<size_t>(soundResampler.getOutFrameCount(numFrames)) * deviceSpec._numChannels);
+    soundResampler.process(samples.data(), numFrames, deviceSpec._numChannels, resampled.data());
+    samples.swap(resampled);
   }
 
-  SoundResource resource {};
+  wav.reset();
+
+  size_t bytes = samples.size() * (SDL_AUDIO_BITSIZE(mixFormat) / 8);
+  resource._pcm = pcmPool.acquire(bytes, resource._pcmCapacity);
+  if(!writeSamples(samples.data(), samples.size(), mixFormat, resource._pcm)){
+    log::log(log::ERROR, log::msg_sfx_fail_convert_sound, "unsupported sample format");
+    freeSoundResource(resource);
+    return false;
+  }
+
+  if(!attachSoundData(resource._pcm, static_cast<int>(bytes), resource)){
+    freeSoundResource(resource);
+    return false;
+  }
+
+  saveCachedSound(cachepath, cacheKey, resource._pcm, bytes);
+  return true;
+}
+
+//
+// Loads the pcm of a sound, either on first load or to reload it after eviction. Only the wav's
+// headers are read before deciding how: sounds already in the mix format are used as they are,
+// others are keyed by their bytes and loaded from the cache, or converted on a miss.
+//
+static bool loadSoundData(const std::string& soundName, SoundResource& resource)
+{
   std::string wavpath {};
   wavpath += RESOURCE_PATH_SOUNDS;
   wavpath += soundName;
   wavpath += io::Wav::FILE_EXTENSION;
-  resource._chunk = Mix_LoadWAV(wavpath.c_str());
-  if(resource._chunk == nullptr){
-    log::log(log::ERROR, log::msg_sfx_fail_load_sound, wavpath + " : " + Mix_GetError());
-    log::log(log::INFO, log::msg_sfx_using_error_sound, wavpath);
+
+  auto wav = std::make_unique<io::Wav>();
+  bool isLoaded {false};
+  if(wav->open(wavpath)){
+    if(isMixFormat(*wav))
+      isLoaded = attachWavData(std::move(wav), resource);
+    else{
+      uint64_t cacheKey = makeSoundCacheKey(*wav);
+      std::string cachepath = getSoundCachePath(soundName, cacheKey);
+      isLoaded = loadCachedSound(cachepath, cacheKey, resource) || 
+                 convertSoundData(std::move(wav), cachepath, cacheKey, resource);
+    }
+  }
+  //
+  // The step which failed (parsing the wav, converting it or preparing its data for playback)
+  // has logged why.
+  //
+  if(!isLoaded){
+    log::log(log::ERROR, log::msg_sfx_fail_load_sound, wavpath);
+    return false;
+  }
+  resource._isResident = true;
+  soundBytes += resource._bytes;
+  return true;
+}
+
+ResourceKey_t loadSoundWAV(ResourceName_t soundName)
+{
+  log::log(log::INFO, log::msg_sfx_loading_sound, soundName);
+
+  ResourceKey_t loadedKey = sounds.findName(soundName);
+  if(loadedKey != nullResourceKey){
+    SoundResource* loaded = sounds.find(loadedKey);
+    loaded->_referenceCount++;
+    std::string addendum {"reference count="};
+    addendum += std::to_string(loaded->_referenceCount);
+    log::log(log::INFO, log::msg_sfx_sound_already_loaded, addendum);
+    return loadedKey;
+  }
+
+  SoundResource resource {};
+  if(!loadSoundData(soundName, resource)){
+    log::log(log::INFO, log::msg_sfx_using_error_sound, soundName);
     return returnErrorSound();
   }
   resource._name = soundName;
   resource._referenceCount = 1;
 
-  ResourceKey_t newKey = nextResourceKey++;
-  sounds.emplace(std::make_pair(newKey, resource));
+  ResourceKey_t newKey = sounds.insert(soundName, std::move(resource));
+  SoundResource* loaded = sounds.find(newKey);
+  loaded->_lruPosition = soundLru.insert(soundLru.end(), newKey);
+  evictSounds(newKey);
 
   std::string addendum{};
   addendum += "[name:key]=[";
@@ -272,152 +1744,777 @@ void queueUnloadSound(ResourceKey_t soundKey)
   soundUnloadQueue.push_back(soundKey);
 }
 
-static Mix_Chunk* findChunk(ResourceKey_t soundKey)
+static SoundResource* findSound(ResourceKey_t soundKey)
 {
-  auto search = sounds.find(soundKey);
-  if(search == sounds.end()){
+  SoundResource* resource = sounds.find(soundKey);
+  if(resource == nullptr)
     log::log(log::WARN, log::msg_sfx_playing_nonexistent_sound, std::to_string(soundKey));
-    return nullptr;
-  }
-  return search->second._chunk;
+  return resource;
 }
 
-static SoundChannel_t onSoundPlayError(ResourceKey_t soundKey)
+static SoundChannel_t onSoundPlayError(ResourceKey_t soundKey, const char* reason)
 {
   std::string addendum{};
   addendum += std::to_string(soundKey);
   addendum += " : ";
-  addendum += Mix_GetError();
+  addendum += reason;
   log::log(log::WARN, log::msg_sfx_fail_play_sound, addendum);
   return NULL_CHANNEL;
 }
 
-SoundChannel_t playSound(ResourceKey_t soundKey, int loops)
+//
+// Channels are allocated here on the game thread for both backends, so a play can return its
+// channel without waiting on the audio thread and so SDL_mixer never picks a channel itself.
+//
+// A sound at its instance limit replaces its own oldest play, otherwise a play takes a free
+// channel or steals one from a sound of no higher priority. Returns -1 if there is none to be
+// had, which includes a victim whose earlier plays have yet to be collected.
+//
+static SoundChannel_t allocateChannel(const SoundResource& resource)
 {
-  auto* chunk = findChunk(soundKey);
-  if(chunk == nullptr) return NULL_CHANNEL;
-  SoundChannel_t channel = Mix_PlayChannel(-1, chunk, loops);
-  if(channel == -1) return onSoundPlayError(soundKey);
-  assert(channelPlayback[channel] == nullResourceKey);
-  channelPlayback[channel] = soundKey;
+  SoundChannel_t channel {-1};
+  if(resource._maxInstances != UNLIMITED_INSTANCES && resource._instances._count >= resource._maxInstances)
+    channel = channelAllocator.getOldest(resource._instances);
+  else{
+    channel = channelAllocator.findFree();
+    if(channel == -1)
+      channel = channelAllocator.findVictim(resource._priority);
+  }
+  if(channel == -1 || channelUnfinishedPlays[channel] == MAX_UNFINISHED_PLAYS)
+    return -1;
   return channel;
 }
 
-SoundChannel_t playSoundTimed(ResourceKey_t soundKey, int loops, int playDuration_ms)
+//
+// Stops whatever is playing on a channel about to be played on. The finish of the stopped play
+// is collected as usual so its sound stays loaded until then.
+//
+static bool stealChannel(SoundChannel_t channel)
+{
+  if(channelUnfinishedPlays[channel] == 0)
+    return true;
+  return queueVoiceCommand(AudioCommand::STOP_VOICE, channel);
+}
+
+//
+// Converted sounds reload by mapping their cache file, which takes a fraction of a millisecond,
+// so a reload is done in the play rather than deferring the play to a worker thread.
+//
+static bool reloadSound(ResourceKey_t soundKey, SoundResource& resource)
+{
+  if(!loadSoundData(resource._name, resource)){
+    log::log(log::ERROR, log::msg_sfx_fail_reload_sound, resource._name);
+    return false;
+  }
+  ++soundReloads;
+  evictSounds(soundKey);
+  return true;
+}
+
+//
+// Starts a sound on either backend. A playDuration_ms of -1 plays until the sound (and its
+// loops) end.
+//
+static SoundChannel_t playSound_(ResourceKey_t soundKey, int loops, int fadeDuration_ms, int playDuration_ms)
 {
-  auto* chunk = findChunk(soundKey);
-  if(chunk == nullptr) return NULL_CHANNEL;
-  SoundChannel_t channel = Mix_PlayChannelTimed(-1, chunk, loops, playDuration_ms);
-  if(channel == -1) return onSoundPlayError(soundKey);
-  assert(channelPlayback[channel] == nullResourceKey);
+  SoundResource* resource = findSound(soundKey);
+  if(resource == nullptr) return NULL_CHANNEL;
+
+  collectFinishedChannels();
+
+  if(soundKey != errorSoundKey){
+    if(!resource->_isResident && !reloadSound(soundKey, *resource))
+      return onSoundPlayError(soundKey, log::msg_sfx_fail_reload_sound);
+    soundLru.splice(soundLru.end(), soundLru, resource->_lruPosition);
+  }
+
+  SoundChannel_t channel = allocateChannel(*resource);
+  if(channel == -1) return onSoundPlayError(soundKey, "no channel free or stealable");
+  if(!stealChannel(channel)) return onSoundPlayError(soundKey, "failed to stop the stolen channel");
+
+  AudioCommand command {};
+  command._type = AudioCommand::PLAY_VOICE;
+  command._voice = channel;
+  command._samples = resource->_samples;
+  command._frameCount = resource->_frameCount;
+  command._chunk = resource->_chunk;
+  command._loops = loops;
+  command._frames = fadeDuration_ms > 0 ? msToFrames(fadeDuration_ms) : 0;
+  command._playFrames = playDuration_ms >= 0 ? msToFrames(playDuration_ms) : Mixer::FOREVER;
+  command._duration_ms = fadeDuration_ms;
+  command._playDuration_ms = playDuration_ms;
+  if(!queueAudioCommand(command))
+    return onSoundPlayError(soundKey, "audio command queue full");
+
+  channelAllocator.occupy(channel, resource->_priority, &resource->_instances);
+  pushChannelPlay(channel, soundKey);
+  ++resource->_unfinishedPlays;
   channelPlayback[channel] = soundKey;
+  channelPaused[channel] = false;
+  if(resource->_ducksMusic){
+    ++resource->_duckingPlays;
+    ++duckingPlays;
+    updateMusicDucking();
+  }
   return channel;
 }
 
+void setSoundPriority(ResourceKey_t soundKey, int priority)
+{
+  SoundResource* resource = sounds.find(soundKey);
+  if(resource == nullptr){
+    log::log(log::WARN, log::msg_sfx_configuring_nonexistent_sound, std::to_string(soundKey));
+    return;
+  }
+
+  //
+  // Takes effect from the sound's next play; channels already playing it keep their priority.
+  //
+  resource->_priority = std::clamp(priority, static_cast<int>(PRIORITY_LOW), static_cast<int>(PRIORITY_CRITICAL));
+}
+
+void setSoundInstanceLimit(ResourceKey_t soundKey, int maxInstances)
+{
+  SoundResource* resource = sounds.find(soundKey);
+  if(resource == nullptr){
+    log::log(log::WARN, log::msg_sfx_configuring_nonexistent_sound, std::to_string(soundKey));
+    return;
+  }
+  resource->_maxInstances = std::max(UNLIMITED_INSTANCES, maxInstances);
+}
+
+void setSoundDucksMusic(ResourceKey_t soundKey, bool ducksMusic)
+{
+  SoundResource* resource = sounds.find(soundKey);
+  if(resource == nullptr){
+    log::log(log::WARN, log::msg_sfx_configuring_nonexistent_sound, std::to_string(soundKey));
+    return;
+  }
+  resource->_ducksMusic = ducksMusic;
+}
+
+SoundChannel_t playSound(ResourceKey_t soundKey, int loops)
+{
+  return playSound_(soundKey, loops, 0, -1);
+}
+
+SoundChannel_t playSoundTimed(ResourceKey_t soundKey, int loops, int playDuration_ms)
+{
+  return playSound_(soundKey, loops, 0, playDuration_ms);
+}
+
 SoundChannel_t playSoundFadeIn(ResourceKey_t soundKey, int loops, int fadeDuration_ms)
 {
-  auto* chunk = findChunk(soundKey);
-  if(chunk == nullptr) return NULL_CHANNEL;
-  SoundChannel_t channel = Mix_FadeInChannel(-1, chunk, loops, fadeDuration_ms);
-  if(channel == -1) return onSoundPlayError(soundKey);
-  assert(channelPlayback[channel] == nullResourceKey);
-  channelPlayback[channel] = soundKey;
-  return channel;
+  return playSound_(soundKey, loops, fadeDuration_ms, -1);
+}
+
+SoundChannel_t playSoundFadeInTimed(ResourceKey_t soundKey, int loops, int fadeDuration_ms, int playDuration_ms)
+{
+  return playSound_(soundKey, loops, fadeDuration_ms, playDuration_ms);
+}
+
+void stopChannel(SoundChannel_t channel)
+{
+  if(channel == NULL_CHANNEL) return;
+  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
+  queueVoiceCommand(AudioCommand::STOP_VOICE, channel);
+}
+
+void stopChannelTimed(SoundChannel_t channel, int durationUntilStop_ms)
+{
+  if(channel == NULL_CHANNEL) return;
+  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
+  queueVoiceCommand(AudioCommand::STOP_VOICE_TIMED, channel, durationUntilStop_ms);
+}
+
+void stopChannelFadeOut(SoundChannel_t channel, int fadeDuration_ms)
+{
+  if(channel == NULL_CHANNEL) return;
+  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
+  queueVoiceCommand(AudioCommand::FADE_OUT_VOICE, channel, fadeDuration_ms);
+}
+
+//
+// Mirrors a pause or resume of channels so the paused state can be queried without asking the
+// audio thread. As with either backend only playing channels can be paused.
+//
+static void setChannelPaused(SoundChannel_t channel, bool isPaused)
+{
+  collectFinishedChannels();
+  int first = channel == ALL_CHANNELS ? 0 : channel;
+  int last = channel == ALL_CHANNELS ? sfxconfiguration._numMixChannels - 1 : channel;
+  for(int c = first; c <= last; ++c)
+    channelPaused[c] = isPaused && channelUnfinishedPlays[c] > 0;
+}
+
+void pauseChannel(SoundChannel_t channel)
+{
+  if(channel == NULL_CHANNEL) return;
+  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
+  if(queueVoiceCommand(AudioCommand::PAUSE_VOICE, channel))
+    setChannelPaused(channel, true);
+}
+
+void resumeChannel(SoundChannel_t channel)
+{
+  if(channel == NULL_CHANNEL) return;
+  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
+  if(queueVoiceCommand(AudioCommand::RESUME_VOICE, channel))
+    setChannelPaused(channel, false);
+}
+
+bool isChannelPlaying(SoundChannel_t channel)
+{
+  if(channel == NULL_CHANNEL) return false;
+  if(channel == ALL_CHANNELS) return false;
+  assert(0 <= channel && channel <= sfxconfiguration._numMixChannels - 1);
+  collectFinishedChannels();
+  return channelPlayback[channel] != nullResourceKey;
+}
+
+bool isChannelPaused(SoundChannel_t channel)
+{
+  if(channel == NULL_CHANNEL) return false;
+  if(channel == ALL_CHANNELS) return false;
+  assert(0 <= channel && channel <= sfxconfiguration._numMixChannels - 1);
+  collectFinishedChannels();
+  return channelPaused[channel];
+}
+
+void setChannelVolume(SoundChannel_t channel, int volume)
+{
+  if(channel == NULL_CHANNEL) return;
+  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
+  int vol = std::clamp(volume, MIN_VOLUME, MAX_VOLUME);
+  if(!queueVoiceCommand(AudioCommand::SET_VOICE_VOLUME, channel, 0, vol))
+    return;
+  if(channel == ALL_CHANNELS)
+    std::fill(channelVolume.begin(), channelVolume.end(), vol);
+  else
+    channelVolume[channel] = vol;
+}
+
+int getChannelVolume(SoundChannel_t channel)
+{
+  if(channel == NULL_CHANNEL) return 0;
+  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
+  return channelVolume[channel];
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// MUSIC FUNCTIONS 
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+void PcmRing::allocate(size_t capacity)
+{
+  size_t pow2 {1};
+  while(pow2 < capacity)
+    pow2 <<= 1;
+  _buffer = std::make_unique<uint8_t[]>(pow2);
+  _capacity = pow2;
+  _head.store(0, std::memory_order_relaxed);
+  _tail.store(0, std::memory_order_relaxed);
+}
+
+size_t PcmRing::write(const uint8_t* src, size_t bytes)
+{
+  size_t head = _head.load(std::memory_order_relaxed);
+  size_t tail = _tail.load(std::memory_order_acquire);
+  bytes = std::min(bytes, _capacity - (head - tail));
+  size_t offset = head & (_capacity - 1);
+  size_t firstSpan = std::min(bytes, _capacity - offset);
+  std::memcpy(_buffer.get() + offset, src, firstSpan);
+  std::memcpy(_buffer.get(), src + firstSpan, bytes - firstSpan);
+  _head.store(head + bytes, std::memory_order_release);
+  return bytes;
+}
+
+size_t PcmRing::read(uint8_t* dst, size_t bytes)
+{
+  size_t tail = _tail.load(std::memory_order_relaxed);
+  size_t head = _head.load(std::memory_order_acquire);
+  bytes = std::min(bytes, head - tail);
+  size_t offset = tail & (_capacity - 1);
+  size_t firstSpan = std::min(bytes, _capacity - offset);
+  std::memcpy(dst, _buffer.get() + offset, firstSpan);
+  std::memcpy(dst + firstSpan, _buffer.get(), bytes - firstSpan);
+  _tail.store(tail + bytes, std::memory_order_release);
+  return bytes;
+}
+
+MusicStream::~MusicStream()
+{
+  if(_converter != nullptr)
+    SDL_FreeAudioStream(_converter);
+}
+
+bool MusicStream::open(const std::string& wavpath)
+{
+  if(!_wav.open(wavpath))
+    return false;
+
+  _converter = SDL_NewAudioStream(
+    getWavFormat(_wav.getBitsPerSample()), _wav.getNumChannels(), _wav.getSampleRate(),
+    deviceSpec._sampleFormat, deviceSpec._numChannels, deviceSpec._samplingFreq_hz
+  );
+
+  if(_converter == nullptr){
+    log::log(log::ERROR, log::msg_sfx_fail_convert_sound, std::string{SDL_GetError()});
+    return false;
+  }
+
+  _deviceFrameBytes = (SDL_AUDIO_BITSIZE(deviceSpec._sampleFormat) / 8) * deviceSpec._numChannels;
+  size_t ringBytes = static_cast<size_t>(deviceSpec._samplingFreq_hz) * _deviceFrameBytes * RING_DURATION_MS / 1000;
+  size_t callbackBytes = static_cast<size_t>(sfxconfiguration._chunkSize) * _deviceFrameBytes;
+  _ring.allocate(std::max(ringBytes, callbackBytes * 2));
+
+  _fileChunk.resize(FILE_CHUNK_BYTES);
+  if(_wav.getBitsPerSample() == 24)
+    _widenedChunk.resize(FILE_CHUNK_BYTES / 3 * 4);
+  _convertedChunk.resize(FILE_CHUNK_BYTES);
+
+  return true;
+}
+
+//
+// Feeds the next chunk of the file to the converter, wrapping to the start of the data at the
+// end of the file. Returns false only if no data could be read at all.
+//
+bool MusicStream::refillConverter()
+{
+  size_t bytes = _wav.read(_fileChunk.data(), _fileChunk.size());
+  if(bytes == 0){
+    _wav.rewind();
+    bytes = _wav.read(_fileChunk.data(), _fileChunk.size());
+    if(bytes == 0)
+      return false;
+  }
+
+  const uint8_t* samples = _fileChunk.data();
+  if(_wav.getBitsPerSample() == 24){
+    int numSamples = static_cast<int>(bytes / 3);
+    widenS24ToS32(samples, numSamples, _widenedChunk.data());
+    samples = _widenedChunk.data();
+    bytes = numSamples * 4;
+  }
+
+  return SDL_AudioStreamPut(_converter, samples, static_cast<int>(bytes)) == 0;
+}
+
+void MusicStream::fill()
+{
+  if(_converter == nullptr) return;
+  while(true){
+    size_t writable = _ring.getWritable();
+    writable -= writable % _deviceFrameBytes;
+    if(writable == 0)
+      return;
+
+    if(SDL_AudioStreamAvailable(_converter) < _deviceFrameBytes && !refillConverter())
+      return;
+
+    size_t wanted = std::min(writable, _convertedChunk.size());
+    wanted -= wanted % _deviceFrameBytes;
+    int got = SDL_AudioStreamGet(_converter, _convertedChunk.data(), static_cast<int>(wanted));
+    if(got < 0)
+      return;
+    _ring.write(_convertedChunk.data(), got);
+  }
+}
+
+//
+// Serves the pending prefetch request, if any; called on the streaming thread with the stream
+// mutex locked, which is released while the file is opened and primed.
+//
+static void prefetchMusic(std::unique_lock<std::mutex>& lock)
+{
+  if(!musicPrefetch._isRequested) return;
+  uint64_t id = musicPrefetch._id;
+  std::string path = std::move(musicPrefetch._path);
+  musicPrefetch._isRequested = false;
+  lock.unlock();
+
+  auto stream = std::make_shared<MusicStream>();
+  if(stream->open(path))
+    stream->fill();
+  else
+    stream.reset();
+
+  lock.lock();
+  if(musicPrefetch._id == id){
+    musicPrefetch._stream = std::move(stream);
+    musicPrefetch._isDone = true;
+  }
+}
+
+static void fillMusicStreams(std::unique_lock<std::mutex>& lock)
+{
+  prefetchMusic(lock);
+  std::vector<std::shared_ptr<MusicStream>> streams = streamingMusic;
+  lock.unlock();
+  for(auto& stream : streams)
+    stream->fill();
+  streams.clear();
+  lock.lock();
+}
+
+static void streamMusic()
+{
+  std::unique_lock<std::mutex> lock {streamMutex};
+  while(isStreamThreadRunning){
+    fillMusicStreams(lock);
+    if(!musicPrefetch._isRequested)
+      streamWake.wait_for(lock, streamPollPeriod);
+  }
+}
+
+//
+// Largest block of music mixed at a single volume; fades are stepped at this granularity. The
+// same as the native mixer's blocks, so music can be mixed in with each of them.
+//
+static constexpr int musicMixBlockFrames {256};
+static constexpr int maxDeviceFrameBytes {8};
+
+//
+// Hands a stream back to the game thread; called on the audio thread.
+//
+static void releaseMusicStream(MusicStream*& stream)
+{
+  if(stream == nullptr) return;
+  releasedMusic.push(stream);
+  stream = nullptr;
+}
+
+static void dropNextMusicNode(MusicPlayback& playback)
+{
+  if(playback._nextStream == nullptr) return;
+  releaseMusicStream(playback._nextStream);
+  ++playback._nodesTaken;
+}
+
+static void startNextMusicNode(MusicPlayback& playback)
+{
+  playback._stream = playback._nextStream;
+  playback._timing = playback._nextTiming;
+  playback._nodeFrame = 0;
+  playback._nextStream = nullptr;
+  ++playback._nodesTaken;
+}
+
+static bool isMusicNodeEnding(const MusicPlayback& playback)
+{
+  const MusicNodeTiming& timing = playback._timing;
+  return timing._playFrames != MusicNodeTiming::FOREVER && 
+         timing._playFrames - playback._nodeFrame < timing._fadeOutFrames;
+}
+
+//
+// The gain of the playing node at its current frame due to its fades.
+//
+static float getMusicNodeGain(const MusicPlayback& playback)
+{
+  const MusicNodeTiming& timing = playback._timing;
+  float gain {1.f};
+  if(playback._nodeFrame < timing._fadeInFrames)
+    gain = static_cast<float>(playback._nodeFrame) / timing._fadeInFrames;
+  if(isMusicNodeEnding(playback)){
+    float framesLeft = static_cast<float>(timing._playFrames - playback._nodeFrame);
+    gain = std::min(gain, framesLeft / timing._fadeOutFrames);
+  }
+  return gain;
+}
+
+template<typename T>
+static void dequantizeSamples(const uint8_t* in, int numSamples, float scale, float offset, float* out)
+{
+  const T* src = reinterpret_cast<const T*>(in);
+  for(int s = 0; s < numSamples; ++s)
+    out[s] = (static_cast<float>(src[s]) - offset) * scale;
 }
 
-SoundChannel_t playSoundFadeInTimed(ResourceKey_t soundKey, int loops, int fadeDuration_ms, int playDuration_ms)
-{
-  auto* chunk = findChunk(soundKey);
-  if(chunk == nullptr) return NULL_CHANNEL;
-  SoundChannel_t channel = Mix_FadeInChannelTimed(-1, chunk, loops, fadeDuration_ms, playDuration_ms);
-  if(channel == -1) return onSoundPlayError(soundKey);
-  assert(channelPlayback[channel] == nullResourceKey);
-  channelPlayback[channel] = soundKey;
-  return channel;
+//
+// Convert between device samples and the floats, in units of 16-bit samples, which are mixed
+// and run through the buses; called on the audio thread.
+//
+static void readDeviceSamples(const uint8_t* in, int numSamples, float gain, float* out)
+{
+  switch(deviceSpec._sampleFormat){
+    case AUDIO_U8     : dequantizeSamples<uint8_t >(in, numSamples, gain * 256.f, 128.f, out); break;
+    case AUDIO_S8     : dequantizeSamples<int8_t  >(in, numSamples, gain * 256.f, 0.f, out); break;
+    case AUDIO_U16LSB : dequantizeSamples<uint16_t>(in, numSamples, gain, 32768.f, out); break;
+    case AUDIO_S16LSB : dequantizeSamples<int16_t >(in, numSamples, gain, 0.f, out); break;
+    case AUDIO_S32LSB : dequantizeSamples<int32_t >(in, numSamples, gain / 65536.f, 0.f, out); break;
+    case AUDIO_F32LSB : dequantizeSamples<float   >(in, numSamples, gain * 32768.f, 0.f, out); break;
+    default           : std::fill_n(out, numSamples, 0.f);
+  }
 }
 
-void stopChannel(SoundChannel_t channel)
-{
-  if(channel == NULL_CHANNEL) return;
-  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
-  Mix_HaltChannel(channel);
+static void writeDeviceSamples(const float* in, int numSamples, uint8_t* out)
+{
+  switch(deviceSpec._sampleFormat){
+    case AUDIO_U8     : quantizeSamples<uint8_t >(in, numSamples, 1.0 / 256.0, 128.0, out); break;
+    case AUDIO_S8     : quantizeSamples<int8_t  >(in, numSamples, 1.0 / 256.0, 0.0, out); break;
+    case AUDIO_U16LSB : quantizeSamples<uint16_t>(in, numSamples, 1.0, 32768.0, out); break;
+    case AUDIO_S16LSB : quantizeSamples<int16_t >(in, numSamples, 1.0, 0.0, out); break;
+    case AUDIO_S32LSB : quantizeSamples<int32_t >(in, numSamples, 65536.0, 0.0, out); break;
+    case AUDIO_F32LSB :
+      for(int s = 0; s < numSamples; ++s)
+        reinterpret_cast<float*>(out)[s] = std::clamp(in[s] / 32768.f, -1.f, 1.f);
+      break;
+    default: break;
+  }
 }
 
-void stopChannelTimed(SoundChannel_t channel, int durationUntilStop_ms)
+//
+// Mixes a block of music through the music bus on top of out (in units of 16-bit samples),
+// advancing the sequence; called on the audio thread. A node which ends part way through the
+// block is followed by the next node from the very next frame. Returns false, leaving out as
+// it was, if there is no music to mix.
+//
+static bool mixMusic(float* out, int frames)
 {
-  if(channel == NULL_CHANNEL) return;
-  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
-  Mix_ExpireChannel(channel, durationUntilStop_ms);
+  static_assert(musicMixBlockFrames == Mixer::BLOCK_FRAMES);
+  assert(frames <= musicMixBlockFrames);
+
+  MusicPlayback& playback = musicPlayback;
+  if(playback._isPaused || (playback._stream == nullptr && playback._nextStream == nullptr))
+    return false;
+
+  static uint8_t block[musicMixBlockFrames * maxDeviceFrameBytes];
+  static float samples[musicMixBlockFrames * Biquad::MAX_CHANNELS];
+  int sampleBytes = SDL_AUDIO_BITSIZE(deviceSpec._sampleFormat) / 8;
+  int frameBytes = sampleBytes * deviceSpec._numChannels;
+  int numSamples = frames * deviceSpec._numChannels;
+  std::fill_n(samples, numSamples, 0.f);
+  int done {0};
+
+  while(done < frames){
+    if(playback._stream == nullptr){
+      if(playback._nextStream == nullptr)
+        break;
+      startNextMusicNode(playback);
+    }
+
+    int span = frames - done;
+    if(playback._timing._playFrames != MusicNodeTiming::FOREVER)
+      span = static_cast<int>(std::min<int64_t>(span, playback._timing._playFrames - playback._nodeFrame));
+
+    int bytes = span * frameBytes;
+    int got = static_cast<int>(playback._stream->read(block, bytes));
+    if(got < bytes)
+      musicUnderrunCount.fetch_add(1, std::memory_order_relaxed);
+
+    float gain = playback._volume * getMusicNodeGain(playback) / MAX_VOLUME;
+    if(got > 0 && gain > 0.f)
+      readDeviceSamples(block, got / sampleBytes, gain, samples + done * deviceSpec._numChannels);
+
+    playback._nodeFrame += span;
+    done += span;
+
+    if(playback._timing._playFrames != MusicNodeTiming::FOREVER && 
+       playback._nodeFrame >= playback._timing._playFrames){
+      releaseMusicStream(playback._stream);
+    }
+  }
+
+  buses[BUS_MUSIC].process(samples, frames);
+  for(int s = 0; s < numSamples; ++s)
+    out[s] += samples[s];
+  return true;
 }
 
-void stopChannelFadeOut(SoundChannel_t channel, int fadeDuration_ms)
+static void publishMusicStatus()
 {
-  if(channel == NULL_CHANNEL) return;
-  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
-  Mix_FadeOutChannel(channel, fadeDuration_ms);
+  const MusicPlayback& playback = musicPlayback;
+  uint64_t status {playback._nodesTaken << MUSIC_STATUS_FLAG_BITS};
+  if(playback._stream != nullptr){
+    status |= MUSIC_PLAYING;
+    if(playback._isPaused) status |= MUSIC_PAUSED;
+    if(playback._nodeFrame < playback._timing._fadeInFrames) status |= MUSIC_FADING_IN;
+    if(isMusicNodeEnding(playback)) status |= MUSIC_FADING_OUT;
+  }
+  musicStatus.store(status, std::memory_order_release);
 }
 
-void pauseChannel(SoundChannel_t channel)
+static void applyMusicCommand(const AudioCommand& command)
 {
-  if(channel == NULL_CHANNEL) return;
-  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
-  Mix_Pause(channel);
+  MusicPlayback& playback = musicPlayback;
+  switch(command._type){
+    case AudioCommand::QUEUE_MUSIC_NODE:
+      dropNextMusicNode(playback);
+      playback._nextStream = command._stream;
+      playback._nextTiming = command._timing;
+      break;
+    case AudioCommand::STOP_MUSIC:
+      releaseMusicStream(playback._stream);
+      dropNextMusicNode(playback);
+      playback._isPaused = false;
+      break;
+    case AudioCommand::PAUSE_MUSIC:
+      playback._isPaused = true;
+      break;
+    case AudioCommand::RESUME_MUSIC:
+      playback._isPaused = false;
+      break;
+    case AudioCommand::SET_MUSIC_VOLUME:
+      playback._volume = command._volume;
+      break;
+    default:
+      assert(0);
+  }
 }
 
-void resumeChannel(SoundChannel_t channel)
+static void applyBusCommand(const AudioCommand& command)
 {
-  if(channel == NULL_CHANNEL) return;
-  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
-  Mix_Resume(channel);
+  switch(command._type){
+    case AudioCommand::SET_BUS_VOLUME:
+      buses[command._bus].setGain(static_cast<float>(command._volume) / MAX_VOLUME, command._frames);
+      break;
+    case AudioCommand::SET_BUS_LOW_PASS:
+      buses[command._bus].setLowPass(static_cast<float>(command._cutoff_hz), command._frames);
+      break;
+    case AudioCommand::SET_MUSIC_DUCKING:
+      buses[BUS_MUSIC].setDucking(static_cast<float>(command._volume) / MAX_VOLUME, command._frames, command._releaseFrames);
+      break;
+    case AudioCommand::DUCK_MUSIC:
+      buses[BUS_MUSIC].setDucked(command._isDucked);
+      break;
+    default:
+      assert(0);
+  }
 }
 
-bool isChannelPlaying(SoundChannel_t channel)
-{
-  if(channel == NULL_CHANNEL) return false;
-  if(channel == ALL_CHANNELS) return false;
-  assert(0 <= channel && channel <= sfxconfiguration._numMixChannels - 1);
-  return Mix_Playing(channel) == 1;
+//
+// A play which SDL_mixer refuses (it should not, the channel being valid and the chunk loaded)
+// is reported finished so the game thread still collects it, and counted.
+//
+static void applyMixerVoiceCommand(const AudioCommand& command)
+{
+  switch(command._type){
+    case AudioCommand::PLAY_VOICE:
+    {
+      int played {-1};
+      if(command._duration_ms > 0)
+        played = Mix_FadeInChannelTimed(command._voice, command._chunk, command._loops, command._duration_ms, command._playDuration_ms);
+      else
+        played = Mix_PlayChannelTimed(command._voice, command._chunk, command._loops, command._playDuration_ms);
+      if(played == -1){
+        mixerPlayErrors.fetch_add(1, std::memory_order_relaxed);
+        onChannelFinished(command._voice);
+      }
+      break;
+    }
+    case AudioCommand::STOP_VOICE:       Mix_HaltChannel(command._voice); break;
+    case AudioCommand::STOP_VOICE_TIMED: Mix_ExpireChannel(command._voice, command._duration_ms); break;
+    case AudioCommand::FADE_OUT_VOICE:   Mix_FadeOutChannel(command._voice, command._duration_ms); break;
+    case AudioCommand::PAUSE_VOICE:      Mix_Pause(command._voice); break;
+    case AudioCommand::RESUME_VOICE:     Mix_Resume(command._voice); break;
+    case AudioCommand::SET_VOICE_VOLUME: Mix_Volume(command._voice, command._volume); break;
+    default:
+      assert(0);
+  }
 }
 
-bool isChannelPaused(SoundChannel_t channel)
+static void applyVoiceCommand(const AudioCommand& command)
 {
-  if(channel == NULL_CHANNEL) return false;
-  if(channel == ALL_CHANNELS) return false;
-  assert(0 <= channel && channel <= sfxconfiguration._numMixChannels - 1);
-  return Mix_Paused(channel) == 1;
+  if(!isNativeBackend()){
+    applyMixerVoiceCommand(command);
+    return;
+  }
+  switch(command._type){
+    case AudioCommand::PLAY_VOICE:
+      nativeMixer.play(
+        command._voice, 
+        command._samples, 
+        command._frameCount, 
+        command._loops, 
+        command._frames, 
+        command._playFrames
+      );
+      break;
+    case AudioCommand::STOP_VOICE:       nativeMixer.stop(command._voice); break;
+    case AudioCommand::STOP_VOICE_TIMED: nativeMixer.stopTimed(command._voice, command._frames); break;
+    case AudioCommand::FADE_OUT_VOICE:   nativeMixer.fadeOut(command._voice, command._frames); break;
+    case AudioCommand::PAUSE_VOICE:      nativeMixer.pause(command._voice); break;
+    case AudioCommand::RESUME_VOICE:     nativeMixer.resume(command._voice); break;
+    case AudioCommand::SET_VOICE_VOLUME: nativeMixer.setVolume(command._voice, command._volume); break;
+    default:
+      assert(0);
+  }
 }
 
-void setChannelVolume(SoundChannel_t channel, int volume)
-{
-  if(channel == NULL_CHANNEL) return;
-  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
-  int vol = std::clamp(volume, MIN_VOLUME, MAX_VOLUME);
-  channelVolume[channel] = Mix_Volume(channel, vol); 
+//
+// Drains the command queue; called on the audio thread at the start of every callback so all
+// commands queued during a game tick take effect at the same point in the output.
+//
+static void applyAudioCommands()
+{
+  AudioCommand command {};
+  while(audioCommands.pop(command)){
+    if(command._type >= AudioCommand::SET_BUS_VOLUME)
+      applyBusCommand(command);
+    else if(command._type >= AudioCommand::QUEUE_MUSIC_NODE)
+      applyMusicCommand(command);
+    else
+      applyVoiceCommand(command);
+
+    int64_t latency_ns = std::max<int64_t>(0, getNow_ns() - command._queued_ns);
+    if(command._type == AudioCommand::PLAY_VOICE)
+      playLatencies.record(latency_ns);
+    commandLatencySum_ns.store(commandLatencySum_ns.load(std::memory_order_relaxed) + latency_ns, std::memory_order_relaxed);
+    if(latency_ns > commandLatencyMax_ns.load(std::memory_order_relaxed))
+      commandLatencyMax_ns.store(latency_ns, std::memory_order_relaxed);
+    commandsApplied.fetch_add(1, std::memory_order_relaxed);
+  }
 }
 
-int getChannelVolume(SoundChannel_t channel)
-{
-  if(channel == NULL_CHANNEL) return 0;
-  assert(ALL_CHANNELS <= channel && channel <= sfxconfiguration._numMixChannels - 1);
-  return channelVolume[channel];
+//
+// Installed as the SDL_mixer music hook which SDL_mixer calls on the audio thread every
+// callback whether or not music is playing. The hook is handed silence, and the channels are
+// mixed on top of what it writes.
+//
+static void onMusicHook(void* userdata, Uint8* stream, int len)
+{
+  beginAudioCallback();
+  applyAudioCommands();
+  int frameBytes = (SDL_AUDIO_BITSIZE(deviceSpec._sampleFormat) / 8) * deviceSpec._numChannels;
+  int frames = len / frameBytes;
+  for(int done = 0; done < frames; done += musicMixBlockFrames){
+    int block = std::min(frames - done, musicMixBlockFrames);
+    int numSamples = block * deviceSpec._numChannels;
+    std::fill_n(busBlock.data(), numSamples, 0.f);
+    if(!mixMusic(busBlock.data(), block))
+      break;
+    writeDeviceSamples(busBlock.data(), numSamples, stream + done * frameBytes);
+  }
+  publishMusicStatus();
 }
 
-/////////////////////////////////////////////////////////////////////////////////////////////////
-// MUSIC FUNCTIONS 
-/////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// Installed as the SDL_mixer post mix callback, which SDL_mixer calls once it has mixed all
+// channels, ending the callback begun in the music hook. Runs the master bus over the mix.
+//
+static void onPostMix(void* userdata, Uint8* stream, int len)
+{
+  Bus& master = buses[BUS_MASTER];
+  int frameBytes = (SDL_AUDIO_BITSIZE(deviceSpec._sampleFormat) / 8) * deviceSpec._numChannels;
+  int frames = len / frameBytes;
+  for(int done = 0; done < frames && !master.isBypassed(); done += Mixer::BLOCK_FRAMES){
+    int block = std::min(frames - done, Mixer::BLOCK_FRAMES);
+    int numSamples = block * deviceSpec._numChannels;
+    readDeviceSamples(stream + done * frameBytes, numSamples, 1.f, busBlock.data());
+    master.process(busBlock.data(), block);
+    writeDeviceSamples(busBlock.data(), numSamples, stream + done * frameBytes);
+  }
+  endAudioCallback(len);
+}
 
-static Mix_Music* findMusic(ResourceKey_t musicKey)
+static MusicResource* findMusic(ResourceKey_t musicKey)
 {
-  if(musicKey == nullResourceKey){
-    log::log(log::WARN, log::msg_sfx_playing_nonexistent_music, std::to_string(musicKey));
-    return nullptr;
-  }
-  auto search = music.find(musicKey);
-  if(search == music.end()){
+  MusicResource* resource = music.find(musicKey);
+  if(resource == nullptr)
     log::log(log::WARN, log::msg_sfx_playing_nonexistent_music, std::to_string(musicKey));
-    return nullptr;
-  }
-  return search->second._music;
+  return resource;
 }
 
 static void onMusicPlayError(ResourceKey_t musicKey)
@@ -429,92 +2526,181 @@ static void onMusicPlayError(ResourceKey_t musicKey)
   log::log(log::WARN, log::msg_sfx_fail_play_music, addendum);
 }
 
-static void playMusic_(ResourceKey_t musicKey, int loops)
+static void updateStreamingMusic()
 {
-  Mix_HaltMusic(); // to prevent the mixer play function blocking.
-  Mix_Music* found_music = findMusic(musicKey);
-  if(found_music == nullptr) return;
-  if(Mix_PlayMusic(found_music, loops) != 0) return onMusicPlayError(musicKey);
+  {
+    std::lock_guard<std::mutex> lock {streamMutex};
+    streamingMusic = heldMusic;
+  }
+  streamWake.notify_one();
+}
+
+//
+// Frees the streams the audio thread has finished with.
+//
+static void collectReleasedMusic()
+{
+  MusicStream* stream {nullptr};
+  bool isReleased {false};
+  while(releasedMusic.pop(stream)){
+    auto search = std::find_if(heldMusic.begin(), heldMusic.end(), [stream](const auto& held){
+      return held.get() == stream;
+    });
+    assert(search != heldMusic.end());
+    heldMusic.erase(search);
+    isReleased = true;
+  }
+  if(isReleased)
+    updateStreamingMusic();
 }
 
-static void playMusicFadeIn_(ResourceKey_t musicKey, int loops, int fadeDuration_ms)
+static void queueMusicCommand(AudioCommand::Type type)
 {
-  Mix_HaltMusic(); // to prevent the mixer play function blocking.
-  Mix_Music* found_music = findMusic(musicKey);
-  if(found_music == nullptr) return;
-  if(Mix_FadeInMusic(found_music, loops, fadeDuration_ms) != 0)
-      onMusicPlayError(musicKey);
+  AudioCommand command {};
+  command._type = type;
+  queueAudioCommand(command);
 }
 
-static void stopMusic_()
+//
+// Node durations are in milliseconds; a play duration of PLAY_MUSIC_FOREVER plays forever and
+// other negative durations are taken as zero.
+//
+static MusicNodeTiming getMusicNodeTiming(const MusicSequenceNode& node)
 {
-  Mix_HaltMusic();
+  auto toFrames = [](int duration_ms){
+    return std::max<int64_t>(0, static_cast<int64_t>(duration_ms) * deviceSpec._samplingFreq_hz / 1000);
+  };
+
+  MusicNodeTiming timing {};
+  timing._fadeInFrames = toFrames(node._fadeInDuration_ms);
+  timing._playFrames = node._playDuration_ms == PLAY_MUSIC_FOREVER ? MusicNodeTiming::FOREVER : toFrames(node._playDuration_ms);
+  timing._fadeOutFrames = toFrames(node._fadeOutDuration_ms);
+  return timing;
+}
+
+//
+// Asks the streaming thread to open and prime a stream, returning the id of the request.
+//
+static uint64_t requestMusicPrefetch(const std::string& path)
+{
+  uint64_t id {0};
+  {
+    std::lock_guard<std::mutex> lock {streamMutex};
+    id = ++musicPrefetch._id;
+    musicPrefetch._path = path;
+    musicPrefetch._isRequested = true;
+    musicPrefetch._isDone = false;
+    musicPrefetch._stream.reset();
+  }
+  streamWake.notify_one();
+  return id;
 }
 
-static void stopMusicFadeOut_(int fadeDuration_ms)
+//
+// Returns true once the request is done, with the primed stream, or null if the stream could
+// not be opened.
+//
+static bool takePrefetchedMusic(uint64_t id, std::shared_ptr<MusicStream>& stream)
 {
-  Mix_FadeOutMusic(fadeDuration_ms);
+  std::lock_guard<std::mutex> lock {streamMutex};
+  if(musicPrefetch._id != id || !musicPrefetch._isDone)
+    return false;
+  stream = std::move(musicPrefetch._stream);
+  musicPrefetch._isDone = false;
+  return true;
 }
 
-static void pauseMusic_()
+static void cancelMusicPrefetch()
 {
-  Mix_PauseMusic();
+  std::lock_guard<std::mutex> lock {streamMutex};
+  ++musicPrefetch._id;
+  musicPrefetch._isRequested = false;
+  musicPrefetch._isDone = false;
+  musicPrefetch._stream.reset();
 }
 
-static void resumeMusic_()
+//
+// Hands a primed stream to the audio thread to start once the node playing ends (or at once if
+// nothing is playing).
+//
+static bool queueMusicNode(const MusicSequenceNode& node, std::shared_ptr<MusicStream> stream)
 {
-  Mix_ResumeMusic();
+  AudioCommand command {};
+  command._type = AudioCommand::QUEUE_MUSIC_NODE;
+  command._stream = stream.get();
+  command._timing = getMusicNodeTiming(node);
+  if(!queueAudioCommand(command))
+    return false;
+
+  heldMusic.push_back(std::move(stream));
+  updateStreamingMusic();
+  return true;
 }
 
 MusicSequencePlayer::MusicSequencePlayer() :
   _state{STOPPED},
   _sequence{},
-  _currentNode{0},
-  _musicClock_s{0.f},
-  _isLooping{false}
+  _nextNode{0},
+  _prefetchNode{NO_NODE},
+  _prefetchId{0},
+  _failedNodes{0},
+  _nodesQueued{0},
+  _isLooping{false},
+  _isFirstNode{false}
 {}
 
-void MusicSequencePlayer::onUpdate(float dt)
+void MusicSequencePlayer::onUpdate()
 {
-  // note: requires a fading out state here because the SDL_mixer play functions will block
-  // if there is currently music fading out, sleeping until the fade out is complete so it can
-  // start playing the new music. To prevent blocking I wait for the fade out myself without
-  // blocking.
+  if(_state == STOPPED)
+    return;
 
-  switch(_state){
-    case PLAYING: 
-      onPlayingUpdate(dt); 
-      break;
-    case FADING_OUT: 
-      onFadingOutUpdate(dt); 
-      break;
-    default:
-      break;
+  uint64_t status = musicStatus.load(std::memory_order_acquire);
+  if(_prefetchNode != NO_NODE && !collectPrefetchedNode(status))
+    return;
+
+  //
+  // Only one node is queued ahead at a time; wait for the audio thread to take it before
+  // prefetching the node after.
+  //
+  uint64_t nodesTaken = status >> MUSIC_STATUS_FLAG_BITS;
+  if(nodesTaken < _nodesQueued || _state == STOPPED)
+    return;
+
+  if(_nextNode < static_cast<int>(_sequence.size())){
+    prefetchNextNode();
+    return;
+  }
+
+  if(!(status & MUSIC_PLAYING)){
+    _state = STOPPED;
+    _sequence.clear();
   }
 }
 
 void MusicSequencePlayer::play(MusicSequence_t sequence, bool loop)
 {
   stop();
+  if(sequence.size() == 0)
+    return;
   _sequence = std::move(sequence);
-  _currentNode = 0;
-  _musicClock_s = 0.f;
+  _nextNode = 0;
+  _failedNodes = 0;
   _isLooping = loop;
-  if(_sequence.size() == 0){ 
-    _state = STOPPED;
-    return;
-  }
-  playNode(&_sequence[_currentNode]);
+  _isFirstNode = true;
+  _state = PLAYING;
+  prefetchNextNode();
 }
 
 void MusicSequencePlayer::stop()
 {
   if(_state != STOPPED){
-    _musicClock_s = 0.f;
-    _currentNode = 0;
     _state = STOPPED;
     _sequence.clear();
-    stopMusic_();
+    if(_prefetchNode != NO_NODE){
+      cancelMusicPrefetch();
+      _prefetchNode = NO_NODE;
+    }
+    queueMusicCommand(AudioCommand::STOP_MUSIC);
   }
 }
 
@@ -522,7 +2708,7 @@ void MusicSequencePlayer::pause()
 {
   if(_state == PLAYING){
     _state = PAUSED;
-    pauseMusic_();
+    queueMusicCommand(AudioCommand::PAUSE_MUSIC);
   }
 }
 
@@ -530,76 +2716,94 @@ void MusicSequencePlayer::resume()
 {
   if(_state == PAUSED){
     _state = PLAYING;
-    resumeMusic_();
+    queueMusicCommand(AudioCommand::RESUME_MUSIC);
   }
 }
 
 bool MusicSequencePlayer::isUsingMusicResource(ResourceKey_t musicKey)
 {
-  return music.find(musicKey) != music.end();
+  if(_state == STOPPED) return false;
+  return std::any_of(_sequence.begin(), _sequence.end(), [musicKey](const MusicSequenceNode& node){
+    return node._musicKey == musicKey;
+  });
 }
 
-void MusicSequencePlayer::playNode(const MusicSequenceNode* node)
+void MusicSequencePlayer::prefetchNextNode()
 {
-  bool result;
-  if(node->_fadeInDuration_ms > 0.f)
-    playMusicFadeIn_(node->_musicKey, INFINITE_LOOPS, node->_fadeInDuration_ms);
-  else
-    playMusic_(node->_musicKey, INFINITE_LOOPS);
-  _state = PLAYING;
-}
+  int node = _nextNode;
+  ++_nextNode;
+  if(_nextNode == static_cast<int>(_sequence.size()) && _isLooping)
+    _nextNode = 0;
 
-void MusicSequencePlayer::stopNode(const MusicSequenceNode* node)
-{
-  if(node->_fadeOutDuration_ms > 0.f) 
-    stopMusicFadeOut_(node->_fadeOutDuration_ms);
-  else 
-    stopMusic_();
-  _state = FADING_OUT;
+  MusicResource* resource = findMusic(_sequence[node]._musicKey);
+  if(resource == nullptr)
+    return onNodeFailed();
+
+  _prefetchNode = node;
+  _prefetchId = requestMusicPrefetch(resource->_path);
 }
 
-void MusicSequencePlayer::onPlayingUpdate(float dt)
+//
+// Returns false while the prefetch is still in progress.
+//
+bool MusicSequencePlayer::collectPrefetchedNode(uint64_t status)
 {
-  assert(0 <= _currentNode && _currentNode < _sequence.size());
-  const MusicSequenceNode* node {nullptr};
-  node = &_sequence[_currentNode];
-  _musicClock_s += dt;
-  if(_musicClock_s > ((node->_playDuration_ms - node->_fadeOutDuration_ms) / 1000.f)){
-    stopNode(node);
-    _musicClock_s = 0.f;
+  std::shared_ptr<MusicStream> stream {nullptr};
+  if(!takePrefetchedMusic(_prefetchId, stream))
+    return false;
+
+  const MusicSequenceNode& node = _sequence[_prefetchNode];
+  _prefetchNode = NO_NODE;
+
+  if(stream == nullptr){
+    onMusicPlayError(node._musicKey);
+    onNodeFailed();
+    return true;
+  }
+
+  if(!queueMusicNode(node, std::move(stream))){
+    onNodeFailed();
+    return true;
   }
+
+  //
+  // The first node of a sequence has nothing before it to be late for.
+  //
+  if(!_isFirstNode){
+    if(status & MUSIC_PLAYING)
+      ++musicPrefetchHits;
+    else
+      ++musicPrefetchMisses;
+  }
+
+  _isFirstNode = false;
+  ++_nodesQueued;
+  _failedNodes = 0;
+  return true;
 }
 
-void MusicSequencePlayer::onFadingOutUpdate(float dt)
+//
+// Nodes which cannot be played are skipped, but rather than retry every tick a sequence in
+// which no node can be played is stopped.
+//
+void MusicSequencePlayer::onNodeFailed()
 {
-  assert(0 <= _currentNode && _currentNode < _sequence.size());
-  const MusicSequenceNode* node {nullptr};
-  node = &_sequence[_currentNode];
-  _musicClock_s += dt;
-  if(_musicClock_s > ((node->_fadeOutDuration_ms / 1000.f))){
-    ++_currentNode;
-    if(_currentNode >= _sequence.size()){
-      if(!_isLooping) return stop();
-      _currentNode = 0;
-    }
-    node = &_sequence[_currentNode];
-    playNode(node);
-    _musicClock_s = 0.f;
-  }
+  if(++_failedNodes >= static_cast<int>(_sequence.size()))
+    stop();
 }
 
 ResourceKey_t loadMusicWAV(ResourceName_t musicName)
 {
   log::log(log::INFO, log::msg_sfx_loading_music, musicName);
 
-  for(auto& pair : music){
-    if(pair.second._name == musicName){
-      pair.second._referenceCount++;
-      std::string addendum {"reference count="};
-      addendum += std::to_string(pair.second._referenceCount);
-      log::log(log::INFO, log::msg_sfx_music_already_loaded, addendum);
-      return pair.first;
-    }
+  ResourceKey_t loadedKey = music.findName(musicName);
+  if(loadedKey != nullResourceKey){
+    MusicResource* loaded = music.find(loadedKey);
+    loaded->_referenceCount++;
+    std::string addendum {"reference count="};
+    addendum += std::to_string(loaded->_referenceCount);
+    log::log(log::INFO, log::msg_sfx_music_already_loaded, addendum);
+    return loadedKey;
   }
 
   MusicResource resource {};
@@ -607,17 +2811,21 @@ ResourceKey_t loadMusicWAV(ResourceName_t musicName)
   wavpath += RESOURCE_PATH_MUSIC;
   wavpath += musicName;
   wavpath += io::Wav::FILE_EXTENSION;
-  resource._music = Mix_LoadMUS(wavpath.c_str());
-  if(resource._music == nullptr){
-    log::log(log::ERROR, log::msg_sfx_fail_load_music, wavpath + " : " + Mix_GetError());
+
+  //
+  // Only the headers are read here to validate the file; the samples are streamed on play.
+  //
+  io::WavStream wav {};
+  if(!wav.open(wavpath)){
+    log::log(log::ERROR, log::msg_sfx_fail_load_music, wavpath);
     log::log(log::WARN, log::msg_sfx_no_error_music);
     return nullResourceKey;
   }
+  resource._path = wavpath;
   resource._name = musicName;
   resource._referenceCount = 1;
 
-  ResourceKey_t newKey = nextResourceKey++;
-  music.emplace(std::make_pair(newKey, resource));
+  ResourceKey_t newKey = music.insert(musicName, std::move(resource));
 
   std::string addendum{};
   addendum += "[name:key]=[";
@@ -632,15 +2840,14 @@ ResourceKey_t loadMusicWAV(ResourceName_t musicName)
 
 static bool unloadMusic(ResourceKey_t musicKey)
 {
-  auto search = music.find(musicKey);
-  if(search == music.end()){
+  MusicResource* resource = music.find(musicKey);
+  if(resource == nullptr){
     log::log(log::WARN, log::msg_sfx_unloading_nonexistent_music, std::to_string(musicKey));
   }
   else{
-    search->second._referenceCount--;
-    if(search->second._referenceCount <= 0){
-      Mix_FreeMusic(search->second._music);
-      music.erase(search);
+    resource->_referenceCount--;
+    if(resource->_referenceCount <= 0){
+      music.erase(musicKey);
       log::log(log::INFO, log::msg_sfx_music_unloaded, std::to_string(musicKey));
     }
   }
@@ -652,7 +2859,7 @@ static void unloadUnusedMusic()
   if(musicUnloadQueue.size() == 0) return;
   musicUnloadQueue.erase(std::remove_if(musicUnloadQueue.begin(), musicUnloadQueue.end(), [](ResourceKey_t musicKey){
     return !musicSequencePlayer.isUsingMusicResource(musicKey) && unloadMusic(musicKey);
-  }));
+  }), musicUnloadQueue.end());
 }
 
 void queueUnloadMusic(ResourceKey_t musicKey)
@@ -682,38 +2889,83 @@ void resumeMusic()
 
 bool isMusicPlaying()
 {
-  return Mix_PlayingMusic() == 1;
+  return musicStatus.load(std::memory_order_relaxed) & MUSIC_PLAYING;
 }
 
 bool isMusicPaused()
 {
-  return Mix_PausedMusic() == 1;
+  return musicStatus.load(std::memory_order_relaxed) & MUSIC_PAUSED;
 }
 
 bool isMusicFadingIn()
 {
-  return Mix_FadingMusic() == MIX_FADING_IN;
+  return musicStatus.load(std::memory_order_relaxed) & MUSIC_FADING_IN;
 }
 
 bool isMusicFadingOut()
 {
-  return Mix_FadingMusic() == MIX_FADING_OUT;
+  return musicStatus.load(std::memory_order_relaxed) & MUSIC_FADING_OUT;
 }
 
 void setMusicVolume(int volume)
 {
   int vol = std::clamp(volume, MIN_VOLUME, MAX_VOLUME);
-  if(vol != musicVolume){
+  AudioCommand command {};
+  command._type = AudioCommand::SET_MUSIC_VOLUME;
+  command._volume = vol;
+  if(queueAudioCommand(command))
     musicVolume = vol;
-    hasMusicVolumeChanged = true;
-  }
 }
 
-int getMusicVolume(int volume)
+int getMusicVolume()
 {
   return musicVolume;
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// BUS FUNCTIONS
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+static bool isValidBus(int bus)
+{
+  if(0 <= bus && bus < BUS_COUNT)
+    return true;
+  log::log(log::WARN, log::msg_sfx_invalid_bus, std::to_string(bus));
+  return false;
+}
+
+void setBusVolume(int bus, int volume, int ramp_ms)
+{
+  if(!isValidBus(bus)) return;
+  AudioCommand command {};
+  command._type = AudioCommand::SET_BUS_VOLUME;
+  command._bus = bus;
+  command._volume = std::clamp(volume, MIN_VOLUME, MAX_VOLUME);
+  command._frames = ramp_ms > 0 ? std::max(Mixer::VOLUME_RAMP_FRAMES, msToFrames(ramp_ms)) : Mixer::VOLUME_RAMP_FRAMES;
+  queueAudioCommand(command);
+}
+
+void setBusLowPass(int bus, int cutoff_hz, int glide_ms)
+{
+  if(!isValidBus(bus)) return;
+  AudioCommand command {};
+  command._type = AudioCommand::SET_BUS_LOW_PASS;
+  command._bus = bus;
+  command._cutoff_hz = std::max(NO_LOW_PASS, cutoff_hz);
+  command._frames = glide_ms > 0 ? msToFrames(glide_ms) : 0;
+  queueAudioCommand(command);
+}
+
+void setMusicDucking(int duckedVolume, int attack_ms, int release_ms)
+{
+  AudioCommand command {};
+  command._type = AudioCommand::SET_MUSIC_DUCKING;
+  command._volume = std::clamp(duckedVolume, MIN_VOLUME, MAX_VOLUME);
+  command._frames = msToFrames(attack_ms);
+  command._releaseFrames = msToFrames(release_ms);
+  queueAudioCommand(command);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 // GENERAL FUNCTIONS
 /////////////////////////////////////////////////////////////////////////////////////////////////
@@ -726,12 +2978,10 @@ static void logSpec()
   log::log(log::INFO, "minor:", std::to_string(version->minor));
   log::log(log::INFO, "patch:", std::to_string(version->patch));
 
-  int freq, channels; uint16_t format;
-  if(!Mix_QuerySpec(&freq, &format, &channels)){
-    log::log(log::WARN, log::msg_sfx_fail_query_spec, std::string{Mix_GetError()});
-    return;
-  }
-  
+  int freq {deviceSpec._samplingFreq_hz};
+  int channels {deviceSpec._numChannels};
+  uint16_t format {deviceSpec._sampleFormat};
+
   const char* formatString {nullptr};
   switch(format){
     case SAMPLE_FORMAT_U8    : {formatString = "U8";     break;}
@@ -739,6 +2989,7 @@ static void logSpec()
     case SAMPLE_FORMAT_U16LSB: {formatString = "U16LSB"; break;}
     case SAMPLE_FORMAT_S16LSB: {formatString = "S16LSB"; break;}
     case SAMPLE_FORMAT_S32LSB: {formatString = "S32LSB"; break;}
+    case SAMPLE_FORMAT_F32LSB: {formatString = "F32LSB"; break;}
     default                  : {formatString = "unknown format";}
   }
 
@@ -749,17 +3000,154 @@ static void logSpec()
     default:                 {modeString = "unknown mode";}
   }
 
-  log::log(log::INFO, "SDL_Mixer Audio Device Spec: ");
+  log::log(log::INFO, isNativeBackend() ? "Native Mixer Audio Device Spec: " : "SDL_Mixer Audio Device Spec: ");
   log::log(log::INFO, "sample frequency: ", std::to_string(freq));
   log::log(log::INFO, "sample format: ", formatString);
   log::log(log::INFO, "output mode: ", modeString);
 }
 
-bool initialize(SFXConfiguration sfxconf)
+//
+// Called by the native mixer with each block of mixed voices; runs the sfx bus over them,
+// mixes the music on top and runs the master bus over the lot.
+//
+static void onNativeBlock(float* accumulator, int frames)
+{
+  buses[BUS_SFX].process(accumulator, frames);
+  mixMusic(accumulator, frames);
+  buses[BUS_MASTER].process(accumulator, frames);
+}
+
+//
+// The native backend's audio callback; renders all voices and the music a block at a time.
+//
+static void onNativeAudio(void* userdata, Uint8* stream, int len)
+{
+  beginAudioCallback();
+  applyAudioCommands();
+  int frameBytes = (SDL_AUDIO_BITSIZE(deviceSpec._sampleFormat) / 8) * deviceSpec._numChannels;
+  int frames = len / frameBytes;
+  if(deviceSpec._sampleFormat == SAMPLE_FORMAT_F32LSB)
+    nativeMixer.mix(reinterpret_cast<float*>(stream), frames);
+  else
+    nativeMixer.mix(reinterpret_cast<int16_t*>(stream), frames);
+  publishMusicStatus();
+  endAudioCallback(len);
+}
+
+//
+// Called once the device spec is known and before the audio thread first runs.
+//
+static void initializeBuses()
+{
+  for(auto& bus : buses)
+    bus.initialize(deviceSpec._numChannels, deviceSpec._samplingFreq_hz);
+  buses[BUS_MUSIC].setDucking(
+    static_cast<float>(DEFAULT_DUCKED_VOLUME) / MAX_VOLUME,
+    msToFrames(DEFAULT_DUCK_ATTACK_MS),
+    msToFrames(DEFAULT_DUCK_RELEASE_MS)
+  );
+}
+
+static bool openNativeDevice(const SFXConfiguration& sfxconf)
+{
+  if(SDL_InitSubSystem(SDL_INIT_AUDIO) != 0){
+    log::log(log::ERROR, log::msg_sfx_fail_open_audio, std::string{SDL_GetError()});
+    return false;
+  }
+
+  SDL_AudioSpec want {};
+  want.freq = sfxconf._samplingFreq_hz;
+  want.format = sfxconf._sampleFormat;
+  want.channels = sfxconf._outputMode;
+  want.samples = sfxconf._chunkSize;
+  want.callback = &onNativeAudio;
+
+  //
+  // Only the frequency may change; the mixer writes exactly the requested format and channels.
+  //
+  SDL_AudioSpec have {};
+  nativeDevice = SDL_OpenAudioDevice(nullptr, 0, &want, &have, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE);
+  if(nativeDevice == 0){
+    log::log(log::ERROR, log::msg_sfx_fail_open_audio, std::string{SDL_GetError()});
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    return false;
+  }
+
+  deviceSpec._samplingFreq_hz = have.freq;
+  deviceSpec._sampleFormat = have.format;
+  deviceSpec._numChannels = have.channels;
+
+  nativeMixer.initialize(sfxconf._numMixChannels, have.channels);
+  nativeMixer.setFinishedCallback(&onChannelFinished);
+  nativeMixer.setBlockCallback(&onNativeBlock);
+  initializeBuses();
+  return true;
+}
+
+static bool openRenderTarget(const SFXConfiguration& sfxconf)
+{
+  bool isFloat = sfxconf._sampleFormat == SAMPLE_FORMAT_F32LSB;
+  deviceSpec._samplingFreq_hz = sfxconf._samplingFreq_hz;
+  deviceSpec._sampleFormat = isFloat ? SAMPLE_FORMAT_F32LSB : SAMPLE_FORMAT_S16LSB;
+  deviceSpec._numChannels = sfxconf._outputMode;
+  if(!renderWriter.open(sfxconf._renderPath, deviceSpec._samplingFreq_hz, deviceSpec._numChannels, isFloat)){
+    log::log(log::ERROR, log::msg_sfx_fail_open_render, sfxconf._renderPath);
+    return false;
+  }
+  int frameBytes = (SDL_AUDIO_BITSIZE(deviceSpec._sampleFormat) / 8) * deviceSpec._numChannels;
+  renderBuffer.assign(static_cast<size_t>(sfxconf._chunkSize) * frameBytes, 0);
+  renderTime_s = 0.0;
+  renderedFrames = 0;
+  renderMixTime_ns = 0;
+  nativeMixer.initialize(sfxconf._numMixChannels, deviceSpec._numChannels);
+  nativeMixer.setFinishedCallback(&onChannelFinished);
+  nativeMixer.setBlockCallback(&onNativeBlock);
+  initializeBuses();
+  return true;
+}
+
+//
+// Renders whole chunks up to the time dt seconds on from the last render, exactly as the
+// audio callback would have done in that time.
+//
+static void renderOffline(float dt)
+{
+  renderTime_s += dt;
+  int64_t dueFrames = static_cast<int64_t>(renderTime_s * deviceSpec._samplingFreq_hz);
+  int chunkFrames = sfxconfiguration._chunkSize;
+  while(dueFrames - renderedFrames >= chunkFrames){
+    {
+      std::unique_lock<std::mutex> lock {streamMutex};
+      fillMusicStreams(lock);
+    }
+    int64_t start_ns = getNow_ns();
+    onNativeAudio(nullptr, renderBuffer.data(), static_cast<int>(renderBuffer.size()));
+    renderMixTime_ns += getNow_ns() - start_ns;
+    renderWriter.write(renderBuffer.data(), renderBuffer.size());
+    renderedFrames += chunkFrames;
+  }
+}
+
+static void closeRenderTarget()
+{
+  renderWriter.close();
+  double seconds = static_cast<double>(renderedFrames) / deviceSpec._samplingFreq_hz;
+  double mixPerSecond_ms = seconds > 0.0 ? renderMixTime_ns / 1e6 / seconds : 0.0;
+  std::string addendum {};
+  addendum += std::to_string(seconds);
+  addendum += ":";
+  addendum += std::to_string(mixPerSecond_ms);
+  log::log(log::INFO, log::msg_sfx_render_done, addendum);
+}
+
+static bool isOfflineRender()
+{
+  return sfxconfiguration._renderPath != nullptr;
+}
+
+static bool openMixerDevice(const SFXConfiguration& sfxconf)
 {
   assert(!(SDL_AUDIO_ISFLOAT(sfxconf._sampleFormat)));
-  log::log(log::INFO, log::msg_sfx_initializing);
-  sfxconfiguration = sfxconf;
   int result = Mix_OpenAudio(
     sfxconf._samplingFreq_hz, 
     sfxconf._sampleFormat, 
@@ -770,13 +3158,64 @@ bool initialize(SFXConfiguration sfxconf)
     log::log(log::ERROR, log::msg_sfx_fail_open_audio, std::string{Mix_GetError()});
     return false;
   }
+  if(!Mix_QuerySpec(&deviceSpec._samplingFreq_hz, &deviceSpec._sampleFormat, &deviceSpec._numChannels)){
+    log::log(log::WARN, log::msg_sfx_fail_query_spec, std::string{Mix_GetError()});
+    deviceSpec._samplingFreq_hz = sfxconf._samplingFreq_hz;
+    deviceSpec._sampleFormat = sfxconf._sampleFormat;
+    deviceSpec._numChannels = sfxconf._outputMode;
+  }
   Mix_AllocateChannels(sfxconf._numMixChannels);
   Mix_ChannelFinished(&onChannelFinished);
+  initializeBuses();
+  Mix_HookMusic(&onMusicHook, nullptr);
+  Mix_SetPostMix(&onPostMix, nullptr);
+  return true;
+}
+
+bool initialize(SFXConfiguration sfxconf)
+{
+  log::log(log::INFO, log::msg_sfx_initializing);
+  if(sfxconf._renderPath != nullptr)
+    sfxconf._backend = BACKEND_NATIVE;
+  sfxconfiguration = sfxconf;
+  audioCommands.allocate(COMMAND_QUEUE_CAPACITY);
+  finishedChannels.allocate(MAX_UNFINISHED_PLAYS * sfxconf._numMixChannels);
+  releasedMusic.allocate(RELEASED_MUSIC_QUEUE_CAPACITY);
+  commandsDropped = 0;
+  commandsApplied = 0;
+  commandLatencySum_ns = 0;
+  commandLatencyMax_ns = 0;
+  callbackMixTimes.reset();
+  callbackIntervals.reset();
+  playLatencies.reset();
+  audioUnderruns = 0;
+  mixerPlayErrors = 0;
+  callbackStart_ns = 0;
+  channelAllocator.initialize(sfxconf._numMixChannels);
+  channelUnfinishedPlays.assign(sfxconf._numMixChannels, 0);
+  channelFirstPlay.assign(sfxconf._numMixChannels, 0);
+  channelPlays.assign(sfxconf._numMixChannels * MAX_UNFINISHED_PLAYS, nullResourceKey);
+  channelPaused.assign(sfxconf._numMixChannels, false);
+  duckingPlays = 0;
+  isMusicDucked = false;
+  bool isOpen {false};
+  if(isOfflineRender())
+    isOpen = openRenderTarget(sfxconf);
+  else
+    isOpen = isNativeBackend() ? openNativeDevice(sfxconf) : openMixerDevice(sfxconf);
+  if(!isOpen)
+    return false;
   channelPlayback.resize(sfxconf._numMixChannels, nullResourceKey);
   channelPlayback.shrink_to_fit();
   channelVolume.resize(sfxconf._numMixChannels, MAX_VOLUME);
   channelVolume.shrink_to_fit();
-  generateErrorSound(static_cast<SampleFormat>(sfxconf._sampleFormat));
+  generateErrorSound(isNativeBackend() ? SAMPLE_FORMAT_S16LSB : static_cast<SampleFormat>(sfxconf._sampleFormat));
+  if(!isOfflineRender()){
+    isStreamThreadRunning = true;
+    streamThread = std::thread{streamMusic};
+  }
+  if(isNativeBackend() && !isOfflineRender())
+    SDL_PauseAudioDevice(nativeDevice, 0);
   logSpec();
   return true;
 }
@@ -784,24 +3223,102 @@ bool initialize(SFXConfiguration sfxconf)
 void shutdown()
 {
   stopChannel(ALL_CHANNELS);
+  musicSequencePlayer.stop();
+  if(isOfflineRender())
+    closeRenderTarget();
+  else if(isNativeBackend())
+    SDL_CloseAudioDevice(nativeDevice);
+  else{
+    Mix_HookMusic(nullptr, nullptr);
+    Mix_SetPostMix(nullptr, nullptr);
+
+    //
+    // The queued stop above is applied in the music hook which is now gone, and the device 
+    // keeps mixing until Mix_CloseAudio, so the channels are halted here before the chunks 
+    // they play are freed below.
+    //
+    Mix_HaltChannel(-1);
+  }
+
+  //
+  // The audio thread no longer applies commands (it has stopped, or for SDL_mixer has no hook
+  // to apply them from) so any commands still queued will never be applied.
+  //
+  musicPlayback = MusicPlayback{};
+  musicStatus = 0;
+  musicSequencePlayer = MusicSequencePlayer{};
+  {
+    std::lock_guard<std::mutex> lock {streamMutex};
+    isStreamThreadRunning = false;
+  }
+  streamWake.notify_one();
+  if(streamThread.joinable())
+    streamThread.join();
+  streamingMusic.clear();
+  heldMusic.clear();
+  musicPrefetch = MusicPrefetch{};
+  music.clear();
+  if(musicUnderrunCount > 0)
+    log::log(log::WARN, log::msg_sfx_music_underruns, std::to_string(musicUnderrunCount.load()));
+  if(mixerPlayErrors > 0)
+    log::log(log::WARN, log::msg_sfx_mixer_play_errors, std::to_string(mixerPlayErrors.load()));
   freeErrorSound();
-  for(auto& pair : sounds)
-    Mix_FreeChunk(pair.second._chunk);
+  sounds.forEach(freeSoundResource);
   sounds.clear();
-  Mix_CloseAudio();
+  soundLru.clear();
+  pcmPool.clear();
+  if(isOfflineRender())
+    renderBuffer.clear();
+  else if(isNativeBackend()){
+    nativeDevice = 0;
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+  }
+  else
+    Mix_CloseAudio();
 }
 
 void onUpdate(float dt)
 {
+  collectFinishedChannels();
+  updateMusicDucking();
   unloadUnusedSounds();
+  evictSounds();
   unloadUnusedMusic();
+  collectReleasedMusic();
 
-  if(hasMusicVolumeChanged && Mix_FadingMusic() == MIX_NO_FADING){
-    Mix_VolumeMusic(musicVolume);
-    hasMusicVolumeChanged = false;
-  }
+  musicSequencePlayer.onUpdate();
+
+  if(isOfflineRender())
+    renderOffline(dt);
+}
 
-  musicSequencePlayer.onUpdate(dt);
+SFXStats getStats()
+{
+  SFXStats stats {};
+  size_t applied = commandsApplied.load(std::memory_order_acquire);
+  stats._commandsApplied = static_cast<int>(applied);
+  stats._commandsDropped = commandsDropped;
+  if(applied > 0)
+    stats._commandLatencyMean_ms = commandLatencySum_ns.load(std::memory_order_relaxed) / (applied * 1e6);
+  stats._commandLatencyMax_ms = commandLatencyMax_ns.load(std::memory_order_relaxed) / 1e6;
+  stats._commandQueueHighWater = static_cast<int>(audioCommands.getHighWater());
+  stats._commandQueueCapacity = static_cast<int>(audioCommands.getCapacity());
+  stats._finishedQueueHighWater = static_cast<int>(finishedChannels.getHighWater());
+  stats._finishedQueueCapacity = static_cast<int>(finishedChannels.getCapacity());
+  stats._musicUnderruns = musicUnderrunCount.load(std::memory_order_relaxed);
+  stats._musicPrefetchHits = musicPrefetchHits;
+  stats._musicPrefetchMisses = musicPrefetchMisses;
+  stats._soundMemory_kb = static_cast<int>(soundBytes / 1024);
+  stats._soundBudget_kb = sfxconfiguration._soundBudget_kb;
+  stats._soundEvictions = soundEvictions;
+  stats._soundReloads = soundReloads;
+  stats._callbackMix = callbackMixTimes.summarize();
+  stats._callbackInterval = callbackIntervals.summarize();
+  stats._playLatency = playLatencies.summarize();
+  stats._audioUnderruns = audioUnderruns.load(std::memory_order_relaxed);
+  if(deviceSpec._samplingFreq_hz > 0)
+    stats._bufferPeriod_ms = 1000.f * sfxconfiguration._chunkSize / deviceSpec._samplingFreq_hz;
+  return stats;
 }
 
 } // namespace sfx
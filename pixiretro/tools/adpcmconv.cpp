@@ -0,0 +1,109 @@
+//
+// Converts 16-bit wave sounds to IMA ADPCM wave sounds and measures what the conversion costs.
+//
+// usage:
+//    adpcmconv <in.wav> <out.wav>   - converts a 16-bit wave sound to an IMA ADPCM wave sound.
+//    adpcmconv bench <dir> [loads]  - for every 16-bit wave sound in dir, compares the file size 
+//                                     and mean load (and decode) time of the sound with that of
+//                                     its IMA ADPCM encoding, and reports the signal to noise
+//                                     ratio of the encoding.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <chrono>
+#include <filesystem>
+#include "pxr_wav.h"
+
+using namespace pxr;
+
+static bool convert(const std::string& inpath, const std::string& outpath)
+{
+  io::Wav sound {};
+  if(!sound.load(inpath)){
+    fprintf(stderr, "failed to load '%s'\n", inpath.c_str());
+    return false;
+  }
+  if(!io::Wav::saveImaAdpcm(outpath, sound)){
+    fprintf(stderr, "failed to write '%s' (only 16-bit sounds can be converted)\n", outpath.c_str());
+    return false;
+  }
+  return true;
+}
+
+static double measureLoad_us(const std::string& path, int loads)
+{
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < loads; ++i){
+    io::Wav sound {};
+    sound.load(path);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / loads;
+}
+
+static double measureSnr_db(const std::string& pcmpath, const std::string& adpcmpath)
+{
+  io::Wav pcm {}, adpcm {};
+  pcm.load(pcmpath);
+  adpcm.load(adpcmpath);
+  const int16_t* a = reinterpret_cast<const int16_t*>(pcm.getSampleData());
+  const int16_t* b = reinterpret_cast<const int16_t*>(adpcm.getSampleData());
+  int numSamples = std::min(pcm.getSampleDataSize(), adpcm.getSampleDataSize()) / 2;
+  double signal {0.0}, noise {0.0};
+  for(int s = 0; s < numSamples; ++s){
+    signal += static_cast<double>(a[s]) * a[s];
+    noise += static_cast<double>(a[s] - b[s]) * (a[s] - b[s]);
+  }
+  return noise > 0.0 ? 10.0 * std::log10(signal / noise) : INFINITY;
+}
+
+static bool bench(const std::string& directory, int loads)
+{
+  namespace fs = std::filesystem;
+
+  fs::path tmpdir = fs::temp_directory_path();
+
+  printf("%-28s %10s %10s %10s %10s %8s\n", "sound", "pcm[kib]", "ima[kib]", "pcm[us]", "ima[us]", "snr[db]");
+
+  double pcmTotal_us {0.0}, imaTotal_us {0.0};
+  for(const auto& entry : fs::directory_iterator(directory)){
+    if(entry.path().extension() != io::Wav::FILE_EXTENSION)
+      continue;
+
+    std::string pcmpath = entry.path().string();
+    std::string imapath = (tmpdir / entry.path().stem()).string() + ".ima" + io::Wav::FILE_EXTENSION;
+    if(!convert(pcmpath, imapath))
+      continue;
+
+    double pcm_us = measureLoad_us(pcmpath, loads);
+    double ima_us = measureLoad_us(imapath, loads);
+    pcmTotal_us += pcm_us;
+    imaTotal_us += ima_us;
+
+    printf("%-28s %10.1f %10.1f %10.1f %10.1f %8.1f\n", 
+           entry.path().filename().string().c_str(),
+           fs::file_size(pcmpath) / 1024.0, 
+           fs::file_size(imapath) / 1024.0,
+           pcm_us, ima_us, measureSnr_db(pcmpath, imapath));
+
+    fs::remove(imapath);
+  }
+
+  printf("%-28s %10s %10s %10.1f %10.1f\n", "total", "", "", pcmTotal_us, imaTotal_us);
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  if(argc >= 3 && std::string{argv[1]} == "bench")
+    return bench(argv[2], argc >= 4 ? std::max(1, atoi(argv[3])) : 20) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  if(argc == 3)
+    return convert(argv[1], argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  fprintf(stderr, "usage: adpcmconv <in.wav> <out.wav>\n       adpcmconv bench <dir> [loads]\n");
+  return EXIT_FAILURE;
+}
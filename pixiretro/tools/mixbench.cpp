@@ -0,0 +1,155 @@
+//
+// Measures the throughput of the native software mixer (see pxr_mixer.h).
+//
+// usage:
+//    mixbench [voices] [seconds]   - mixes the given number of looping voices (default 256) for
+//                                    the given duration of audio (default 10) to both S16 and
+//                                    F32 output and reports voices mixed per millisecond of cpu
+//                                    time, i.e. the number of voice-milliseconds of audio mixed
+//                                    per millisecond spent mixing.
+//
+//                                    Then measures the cost of running an effects bus (see
+//                                    pxr_bus.h) over each block of the mix, with each kind
+//                                    of effect, in nanoseconds per block and as a fraction of
+//                                    the time the block takes to play.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include "pxr_mixer.h"
+#include "pxr_bus.h"
+
+using namespace pxr;
+
+static constexpr int sampleRate_hz {44100};
+static constexpr int numChannels {2};
+static constexpr int callbackFrames {1024};
+
+//
+// Deterministic noise so every run mixes the same data.
+//
+static std::vector<int16_t> makeSource(int frames, uint32_t seed)
+{
+  std::vector<int16_t> samples(frames * numChannels);
+  for(auto& sample : samples){
+    seed = seed * 1664525u + 1013904223u;
+    sample = static_cast<int16_t>(seed >> 16);
+  }
+  return samples;
+}
+
+template<typename T>
+static double bench(int voices, int seconds, const std::vector<std::vector<int16_t>>& sources)
+{
+  sfx::Mixer mixer {};
+  mixer.initialize(voices, numChannels);
+  for(int v = 0; v < voices; ++v){
+    const auto& source = sources[v % sources.size()];
+    mixer.play(v, source.data(), source.size() / numChannels, sfx::Mixer::INFINITE_LOOPS, 0, sfx::Mixer::FOREVER);
+    mixer.setVolume(v, 16 + (v % 112));
+  }
+
+  std::vector<T> out(callbackFrames * numChannels);
+  int callbacks = seconds * sampleRate_hz / callbackFrames;
+
+  auto start = std::chrono::steady_clock::now();
+  for(int c = 0; c < callbacks; ++c)
+    mixer.mix(out.data(), callbackFrames);
+  auto end = std::chrono::steady_clock::now();
+
+  double elapsed_ms = std::chrono::duration<double, std::milli>(end - start).count();
+  double audio_ms = 1000.0 * callbacks * callbackFrames / sampleRate_hz;
+  return voices * audio_ms / elapsed_ms;
+}
+
+//
+// Runs a bus configured by setup over seconds of stereo blocks, changing it every block by
+// update; returns nanoseconds per block. Each block is refilled from the source first so the
+// filter always has signal; the row without effects measures that copy alone.
+//
+template<typename Setup, typename Update>
+static double benchBus(int seconds, const std::vector<int16_t>& source, Setup setup, Update update)
+{
+  constexpr int blockFrames {sfx::Mixer::BLOCK_FRAMES};
+  std::vector<float> signal(source.begin(), source.begin() + blockFrames * numChannels);
+  std::vector<float> block(signal.size());
+
+  sfx::Bus bus {};
+  bus.initialize(numChannels, sampleRate_hz);
+  setup(bus);
+
+  int blocks = seconds * sampleRate_hz / blockFrames;
+  float sink {0.f};
+  auto start = std::chrono::steady_clock::now();
+  for(int b = 0; b < blocks; ++b){
+    memcpy(block.data(), signal.data(), block.size() * sizeof(float));
+    update(bus, b);
+    bus.process(block.data(), blockFrames);
+    sink += block[b % block.size()];
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  if(sink == 12345.f) printf(" ");
+  return std::chrono::duration<double, std::nano>(end - start).count() / blocks;
+}
+
+int main(int argc, char** argv)
+{
+  int voices = argc > 1 ? atoi(argv[1]) : 256;
+  int seconds = argc > 2 ? atoi(argv[2]) : 10;
+  if(voices <= 0 || seconds <= 0){
+    fprintf(stderr, "usage: mixbench [voices] [seconds]\n");
+    return EXIT_FAILURE;
+  }
+
+  //
+  // Sources of differing lengths so voices loop at different times.
+  //
+  std::vector<std::vector<int16_t>> sources {};
+  for(int i = 0; i < 8; ++i)
+    sources.push_back(makeSource(sampleRate_hz / 4 + i * 997, i + 1));
+
+  printf("%d voices, %d s of %d Hz stereo audio in %d frame callbacks\n", voices, seconds, sampleRate_hz, callbackFrames);
+  printf("%-6s %12s %12s\n", "output", "voices/ms", "core load");
+  double s16 = bench<int16_t>(voices, seconds, sources);
+  double f32 = bench<float>(voices, seconds, sources);
+
+  //
+  // Core load is the fraction of one core needed to mix this many voices in realtime.
+  //
+  printf("%-6s %12.1f %11.2f%%\n", "S16", s16, 100.0 * voices / s16);
+  printf("%-6s %12.1f %11.2f%%\n", "F32", f32, 100.0 * voices / f32);
+
+  auto none = [](sfx::Bus&){};
+  auto still = [](sfx::Bus&, int){};
+  auto lowPass = [](sfx::Bus& bus){bus.setLowPass(800.f, 0);};
+  auto ramp = [](sfx::Bus& bus, int b){bus.setGain(b & 1 ? 1.f : 0.5f, sfx::Mixer::BLOCK_FRAMES);};
+  auto glide = [](sfx::Bus& bus, int b){if(b % 64 == 0) bus.setLowPass(b & 64 ? 400.f : 4000.f, 64 * sfx::Mixer::BLOCK_FRAMES);};
+  auto duck = [](sfx::Bus& bus, int b){bus.setDucked(b % 32 < 8);};
+  auto all = [&](sfx::Bus& bus, int b){ramp(bus, b); glide(bus, b); duck(bus, b);};
+  auto ducking = [](sfx::Bus& bus){bus.setDucking(0.3f, 1024, 16384);};
+
+  struct Row { const char* _name; double _ns; };
+  const auto& source = sources[0];
+  Row rows[] {
+    {"none",           benchBus(seconds, source, none, still)},
+    {"gain ramp",      benchBus(seconds, source, none, ramp)},
+    {"ducking",        benchBus(seconds, source, ducking, duck)},
+    {"low-pass",       benchBus(seconds, source, lowPass, still)},
+    {"low-pass glide", benchBus(seconds, source, lowPass, glide)},
+    {"all",            benchBus(seconds, source, ducking, all)}
+  };
+
+  //
+  // Block load is the fraction of the block's playing time spent on its effects.
+  //
+  double block_ns = 1e9 * sfx::Mixer::BLOCK_FRAMES / sampleRate_hz;
+  printf("\nbus effects over %d frame stereo blocks\n", sfx::Mixer::BLOCK_FRAMES);
+  printf("%-16s %10s %12s\n", "effects", "ns/block", "block load");
+  for(const auto& row : rows)
+    printf("%-16s %10.1f %11.3f%%\n", row._name, row._ns, 100.0 * row._ns / block_ns);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+//
+// Converts bitmap images to QOI images and benchmarks loading images in both formats.
+//
+// usage:
+//    qoiconv <in.bmp> <out.qoi>    - converts a bitmap image to a QOI image.
+//    qoiconv bench <dir> [loads]   - for every bitmap image in dir, compares the file size and 
+//                                    mean load time of the bitmap with that of a QOI encoding.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <chrono>
+#include <filesystem>
+#include "pxr_bmp.h"
+#include "pxr_qoi.h"
+
+using namespace pxr;
+
+static bool convert(const std::string& inpath, const std::string& outpath)
+{
+  io::Bmp image {};
+  if(!image.load(inpath)){
+    fprintf(stderr, "failed to load '%s'\n", inpath.c_str());
+    return false;
+  }
+  if(!io::Qoi::save(outpath, image)){
+    fprintf(stderr, "failed to write '%s'\n", outpath.c_str());
+    return false;
+  }
+  return true;
+}
+
+static double measureLoad_us(const std::string& path, int loads)
+{
+  auto start = std::chrono::steady_clock::now();
+  for(int i = 0; i < loads; ++i){
+    io::Bmp image {};
+    image.load(path);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() / loads;
+}
+
+static bool bench(const std::string& directory, int loads)
+{
+  namespace fs = std::filesystem;
+
+  fs::path tmpdir = fs::temp_directory_path();
+
+  printf("%-28s %10s %10s %10s %10s %8s\n", "image", "bmp[kib]", "qoi[kib]", "bmp[us]", "qoi[us]", "speedup");
+
+  double bmpTotal_us {0.0}, qoiTotal_us {0.0};
+  for(const auto& entry : fs::directory_iterator(directory)){
+    if(entry.path().extension() != io::Bmp::FILE_EXTENSION)
+      continue;
+
+    std::string bmppath = entry.path().string();
+    std::string qoipath = (tmpdir / entry.path().stem()).string() + io::Qoi::FILE_EXTENSION;
+    if(!convert(bmppath, qoipath))
+      return false;
+
+    double bmp_us = measureLoad_us(bmppath, loads);
+    double qoi_us = measureLoad_us(qoipath, loads);
+    bmpTotal_us += bmp_us;
+    qoiTotal_us += qoi_us;
+
+    printf("%-28s %10.1f %10.1f %10.1f %10.1f %7.2fx\n", 
+           entry.path().filename().string().c_str(),
+           fs::file_size(bmppath) / 1024.0, 
+           fs::file_size(qoipath) / 1024.0,
+           bmp_us, qoi_us, bmp_us / qoi_us);
+
+    fs::remove(qoipath);
+  }
+
+  printf("%-28s %10s %10s %10.1f %10.1f %7.2fx\n", "total", "", "", bmpTotal_us, qoiTotal_us, 
+         bmpTotal_us / qoiTotal_us);
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  if(argc >= 3 && std::string{argv[1]} == "bench")
+    return bench(argv[2], argc >= 4 ? std::max(1, atoi(argv[3])) : 100) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  if(argc == 3)
+    return convert(argv[1], argv[2]) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  fprintf(stderr, "usage: qoiconv <in.bmp> <out.qoi>\n       qoiconv bench <dir> [loads]\n");
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,98 @@
+//
+// Renders a fixed scenario of sounds and music offline to a wave file, without an audio device,
+// so the output of the sfx module can be diffed across changes and its mixing cost measured.
+//
+// usage:
+//    sfxrender <out.wav> <seconds> <music|-> <sound>...
+//
+//        Run from the game's root directory (sounds and music are loaded from the usual resource
+//        paths). Plays the music loop throughout (unless '-') and plays the sounds in turn at
+//        pseudo-random intervals, some looped and some faded in, updating the module at 60 Hz.
+//        The same arguments always render the same file. Reports the time spent mixing per
+//        second of audio rendered.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include "pxr_sfx.h"
+
+using namespace pxr;
+
+static constexpr int updateRate_hz {60};
+
+int main(int argc, char** argv)
+{
+  if(argc < 5){
+    fprintf(stderr, "usage: sfxrender <out.wav> <seconds> <music|-> <sound>...\n");
+    return EXIT_FAILURE;
+  }
+  const char* outpath = argv[1];
+  int seconds = atoi(argv[2]);
+  if(seconds <= 0){
+    fprintf(stderr, "seconds must be positive\n");
+    return EXIT_FAILURE;
+  }
+
+  sfx::SFXConfiguration sfxconf {};
+  sfxconf._samplingFreq_hz = 44100;
+  sfxconf._outputMode = sfx::STEREO;
+  sfxconf._chunkSize = 1024;
+  sfxconf._numMixChannels = 32;
+  sfxconf._renderPath = outpath;
+  if(!sfx::initialize(sfxconf)){
+    fprintf(stderr, "failed to initialize the sfx module\n");
+    return EXIT_FAILURE;
+  }
+
+  if(strcmp(argv[3], "-") != 0){
+    sfx::ResourceKey_t musicKey = sfx::loadMusicWAV(argv[3]);
+    sfx::playMusic({{musicKey, 500, -1, 0}});
+  }
+
+  std::vector<sfx::ResourceKey_t> soundKeys {};
+  for(int i = 4; i < argc; ++i)
+    soundKeys.push_back(sfx::loadSoundWAV(argv[i]));
+
+  //
+  // A fixed seed so every run plays the same sounds at the same ticks.
+  //
+  uint32_t seed {1};
+  auto next = [&seed](int range){
+    seed = seed * 1664525u + 1013904223u;
+    return static_cast<int>((seed >> 8) % range);
+  };
+
+  float dt = 1.f / updateRate_hz;
+  int ticks = seconds * updateRate_hz;
+  int nextPlayTick {0};
+  int plays {0};
+  auto start = std::chrono::steady_clock::now();
+  for(int tick = 0; tick < ticks; ++tick){
+    if(tick == nextPlayTick){
+      sfx::ResourceKey_t soundKey = soundKeys[plays % soundKeys.size()];
+      int loops = next(4) == 0 ? 2 : sfx::NO_LOOPS;
+      if(next(3) == 0)
+        sfx::playSoundFadeIn(soundKey, loops, 100);
+      else
+        sfx::playSound(soundKey, loops);
+      ++plays;
+      nextPlayTick = tick + 1 + next(updateRate_hz / 5);
+    }
+    sfx::onUpdate(dt);
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  sfx::SFXStats stats = sfx::getStats();
+  sfx::shutdown();
+
+  double elapsed_ms = std::chrono::duration<double, std::milli>(end - start).count();
+  printf("rendered %d s of audio with %d plays to '%s'\n", seconds, plays, outpath);
+  printf("chunk mix [ms] -- p50=%.3f p99=%.3f max=%.3f over %d chunks of %.2f ms\n",
+    stats._callbackMix._p50_ms, stats._callbackMix._p99_ms, stats._callbackMix._max_ms,
+    stats._callbackMix._count, stats._bufferPeriod_ms);
+  printf("total [ms per s of audio] -- %.3f (including updates and streaming)\n", elapsed_ms / seconds);
+  return EXIT_SUCCESS;
+}